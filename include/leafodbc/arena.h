@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory_resource>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace leafodbc {
+
+// Monotonic bump allocator holding everything decoded for one result.
+// Deallocation is a no-op; memory goes away all at once when the arena is
+// reset or destroyed, so tearing down a result costs O(blocks), not O(values).
+class Arena : public std::pmr::memory_resource {
+public:
+    explicit Arena(size_t first_block_size = 64 * 1024);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Copies s into the arena
+    std::string_view copy(std::string_view s);
+
+    // Forgets all allocations. The largest block is kept for reuse unless it
+    // exceeds max_retained bytes.
+    void reset(size_t max_retained);
+
+    // Bytes reserved from the system
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void add_block(size_t min_size);
+
+    std::vector<Block> blocks_;
+    char* cursor_ = nullptr;
+    size_t remaining_ = 0;
+    size_t next_block_size_;
+    size_t capacity_ = 0;
+};
+
+// Small per-connection pool of arenas. A result's arena returns here when
+// the last cursor over the result is gone, so steady workloads reuse the
+// same few blocks instead of going back to the heap.
+class ArenaPool : public std::enable_shared_from_this<ArenaPool> {
+public:
+    static constexpr size_t MAX_IDLE_ARENAS = 4;
+    static constexpr size_t MAX_RETAINED_BYTES = 16 * 1024 * 1024;
+
+    static std::shared_ptr<ArenaPool> create() { return std::shared_ptr<ArenaPool>(new ArenaPool()); }
+
+    // The arena is recycled (or freed if the pool is gone) on release
+    std::shared_ptr<Arena> acquire();
+
+private:
+    ArenaPool() = default;
+
+    void release(Arena* arena);
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Arena>> idle_;
+};
+
+} // namespace leafodbc
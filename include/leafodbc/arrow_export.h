@@ -0,0 +1,19 @@
+#pragma once
+
+#include "arrow_c.h"
+#include "result_store.h"
+#include <memory>
+
+namespace leafodbc {
+
+// Exports rows [first_row, row_count) of a result as an Arrow C stream
+// (SQL_ATTR_LEAF_ARROW_STREAM). The stream shares the store, so it outlives
+// the statement, and builds one columnar record batch per get_next call.
+//
+// Column types follow the inferred schema: BIT as boolean, INTEGER and
+// BIGINT as int64, DOUBLE as float64, VARCHAR as utf8 and LONGVARCHAR as
+// large_utf8. Cells convert as SQLGetData converts them to the matching C
+// type, except that a value that cannot be converted is exported as null.
+void export_arrow_stream(std::shared_ptr<const ResultStore> store, size_t first_row, ArrowArrayStream* out);
+
+} // namespace leafodbc
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace leafodbc {
+
+// Bounded lock-free ring buffer for many producers and one consumer, as
+// used by the logger and the tracer (sequence-numbered slots after
+// Vyukov's bounded MPMC queue).
+//
+// Producers never block: when the ring is full, try_push fails and the
+// caller counts the entry as dropped. Only one thread may call drain.
+template <typename T, size_t SlotCount>
+class BoundedRing {
+    static_assert(SlotCount > 0 && (SlotCount & (SlotCount - 1)) == 0, "SlotCount must be a power of two");
+
+public:
+    BoundedRing() : slots_(new Slot[SlotCount]) {
+        for (size_t i = 0; i < SlotCount; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    // Claims a slot and fills it in place with fill(T&); false if full
+    template <typename Fill>
+    bool try_push(Fill&& fill) {
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        while (true) {
+            slot = &slots_[pos & (SlotCount - 1)];
+            uint64_t seq = slot->seq.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        fill(slot->value);
+        // Publishes the entry to the consumer
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Passes each published entry, in order, to consume(const T&) and frees
+    // its slot. Returns the number of entries consumed.
+    template <typename Consume>
+    size_t drain(Consume&& consume) {
+        size_t consumed = 0;
+        while (true) {
+            Slot& slot = slots_[tail_ & (SlotCount - 1)];
+            if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) {
+                break;
+            }
+            consume(static_cast<const T&>(slot.value));
+            slot.seq.store(tail_ + SlotCount, std::memory_order_release);
+            ++tail_;
+            ++consumed;
+        }
+        return consumed;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> head_{0}; // Next slot to claim (producers)
+    uint64_t tail_ = 0;             // Next slot to drain (consumer only)
+};
+
+} // namespace leafodbc
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace leafodbc {
+
+// Stop signal for one statement execution: SQLCancel from any thread, or the
+// statement's SQL_ATTR_QUERY_TIMEOUT deadline.
+//
+// Transfers attach their easy handle while in flight, so cancel() can abort
+// them on the reactor right away; their progress callback also checks the
+// token, which covers a transfer that starts after the cancel.
+class CancelToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // timeout_sec <= 0 means no deadline
+    explicit CancelToken(int timeout_sec = 0);
+
+    void cancel();
+
+    bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+    bool expired() const { return has_deadline_ && Clock::now() >= deadline_; }
+    bool stop_requested() const { return cancelled() || expired(); }
+
+    // Milliseconds left until the deadline (at least 1), or -1 without one
+    int64_t remaining_ms() const;
+
+    // Sleeps up to delay; returns false if the execution was stopped meanwhile
+    bool wait_for(std::chrono::milliseconds delay);
+
+    // Registers an in-flight transfer; false if already stopped
+    bool attach(CURL* easy);
+    void detach(CURL* easy);
+
+    // CURLOPT_XFERINFOFUNCTION; clientp is the token
+    static int progress_callback(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
+                                 curl_off_t ultotal, curl_off_t ulnow);
+
+private:
+    std::atomic<bool> cancelled_{false};
+    bool has_deadline_ = false;
+    Clock::time_point deadline_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<CURL*> transfers_;
+};
+
+} // namespace leafodbc
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "handles.h"
+#include "resultset.h"
+#include "timings.h"
+#include <sql.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace leafodbc {
+
+class CancelToken;
+
+// Outcome of a finished query, shared by every statement that waited on it
+struct QueryOutcome {
+    SQLRETURN ret = SQL_SUCCESS;
+    std::vector<DiagRecord> diags;
+    std::shared_ptr<const ResultStore> store; // Null on failure
+    QueryTimings timings;
+    bool stopped = false; // The leader was cancelled or timed out
+};
+
+// Process-wide single-flight registry for queries.
+//
+// The first statement to run a query becomes its leader and sends it;
+// statements that issue the same query (same endpoint, user, engine and
+// normalized SQL) while it is in flight attach to it and get cursors over
+// the leader's ResultStore instead of sending their own request. Flights
+// are forgotten once they complete, so nothing is cached.
+class QueryCoalescer {
+public:
+    class Flight {
+    public:
+        // Blocks until the flight is done; false if `cancel` stopped first
+        bool wait(const CancelToken* cancel);
+
+        // Runs fn once the flight is done, right away if it already is
+        void on_done(std::function<void()> fn);
+
+        // Only valid once the flight is done
+        const QueryOutcome& outcome() const { return outcome_; }
+
+    private:
+        friend class QueryCoalescer;
+        std::string key_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool done_ = false;
+        QueryOutcome outcome_;
+        std::vector<std::function<void()>> callbacks_;
+    };
+
+    static QueryCoalescer& instance();
+
+    // Returns the flight in progress for key, or starts a new one. `leader` is
+    // set when the caller has to run the query and then call complete().
+    std::shared_ptr<Flight> join(const std::string& key, bool& leader);
+    void complete(const std::shared_ptr<Flight>& flight, QueryOutcome outcome);
+
+    static std::string make_key(const std::string& endpoint, const std::string& user,
+                                const std::string& sql_engine, const std::string& sql);
+
+    // Drops comments, collapses whitespace outside quotes and drops trailing
+    // semicolons
+    static std::string normalize_sql(const std::string& sql);
+
+private:
+    QueryCoalescer() = default;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+};
+
+} // namespace leafodbc
@@ -2,6 +2,8 @@
 
 #include <sql.h>
 #include <sqlext.h>
+#include "stmt_attrs.h"
+#include "logger.h"
 #include <string>
 #include <memory>
 #include <vector>
@@ -11,18 +13,6 @@
 
 namespace leafodbc {
 
-// Logging helper
-inline bool should_log() {
-    const char* env = std::getenv("LEAFODBC_LOG");
-    return env && std::string(env) == "1";
-}
-
-inline void log(const std::string& message) {
-    if (should_log()) {
-        fprintf(stderr, "[LeafODBC] %s\n", message.c_str());
-    }
-}
-
 // Error codes
 constexpr SQLRETURN SQL_SUCCESS_WITH_INFO_LEAF = SQL_SUCCESS_WITH_INFO;
 
@@ -33,5 +23,44 @@ constexpr bool DEFAULT_REMEMBER_ME = true;
 constexpr int DEFAULT_TIMEOUT_SEC = 60;
 constexpr bool DEFAULT_VERIFY_TLS = true;
 constexpr const char* DEFAULT_USER_AGENT = "LeafODBC/0.1";
+constexpr int DEFAULT_MAX_RETRIES = 2;
+constexpr int DEFAULT_RETRY_BACKOFF_MS = 100;
+constexpr int DEFAULT_RETRY_BACKOFF_MAX_MS = 5000;
+constexpr bool DEFAULT_HEDGE_REQUESTS = false;
+constexpr int DEFAULT_HEDGE_PERCENTILE = 95;
+constexpr int DEFAULT_RETRY_BUDGET_PERCENT = 10;
+constexpr int DEFAULT_RATE_LIMIT_PER_SEC = 0;        // 0 = unlimited
+constexpr int DEFAULT_RATE_LIMIT_BURST = 0;          // 0 = same as the rate
+constexpr int DEFAULT_MAX_INFLIGHT_PER_ENDPOINT = 0; // 0 = unlimited
+constexpr int DEFAULT_MAX_INFLIGHT_PER_USER = 0;     // 0 = unlimited
+constexpr int DEFAULT_PRIORITY = SQL_LEAF_PRIORITY_NORMAL;
+constexpr bool DEFAULT_COALESCE_QUERIES = true;
+
+// Parser used to decode query responses (JsonParser)
+enum class JsonParser { Nlohmann, Simd };
+constexpr JsonParser DEFAULT_JSON_PARSER = JsonParser::Simd;
+constexpr int DEFAULT_DECODE_THREADS = 0; // 0 = one per TaskPool worker
+constexpr bool DEFAULT_LAZY_DECODE = false;
+
+// Wire format requested for query responses (ResponseFormat)
+enum class ResponseFormat { Json, NdJson, Csv };
+constexpr ResponseFormat DEFAULT_RESPONSE_FORMAT = ResponseFormat::Json;
+
+// Memory a statement's result may use before it spills to disk (MemoryBudgetMB)
+constexpr int DEFAULT_MEMORY_BUDGET_MB = 0; // 0 = no limit
+constexpr int DEFAULT_SESSION_POOL_IDLE_SEC = 0; // 0 = no pooling
+constexpr bool DEFAULT_LAZY_CONNECT = false;
+
+// Douglas-Peucker tolerance applied to WKT geometries of results (SimplifyTolerance)
+constexpr double DEFAULT_SIMPLIFY_TOLERANCE = 0.0; // 0 = full resolution
+
+// Extent queries answered from cached tiles (TileCacheSec, TilePrefetch)
+constexpr int DEFAULT_TILE_CACHE_SEC = 0; // 0 = no tile cache
+constexpr bool DEFAULT_TILE_PREFETCH = false;
+
+// Rows read by the sample probe of layer statistics (LayerStatsSample)
+constexpr int DEFAULT_LAYER_STATS_SAMPLE = 0; // 0 = no layer statistics
+// Longest wait of a GEOMETRY_COLUMNS or LAYER_STATISTICS query for a running probe
+constexpr int LAYER_STATS_WAIT_MS = 2000;
 
 } // namespace leafodbc
@@ -15,6 +15,29 @@ struct ConnectionParams {
     int timeout_sec = DEFAULT_TIMEOUT_SEC;
     bool verify_tls = DEFAULT_VERIFY_TLS;
     std::string user_agent = DEFAULT_USER_AGENT;
+    int max_retries = DEFAULT_MAX_RETRIES;
+    int retry_backoff_ms = DEFAULT_RETRY_BACKOFF_MS;
+    int retry_backoff_max_ms = DEFAULT_RETRY_BACKOFF_MAX_MS;
+    bool hedge_requests = DEFAULT_HEDGE_REQUESTS;
+    int hedge_percentile = DEFAULT_HEDGE_PERCENTILE;
+    int retry_budget_percent = DEFAULT_RETRY_BUDGET_PERCENT;
+    int rate_limit_per_sec = DEFAULT_RATE_LIMIT_PER_SEC;
+    int rate_limit_burst = DEFAULT_RATE_LIMIT_BURST;
+    int max_inflight_per_endpoint = DEFAULT_MAX_INFLIGHT_PER_ENDPOINT;
+    int max_inflight_per_user = DEFAULT_MAX_INFLIGHT_PER_USER;
+    int priority = DEFAULT_PRIORITY;
+    bool coalesce_queries = DEFAULT_COALESCE_QUERIES;
+    JsonParser json_parser = DEFAULT_JSON_PARSER;
+    int decode_threads = DEFAULT_DECODE_THREADS;
+    bool lazy_decode = DEFAULT_LAZY_DECODE;
+    ResponseFormat response_format = DEFAULT_RESPONSE_FORMAT;
+    int memory_budget_mb = DEFAULT_MEMORY_BUDGET_MB;
+    int session_pool_idle_sec = DEFAULT_SESSION_POOL_IDLE_SEC;
+    bool lazy_connect = DEFAULT_LAZY_CONNECT;
+    double simplify_tolerance = DEFAULT_SIMPLIFY_TOLERANCE;
+    int tile_cache_sec = DEFAULT_TILE_CACHE_SEC;
+    bool tile_prefetch = DEFAULT_TILE_PREFETCH;
+    int layer_stats_sample = DEFAULT_LAYER_STATS_SAMPLE;
 };
 
 class ConnectionStringParser {
@@ -28,6 +51,11 @@ private:
     static std::string to_lower(const std::string& str);
     static bool parse_bool(const std::string& value);
     static int parse_int(const std::string& value);
+    static double parse_double(const std::string& value);
+    static int parse_priority(const std::string& value);
+    static JsonParser parse_json_parser(const std::string& value);
+    static ResponseFormat parse_response_format(const std::string& value);
+    static void apply_param(ConnectionParams& params, const std::string& key, const std::string& value);
     static std::unordered_map<std::string, std::string> parse_key_value_pairs(const std::string& conn_str);
 };
 
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "common.h"
+#include "handles.h"
+#include "leaf_client.h"
+#include "cancel.h"
+#include "coalescer.h"
+#include "resultset.h"
+#include "timings.h"
+#include <sql.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace leafodbc {
+
+// One remote query execution. Inputs are copied from the statement and its
+// connection, so the job can run on another thread without the handles.
+struct ExecJob {
+    // Inputs
+    std::shared_ptr<LeafClient> client;
+    std::string endpoint;
+    std::string sql;
+    std::string sql_engine;
+    std::string username;
+    std::string password;
+    bool remember_me = DEFAULT_REMEMBER_ME;
+    RequestPriority priority = RequestPriority::Normal;
+    std::chrono::steady_clock::time_point start;
+    std::shared_ptr<CancelToken> cancel; // Also set on the client
+    bool coalesce = DEFAULT_COALESCE_QUERIES;
+    double simplify_tolerance = 0.0; // Part of the coalescing key: it changes the result
+    std::string layer_stats_key; // If set, the result is added to the table's layer statistics
+    
+    // Decoded response, handed to the result set once loaded
+    std::shared_ptr<ResultStore> result_store;
+    
+    // Outputs
+    SQLRETURN ret = SQL_SUCCESS;
+    std::vector<DiagRecord> diags;
+    std::unique_ptr<ResultSet> resultset;
+    QueryTimings timings;
+    std::string new_token; // Set when the job had to reauthenticate
+    
+    // Runs the whole job on the calling thread
+    void run();
+    
+    // Continues after the first query attempt: reauthenticates and retries
+    // once after a 401, then loads the result set and hands it to any
+    // statements that joined this execution. Blocks during the retry.
+    void finish(bool query_ok);
+    
+    // finish() for the completion of an asynchronous attempt: the retry is
+    // asynchronous too, and `done` runs once the job is finished. A worker
+    // must not block on the scheduler, as the ticket it waits for may only
+    // be released by another worker.
+    void finish_async(bool query_ok, std::function<void()> done);
+    
+    // Attaches to an identical query already in flight. Returns false if
+    // this job has to send the query itself (it then leads the flight).
+    bool follow();
+    const std::shared_ptr<QueryCoalescer::Flight>& flight() const { return flight_; }
+    
+    // Takes over the outcome of the finished flight. Returns false if the
+    // leader was cancelled or timed out, in which case the job must run again.
+    bool finish_following();
+    
+private:
+    std::shared_ptr<QueryCoalescer::Flight> flight_;
+    bool leader_ = false;
+    bool stopped_ = false;
+    
+    // True after a 401 of the first attempt, which warrants reauthenticating
+    // and a second attempt; other failures are reported by load_result
+    bool needs_reauthentication(bool query_ok);
+    // Takes the new token, or fails the job; false if the job failed
+    bool reauthenticated(bool auth_ok);
+    void load_result(bool query_ok);
+    // Hands the outcome to the statements that joined this execution
+    void complete_flight();
+    void fail(const std::string& sqlstate, SQLINTEGER native_error, const std::string& message);
+    // Fails with HY008 or HYT00 if the query was stopped by SQLCancel or a timeout
+    bool fail_if_stopped();
+};
+
+// Asynchronous execution pending on a statement (SQL_ATTR_ASYNC_ENABLE).
+// The application polls by calling the same function again until it stops
+// returning SQL_STILL_EXECUTING.
+struct AsyncExec {
+    SQLUSMALLINT function_id = 0; // SQL_API_SQLEXECDIRECT or SQL_API_SQLEXECUTE
+    ExecJob job;
+    std::atomic<bool> done{false};
+    
+    // ODBC 3.8 notification, called once the job is done. Set before
+    // start(), or later through notify_when_done().
+    AsyncNotificationCallback callback = nullptr;
+    SQLPOINTER context = nullptr;
+    
+    // Returns immediately; network I/O runs on the reactor and decoding on a
+    // TaskPool worker, so no thread is tied up per pending statement
+    static void start(std::shared_ptr<AsyncExec> op);
+    
+    // Blocks until the job is done
+    void wait();
+    
+    // Installs the notification callback of a running job; false if the job
+    // is already done, in which case the callback is not called
+    bool notify_when_done(AsyncNotificationCallback notify, SQLPOINTER notify_context);
+    
+private:
+    std::mutex mutex_;
+    std::condition_variable done_cv_;
+    
+    void complete();
+};
+
+} // namespace leafodbc
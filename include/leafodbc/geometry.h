@@ -0,0 +1,74 @@
+#pragma once
+
+#include "result_store.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace leafodbc {
+
+// Axis-aligned bounding box, in coordinate units
+struct Bounds {
+    double min_x = 0;
+    double min_y = 0;
+    double max_x = 0;
+    double max_y = 0;
+
+    bool intersects(const Bounds& other) const {
+        return min_x <= other.max_x && other.min_x <= max_x && min_y <= other.max_y && other.min_y <= max_y;
+    }
+};
+
+// Bounding box of the vertices of a WKT geometry, and their number if
+// `vertices` is set; false if `wkt` is not WKT or has no vertices
+bool wkt_bounds(std::string_view wkt, Bounds& bounds, size_t* vertices = nullptr);
+
+// Douglas-Peucker simplification of WKT geometries (SimplifyTolerance).
+//
+// Linestrings and polygon rings lose every vertex closer than the tolerance
+// to the line through the vertices kept around it, in coordinate units.
+// Points are left alone, a linestring keeps its two end points and a closed
+// ring keeps at least four vertices, so simplified geometries stay valid
+// for rendering. Kept vertices are copied verbatim, Z and M included, and
+// the simplified text is never longer than the original.
+class WktSimplifier {
+public:
+    explicit WktSimplifier(double tolerance) : tolerance_sq_(tolerance * tolerance) {}
+
+    // Writes the simplified geometry to `out`. Returns false, leaving `out`
+    // unspecified, if `wkt` is not WKT or no vertex could be removed.
+    bool simplify(std::string_view wkt, std::string& out);
+
+    // Vertices removed so far
+    size_t removed_vertices() const { return removed_; }
+
+    // Whether `text` starts like a WKT (or EWKT) geometry
+    static bool looks_like_wkt(std::string_view text);
+
+private:
+    double tolerance_sq_;
+    size_t removed_ = 0;
+
+    // Scratch space of one coordinate list, reused between geometries
+    std::vector<std::string_view> vertices_;
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> distance_;
+    std::vector<char> keep_;
+    std::vector<std::pair<size_t, size_t>> stack_;
+
+    // Appends the simplified coordinate list `list` (the text between its
+    // parentheses) to `out`. Returns false if nothing was removed.
+    bool simplify_list(std::string_view list, bool ring, std::string& out);
+    void douglas_peucker(size_t first, size_t last);
+    // Vertex strictly between first and last farthest from the segment
+    // joining them, and its squared distance (-1 and last if there is none)
+    size_t farthest(size_t first, size_t last, double& distance_sq);
+};
+
+// Simplifies in place every WKT value of the result's text columns. Must
+// happen before the store is shared. Returns the number of vertices removed.
+size_t simplify_geometries(ResultStore& store, double tolerance);
+
+} // namespace leafodbc
@@ -1,12 +1,18 @@
 #pragma once
 
 #include "common.h"
+#include "timings.h"
+#include "request_policy.h"
+#include "scheduler.h"
+#include "arena.h"
 #include <sql.h>
 #include <sqlext.h>
 #include <string>
 #include <vector>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
 #include <cstdint>
 
@@ -44,6 +50,22 @@ struct EnvHandle {
     bool is_valid() const { return true; }
 };
 
+class LeafClient;
+
+// Authentication left running in the background by a LazyConnect connect
+struct PendingConnect {
+    std::shared_ptr<LeafClient> client; // Alive until the request is done
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    bool ok = false;
+    std::string auth_token;
+    std::chrono::system_clock::time_point token_obtained_at;
+    
+    // Blocks until the authentication is done
+    void wait();
+};
+
 // Connection handle
 struct ConnHandle {
     std::string endpoint_base = DEFAULT_ENDPOINT_BASE;
@@ -55,6 +77,42 @@ struct ConnHandle {
     bool verify_tls = DEFAULT_VERIFY_TLS;
     std::string user_agent = DEFAULT_USER_AGENT;
     
+    // Retry/hedge state shared by every request on this connection
+    std::shared_ptr<RequestPolicy> request_policy;
+    
+    // Scheduler limits and default priority of new statements
+    SchedulerLimits scheduler_limits;
+    int default_priority = DEFAULT_PRIORITY;
+    
+    // Identical in-flight queries share one request (CoalesceQueries)
+    bool coalesce_queries = DEFAULT_COALESCE_QUERIES;
+    
+    // How query responses are requested and decoded
+    JsonParser json_parser = DEFAULT_JSON_PARSER;
+    int decode_threads = DEFAULT_DECODE_THREADS;
+    bool lazy_decode = DEFAULT_LAZY_DECODE;
+    ResponseFormat response_format = DEFAULT_RESPONSE_FORMAT;
+    int memory_budget_mb = DEFAULT_MEMORY_BUDGET_MB; // Default of SQL_ATTR_LEAF_MEMORY_BUDGET_MB
+    double simplify_tolerance = DEFAULT_SIMPLIFY_TOLERANCE; // Default of SQL_ATTR_LEAF_SIMPLIFY_TOLERANCE
+    
+    // Extent queries are answered from cached tiles (TileCacheSec, TilePrefetch)
+    int tile_cache_sec = DEFAULT_TILE_CACHE_SEC;
+    bool tile_prefetch = DEFAULT_TILE_PREFETCH;
+    
+    // GEOMETRY_COLUMNS and LAYER_STATISTICS report computed statistics (LayerStatsSample)
+    int layer_stats_sample = DEFAULT_LAYER_STATS_SAMPLE;
+    
+    // Recycles the memory of this connection's results once released
+    std::shared_ptr<ArenaPool> arena_pool = ArenaPool::create();
+    
+    // Idle time of the session in the SessionPool after SQLDisconnect
+    int session_pool_idle_sec = DEFAULT_SESSION_POOL_IDLE_SEC;
+    
+    // Connect returns before authentication is done (LazyConnect); the
+    // first remote query takes over pending_connect, waiting if needed
+    bool lazy_connect = DEFAULT_LAZY_CONNECT;
+    std::shared_ptr<PendingConnect> pending_connect;
+    
     // Auth state
     std::string auth_token;
     std::chrono::system_clock::time_point token_obtained_at;
@@ -67,8 +125,14 @@ struct ConnHandle {
     bool is_connected() const { return token_valid && !auth_token.empty(); }
 };
 
-// Forward declaration
+// Forward declarations
 class ResultSet;
+struct AsyncExec;
+class CancelToken;
+
+// ODBC 3.8 notification callback installed by the Driver Manager through
+// SQL_ATTR_ASYNC_STMT_PCALLBACK (SQL_ASYNC_NOTIFICATION_CALLBACK in sqlspi.h)
+typedef SQLRETURN (SQL_API* AsyncNotificationCallback)(SQLPOINTER context, int last);
 
 // Statement handle
 struct StmtHandle {
@@ -79,6 +143,35 @@ struct StmtHandle {
     SQLULEN current_row = 0;
     bool executed = false;
     
+    // Timing breakdown of the last execution
+    QueryTimings timings;
+    bool timing_diag = false; // SQL_ATTR_LEAF_TIMING_DIAG
+    int priority = DEFAULT_PRIORITY; // SQL_ATTR_LEAF_PRIORITY
+    SQLULEN query_timeout = 0; // SQL_ATTR_QUERY_TIMEOUT in seconds; 0 uses the connection timeout
+    SQLULEN memory_budget_mb = 0; // SQL_ATTR_LEAF_MEMORY_BUDGET_MB; 0 = no limit
+    SQLULEN cursor_type = SQL_CURSOR_FORWARD_ONLY; // SQL_ATTR_CURSOR_TYPE
+    SQLULEN max_rows = 0; // SQL_ATTR_MAX_ROWS; 0 = all rows
+    double simplify_tolerance = 0.0; // SQL_ATTR_LEAF_SIMPLIFY_TOLERANCE; 0 = full resolution
+    
+    // Asynchronous execution (SQL_ATTR_ASYNC_ENABLE)
+    bool async_enable = false;
+    AsyncNotificationCallback async_callback = nullptr; // SQL_ATTR_ASYNC_STMT_PCALLBACK
+    SQLPOINTER async_context = nullptr;                 // SQL_ATTR_ASYNC_STMT_PCONTEXT
+    std::shared_ptr<AsyncExec> async_exec;              // Pending execution, if any
+    
+    // Remaining statements of a batch, in order, each running or done;
+    // SQLMoreResults moves to the next one
+    std::deque<std::shared_ptr<AsyncExec>> batch_results;
+    
+    // Stop signal of the current execution. SQLCancel runs while another
+    // thread holds `mutex`, so it only takes `cancel_mutex`.
+    std::shared_ptr<CancelToken> cancel_token;
+    std::mutex cancel_mutex;
+    
+    // Open fetch_batch trace span
+    int64_t fetch_trace_start_us = -1;
+    int64_t fetch_trace_rows = 0;
+    
     DiagStack diag;
     std::mutex mutex;
     
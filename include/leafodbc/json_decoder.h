@@ -0,0 +1,104 @@
+#pragma once
+
+#include "common.h"
+#include "result_store.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace leafodbc {
+
+struct DecodeOptions {
+    JsonParser parser = DEFAULT_JSON_PARSER;
+    // Threads decoding a large response, the caller included; 1 decodes on
+    // the caller only and 0 uses every TaskPool worker
+    int threads = 1;
+    // Arenas of rows decoded in parallel; fresh arenas if null
+    std::shared_ptr<ArenaPool> arena_pool;
+    // Index rows instead of decoding them (LazyDecode)
+    bool lazy = false;
+    // Wire format asked of the server; the response's Content-Type decides
+    ResponseFormat format = DEFAULT_RESPONSE_FORMAT;
+    // Bytes a decoded result may hold before it spills to disk; 0 = no
+    // limit. Large responses are then decoded a few bounded ranges at a time.
+    size_t memory_budget = 0;
+    // Rows kept of a result (SQL_ATTR_MAX_ROWS); the transfer stops once
+    // they have arrived. 0 = no limit
+    size_t max_rows = 0;
+    // Douglas-Peucker tolerance of WKT values (SimplifyTolerance); 0 = off.
+    // Simplified results are decoded eagerly even with LazyDecode.
+    double simplify_tolerance = 0.0;
+};
+
+// Decodes a PointLake query response straight into rows of a
+// ResultStoreBuilder, without building a JSON DOM. Accepts the two response
+// shapes of the API: a top-level array of row objects, or an object whose
+// "rows" member holds that array (possibly wrapped in another "rows").
+// Anything else yields no rows. Returns false with `error` set on malformed
+// JSON. Both parsers produce the same rows; JsonParser::Simd falls back to
+// nlohmann::json when the driver was built without simdjson. The simd parser
+// may grow `body` by a few bytes of padding.
+//
+// Large responses are split between rows of the array and the chunks are
+// decoded concurrently, then appended in order, so the result does not
+// depend on the thread count. Under a memory budget, responses past a
+// quarter of it are split as well, and only a few chunks are decoded at a
+// time so that the builder can spill their rows.
+bool decode_json_rows(const DecodeOptions& options, std::string& body, ResultStoreBuilder& builder,
+                      std::string& error);
+
+// decode_json_rows for a body that cannot be modified, such as a response
+// spooled to disk. Only a response that cannot be split is copied whole.
+bool decode_json_rows_mapped(const DecodeOptions& options, std::string_view body, ResultStoreBuilder& builder,
+                             std::string& error);
+
+// For LazyDecode: indexes the rows of a response and moves `body` into the
+// returned store, whose cells are decoded a column at a time on first read.
+// The schema is inferred up front, as decode_json_rows does. Only the
+// structure of the rows is checked here, and a value that turns out to be
+// malformed reads as NULL. Returns null, leaving `body` alone, if the
+// response cannot be indexed; it must then be decoded with decode_json_rows.
+std::shared_ptr<ResultStore> index_json_rows(std::string& body, std::shared_ptr<Arena> arena);
+
+// Decodes an NDJSON response, one row object per line, the way
+// decode_json_rows decodes the elements of a rows array. Blank lines are
+// skipped. Large responses are split between lines and decoded in parallel.
+bool decode_ndjson_rows(const DecodeOptions& options, std::string& body, ResultStoreBuilder& builder,
+                        std::string& error);
+
+// decode_ndjson_rows for a body that cannot be modified; lines are copied a
+// range at a time
+bool decode_ndjson_rows_mapped(const DecodeOptions& options, std::string_view body,
+                               ResultStoreBuilder& builder, std::string& error);
+
+// Decodes one chunk of a response into `builder`
+using ChunkDecoder = std::function<bool(std::string_view chunk, ResultStoreBuilder& builder, std::string& error)>;
+
+// Threads that should decode a response of `bytes`; 1 if it is too small to split
+size_t parallel_decode_threads(const DecodeOptions& options, size_t bytes);
+
+// Whether a response of `bytes` is decoded in ranges: on several threads,
+// or to keep it inside the memory budget
+bool decode_in_ranges(const DecodeOptions& options, size_t threads, size_t bytes);
+
+// Splits body[begin, end) after newlines into ranges of about the size that
+// suits `threads`, smaller under a memory budget. With `csv_quotes`,
+// newlines inside double-quoted CSV fields are not cut at.
+std::vector<std::pair<size_t, size_t>> split_lines(std::string_view body, size_t begin, size_t end,
+                                                   size_t threads, bool csv_quotes, size_t memory_budget = 0);
+
+// Decodes the given ranges of `body` on the caller and up to `threads - 1`
+// TaskPool workers, each into a builder of its own, and appends them to
+// `builder` in order; under a memory budget, `threads` ranges at a time.
+// Fails with the error of the first failed range.
+bool decode_chunks(const DecodeOptions& options, size_t threads, std::string_view body,
+                   std::vector<std::pair<size_t, size_t>> ranges, const ChunkDecoder& decode_chunk,
+                   ResultStoreBuilder& builder, std::string& error);
+
+// Whether JsonParser::Simd is backed by simdjson in this build
+bool simd_json_available();
+
+} // namespace leafodbc
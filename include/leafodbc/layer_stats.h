@@ -0,0 +1,104 @@
+#pragma once
+
+#include "geometry.h"
+#include "result_store.h"
+#include <sql.h>
+#include <array>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+namespace leafodbc {
+
+class LeafClient;
+
+// Spatial statistics of a table's geometry column, from a sample probe and
+// from the results of queries on the table (LayerStatsSample). They give
+// GDAL/OGR the geometry type, SRID and extent of a layer without a scan.
+struct LayerStats {
+    std::string geometry_column;
+    uint64_t rows = 0;       // Rows the statistics were computed from
+    uint64_t geometries = 0; // Of those, with a WKT geometry
+    uint64_t vertices = 0;
+    uint64_t max_vertices = 0;
+    bool has_extent = false;
+    Bounds extent; // Of the rows seen, so a lower bound of the table's
+    // Geometries by GEOMETRY_COLUMNS type code (0 to 11)
+    std::array<uint64_t, 12> type_counts{};
+    // Geometries by SRID; WKT without an EWKT SRID counts as 4326
+    std::map<SQLINTEGER, uint64_t> srid_counts;
+
+    // Adds one value of the geometry column
+    void add(const Value& value);
+    void merge(const LayerStats& other);
+
+    // Common type of the geometries: the type if all have the same, the
+    // multi type if they mix a type with its multi type, else 0 (generic)
+    SQLINTEGER geometry_type() const;
+    // Most frequent SRID, 4326 if none was seen
+    SQLINTEGER srid() const;
+};
+
+// Statistics of the first column of `store` whose first non-null value is
+// WKT, computed in parallel over row ranges on the TaskPool. False if the
+// store has no such column.
+bool compute_layer_stats(const ResultStore& store, LayerStats& stats);
+
+// Process-wide statistics per endpoint, user and table.
+class LayerStatsCache {
+public:
+    // Percent of a table read by the sample probe (TABLESAMPLE)
+    static constexpr int PROBE_SAMPLE_PERCENT = 1;
+
+    static LayerStatsCache& instance();
+
+    static std::string make_key(const std::string& endpoint, const std::string& username, const std::string& table);
+
+    // Statistics of the table; false if none were computed yet
+    bool get(const std::string& key, LayerStats& stats);
+
+    // Starts the sample probe of `table`'s `geometry_column` on `client`,
+    // unless statistics exist or the table was probed before; a probe that
+    // found nothing is not repeated, query results still add statistics
+    // then. The probe reads
+    // `sample_rows` rows of a TABLESAMPLE, or the first ones if the engine
+    // rejects TABLESAMPLE or the sample is empty.
+    void probe(const std::string& key, std::shared_ptr<LeafClient> client, const std::string& sql_engine,
+               const std::string& table, const std::string& geometry_column, size_t sample_rows);
+
+    // Waits up to `timeout` for a running probe of the table
+    void wait_probe(const std::string& key, std::chrono::milliseconds timeout);
+
+    // Adds the statistics of a query result in the background. Results
+    // spilled to disk are skipped rather than read back.
+    void observe(const std::string& key, std::shared_ptr<const ResultStore> store);
+
+private:
+    LayerStatsCache() = default;
+    LayerStatsCache(const LayerStatsCache&) = delete;
+    LayerStatsCache& operator=(const LayerStatsCache&) = delete;
+
+    struct Entry {
+        bool has_stats = false;
+        LayerStats stats;
+        bool probing = false;
+        bool probed = false;
+    };
+    struct Probe;
+
+    std::mutex mutex_;
+    std::condition_variable probe_cv_;
+    std::unordered_map<std::string, Entry> entries_;
+
+    void add(const std::string& key, const LayerStats& stats);
+    void run_probe(std::shared_ptr<Probe> probe, bool sampled);
+    void end_probe(const std::string& key);
+};
+
+} // namespace leafodbc
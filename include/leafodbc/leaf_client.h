@@ -1,9 +1,18 @@
 #pragma once
 
 #include "common.h"
+#include "timings.h"
+#include "request_policy.h"
+#include "scheduler.h"
+#include "cancel.h"
+#include "result_store.h"
+#include "json_decoder.h"
+#include "response_decoder.h"
 #include <string>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <functional>
 #include <nlohmann/json.hpp>
 
 namespace leafodbc {
@@ -14,26 +23,144 @@ public:
                int timeout_sec, bool verify_tls);
     
     bool authenticate(const std::string& username, const std::string& password, bool remember_me);
+    
+    // Same as authenticate without blocking the caller; `done` runs on a
+    // TaskPool worker and the client must stay alive until then
+    void authenticate_async(const std::string& username, const std::string& password, bool remember_me,
+                            std::function<void(bool ok)> done);
     bool is_authenticated() const { return !auth_token_.empty(); }
     std::string get_token() const { return auth_token_; }
     
+    // Decodes the rows into `result`, allocated from the client's arena pool
     bool execute_query(const std::string& sql, const std::string& sql_engine, 
-                      nlohmann::json& result);
+                      std::shared_ptr<ResultStore>& result, RequestPriority priority = RequestPriority::Normal);
+    
+    // Same as execute_query without blocking the caller: network I/O runs on
+    // the reactor and `done` runs on a TaskPool worker once the response is
+    // decoded. Hedging is not used. The client and `result` must stay alive
+    // until `done` has been called.
+    void execute_query_async(const std::string& sql, const std::string& sql_engine,
+                             std::shared_ptr<ResultStore>& result, RequestPriority priority,
+                             std::function<void(bool ok)> done);
     
     void set_token(const std::string& token) { auth_token_ = token; }
     void clear_token() { auth_token_.clear(); }
     
+    // Network and decode timings of the last request
+    const QueryTimings& last_timings() const { return timings_; }
+    
+    // HTTP status of the last request (0 if no response was received)
+    int last_status_code() const { return last_status_code_; }
+    
+    // CURLcode of the last request
+    int last_curl_code() const { return last_curl_code_; }
+    
+    // Retry/hedge policy shared by all requests of a connection
+    void set_request_policy(std::shared_ptr<RequestPolicy> policy) { policy_ = std::move(policy); }
+    
+    // Admission limits applied by the process-wide scheduler to requests of `user`
+    void set_scheduling(const std::string& user, const SchedulerLimits& limits) {
+        scheduler_user_ = user;
+        scheduler_limits_ = limits;
+    }
+    
+    // Stops requests, retries and admission waits once cancelled or past its
+    // deadline; such requests fail with CURLE_ABORTED_BY_CALLBACK
+    void set_cancel_token(std::shared_ptr<CancelToken> cancel) { cancel_ = std::move(cancel); }
+    
+    // Requested response format, parser, decode threads and the arenas
+    // results are allocated from (a fresh arena per result if no pool is set)
+    void set_decode_options(const DecodeOptions& options) { decode_options_ = options; }
+    
+    // Answers extent queries from the process-wide TileCache with tiles up
+    // to max_age_sec old (0 = off); with `prefetch`, the tiles around each
+    // answered extent are then fetched in the background
+    void set_tile_cache(int max_age_sec, bool prefetch) {
+        tile_cache_sec_ = max_age_sec;
+        tile_prefetch_ = prefetch;
+    }
+    
 private:
     std::string endpoint_base_;
     std::string user_agent_;
     int timeout_sec_;
     bool verify_tls_;
     std::string auth_token_;
+    QueryTimings timings_;
+    int last_status_code_ = 0;
+    int last_curl_code_ = 0;
+    std::string last_content_type_;
+    // Body of the last response, when it was too large for the memory budget
+    std::shared_ptr<BodySpool> body_spool_;
+    std::shared_ptr<RequestPolicy> policy_;
+    std::string scheduler_user_;
+    SchedulerLimits scheduler_limits_;
+    std::shared_ptr<CancelToken> cancel_;
+    DecodeOptions decode_options_;
+    int tile_cache_sec_ = 0;
+    bool tile_prefetch_ = false;
+    
+    // One HTTP exchange
+    struct HttpAttempt {
+        std::string response;
+        std::unique_ptr<BodySpool> spool; // Instead of response, past half the memory budget
+        int status_code = 0;
+        std::string content_type;
+        int curl_code = 0;
+        int retry_after_ms = 0;
+        int64_t wall_us = 0;
+        QueryTimings timings;
+    };
     
     std::string build_url(const std::string& path) const;
+    std::string build_query_url(const std::string& sql_engine) const;
+    std::vector<std::string> build_query_headers() const;
+    std::string build_auth_body(const std::string& username, const std::string& password, bool remember_me) const;
+    bool handle_auth_response(bool sent, int status_code, const std::string& response);
+    bool handle_query_response(bool sent, int status_code, std::string& response,
+                               std::shared_ptr<ResultStore>& result);
+    // Cuts a result to DecodeOptions::max_rows rows, simplifies its
+    // geometries and moves it to disk if larger than DecodeOptions::memory_budget
+    void apply_result_limits(ResultStore& store);
     bool http_post(const std::string& url, const std::string& body, 
-                   const std::vector<std::string>& headers, std::string& response, int& status_code);
+                   const std::vector<std::string>& headers, std::string& response, int& status_code,
+                   bool hedgeable, RequestPriority priority);
+    // Requests run on the shared Reactor; the calling thread only waits
+    struct Transfer;
+    std::unique_ptr<Transfer> start_transfer(const std::string& url, const std::string& body,
+                                             const std::vector<std::string>& headers,
+                                             RequestScheduler::Ticket ticket, HttpAttempt& attempt,
+                                             std::function<void()> on_done);
+    void finish_transfer(Transfer& transfer);
+    void perform(const std::string& url, const std::string& body,
+                 const std::vector<std::string>& headers, RequestPriority priority,
+                 HttpAttempt& attempt);
+    void perform_hedged(const std::string& url, const std::string& body,
+                        const std::vector<std::string>& headers, RequestPriority priority,
+                        int64_t hedge_delay_us, HttpAttempt& result);
+    bool should_retry(const HttpAttempt& attempt, int retry, int max_retries, int& delay_ms);
+    void complete_post(HttpAttempt& attempt, int64_t queue_wait_us);
+    
+    // Asynchronous POST: admission and retries wait in the scheduler and on
+    // reactor timers, not on a thread
+    struct AsyncPost;
+    void http_post_async(std::shared_ptr<AsyncPost> op);
+    void start_async_attempt(std::shared_ptr<AsyncPost> op);
+    void finish_async_attempt(std::shared_ptr<AsyncPost> op);
+    void retry_async_after(std::shared_ptr<AsyncPost> op, int delay_ms);
+    
+    // Extent query answered tile by tile (TileCacheSec)
+    struct TiledQuery;
+    std::shared_ptr<TiledQuery> make_tiled_query(const std::string& sql, const std::string& sql_engine,
+                                                 RequestPriority priority) const;
+    // Calls query->done from another thread if `async`, else possibly from this one
+    void execute_tiled(std::shared_ptr<TiledQuery> query, bool async);
+    void finish_tiled(std::shared_ptr<TiledQuery> query);
+    void prefetch_tiles(const TiledQuery& query);
+    // Client for one tile request: same session and settings, whole tiles
+    std::shared_ptr<LeafClient> make_tile_client() const;
     std::string escape_json_string(const std::string& str) const;
+    static void read_timings(void* curl, QueryTimings& timings);
 };
 
 } // namespace leafodbc
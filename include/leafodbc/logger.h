@@ -0,0 +1,101 @@
+#pragma once
+
+#include "bounded_ring.h"
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+
+namespace leafodbc {
+
+enum class LogLevel : int {
+    Off = 0,
+    Error = 1,
+    Warn = 2,
+    Info = 3,
+    Debug = 4
+};
+
+// Current threshold; negative until the configuration has been read
+extern std::atomic<int> g_log_level;
+
+int init_log_level();
+
+// Small sequential number identifying the calling thread in logs and traces
+uint64_t current_thread_number();
+
+// Hot-path level check: one relaxed atomic load once configured
+inline bool log_enabled(LogLevel level) {
+    int current = g_log_level.load(std::memory_order_relaxed);
+    if (current < 0) {
+        current = init_log_level();
+    }
+    return static_cast<int>(level) <= current;
+}
+
+// Leveled asynchronous logger.
+//
+// Configuration is read once from the environment:
+//   LEAFODBC_LOG       = 1 | error | warn | info | debug   (1 means debug)
+//   LEAFODBC_LOG_FILE  = path to append to (default: stderr)
+//
+// Callers format straight into a slot of a bounded lock-free ring buffer;
+// a background thread drains it to the sink. When the ring is full the
+// message is dropped and counted instead of blocking the caller.
+class Logger {
+public:
+    static Logger& instance();
+    ~Logger();
+
+    void write(LogLevel level, const char* fmt, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 3, 4)))
+#endif
+        ;
+
+private:
+    static constexpr size_t SLOT_COUNT = 2048; // power of two
+    static constexpr size_t TEXT_SIZE = 480;
+
+    struct Message {
+        int64_t timestamp_us;
+        uint64_t thread_id;
+        LogLevel level;
+        uint32_t length;
+        char text[TEXT_SIZE];
+    };
+
+    Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void drain_loop();
+    bool drain_once();
+    void emit(const Message& message);
+
+    BoundedRing<Message, SLOT_COUNT> ring_;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> stopping_{false};
+    int configured_level_ = 0;
+    FILE* sink_ = nullptr;
+    bool owns_sink_ = false;
+    std::thread drain_thread_;
+
+    friend int init_log_level();
+};
+
+} // namespace leafodbc
+
+// Arguments are only evaluated when the level is enabled
+#define LEAF_LOG(level, ...) \
+    do { \
+        if (::leafodbc::log_enabled(level)) { \
+            ::leafodbc::Logger::instance().write(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LEAF_LOG_ERROR(...) LEAF_LOG(::leafodbc::LogLevel::Error, __VA_ARGS__)
+#define LEAF_LOG_WARN(...)  LEAF_LOG(::leafodbc::LogLevel::Warn, __VA_ARGS__)
+#define LEAF_LOG_INFO(...)  LEAF_LOG(::leafodbc::LogLevel::Info, __VA_ARGS__)
+#define LEAF_LOG_DEBUG(...) LEAF_LOG(::leafodbc::LogLevel::Debug, __VA_ARGS__)
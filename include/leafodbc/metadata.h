@@ -2,13 +2,27 @@
 
 #include "common.h"
 #include "resultset.h"
+#include "layer_stats.h"
 #include <sql.h>
+#include <functional>
 #include <string>
+#include <vector>
 
 namespace leafodbc {
 
+// Table with a geometry column, as listed in GEOMETRY_COLUMNS
+struct SpatialTable {
+    const char* catalog;
+    const char* schema;
+    const char* table;
+    const char* geometry_column;
+};
+
 class Metadata {
 public:
+    // Fills `stats` with the layer statistics of `table`; false if none
+    using LayerStatsLookup = std::function<bool(const SpatialTable& table, LayerStats& stats)>;
+
     // SQLTables: list tables
     static std::unique_ptr<ResultSet> get_tables(
         const std::string& catalog_pattern,
@@ -25,14 +39,25 @@ public:
         const std::string& column_pattern
     );
     
-    // GEOMETRY_COLUMNS virtual table
-    static std::unique_ptr<ResultSet> get_geometry_columns();
+    // Tables with a geometry column
+    static const std::vector<SpatialTable>& spatial_tables();
+    
+    // GEOMETRY_COLUMNS virtual table; type and SRID come from the layer
+    // statistics of each table if there are any
+    static std::unique_ptr<ResultSet> get_geometry_columns(const LayerStatsLookup& lookup = nullptr);
+    
+    // LAYER_STATISTICS virtual table: extent, type, SRID and vertex counts
+    // of each table (NULL until statistics are computed)
+    static std::unique_ptr<ResultSet> get_layer_statistics(const LayerStatsLookup& lookup);
     
     // Check if a table is GEOMETRY_COLUMNS
     static bool is_geometry_columns_table(const std::string& catalog, 
                                          const std::string& schema,
                                          const std::string& table);
     
+    // Check if a table is LAYER_STATISTICS
+    static bool is_layer_statistics_table(const std::string& table);
+    
     // Get geometry type from WKT prefix
     static SQLINTEGER infer_geometry_type(const std::string& wkt);
     
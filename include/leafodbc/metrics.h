@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+namespace leafodbc {
+
+// Monotonic counter
+class Counter {
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Value that can go up and down
+class Gauge {
+public:
+    void inc(int64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void dec(int64_t n = 1) { value_.fetch_sub(n, std::memory_order_relaxed); }
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Latency histogram with fixed buckets (upper bounds in microseconds)
+class Histogram {
+public:
+    static constexpr size_t BUCKET_COUNT = 14;
+    static const std::array<uint64_t, BUCKET_COUNT> BOUNDS_US;
+
+    void observe_us(int64_t us);
+
+    uint64_t bucket(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum_us() const { return sum_us_.load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT + 1> buckets_{}; // last is +Inf
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_us_{0};
+};
+
+// Process-wide metrics. Updates are relaxed atomics, so instrumented paths
+// never take a lock. If LEAFODBC_METRICS_FILE is set, a background thread
+// rewrites that file in OpenMetrics text format every
+// LEAFODBC_METRICS_INTERVAL_SEC seconds (default 15).
+class Metrics {
+public:
+    static Metrics& instance();
+    ~Metrics();
+
+    Counter queries;
+    Counter query_errors;
+    Counter bytes_received;
+    Counter auth_calls;
+    Counter auth_failures;
+    Counter retries;
+    Counter hedges;
+    Counter retry_budget_exhausted;
+    Counter cache_hits;
+    Counter cache_misses;
+    Counter http_connections_opened;
+    Counter statements_cancelled;
+    Counter statement_timeouts;
+    Counter coalesced_queries;
+    Counter result_spills;
+    Counter spilled_bytes;
+    Counter batched_statements;
+    Counter sessions_reused;
+    Counter simplified_vertices;
+    Counter tile_hits;
+    Counter tile_misses;
+    Counter tiles_prefetched;
+    Counter layer_probes;
+    Counter layer_stats_rows;
+
+    Gauge open_env_handles;
+    Gauge open_conn_handles;
+    Gauge open_stmt_handles;
+    Gauge pooled_sessions;
+    Gauge tile_cache_bytes;
+    Gauge scheduler_queue_depth;
+
+    Histogram http_request_latency;
+    Histogram statement_latency;
+    Histogram scheduler_wait;
+
+    // Render all metrics in OpenMetrics text format
+    std::string render() const;
+
+private:
+    Metrics();
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void dump_loop();
+    bool write_file() const;
+
+    std::string dump_path_;
+    int dump_interval_sec_ = 15;
+    std::thread dump_thread_;
+    std::mutex dump_mutex_;
+    std::condition_variable dump_cv_;
+    bool stopping_ = false;
+};
+
+} // namespace leafodbc
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <functional>
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+namespace leafodbc {
+
+// Driver-owned network event loop.
+//
+// A single I/O thread drives every HTTP transfer of the process through the
+// curl multi socket API. All transfers share one connection cache, so
+// requests to the same endpoint reuse connections and, over HTTPS, are
+// multiplexed as HTTP/2 streams on a single connection. Callers hand over a
+// configured easy handle and block on a future (or callback) instead of
+// inside curl_easy_perform.
+class Reactor {
+public:
+    // Runs on the I/O thread, exactly once per submitted transfer
+    using Completion = std::function<void(CURLcode result)>;
+
+    static Reactor& instance();
+    ~Reactor();
+
+    // Starts a configured easy handle. The handle belongs to the reactor
+    // until on_done has run.
+    void submit(CURL* easy, Completion on_done);
+
+    // Stops a submitted transfer; on_done receives CURLE_ABORTED_BY_CALLBACK
+    // unless the transfer already finished
+    void cancel(CURL* easy);
+
+    // Runs fn on the I/O thread once delay has passed; fn must not block
+    void post_after(std::chrono::milliseconds delay, std::function<void()> fn);
+
+private:
+    Reactor();
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    struct Command {
+        CURL* easy;
+        Completion on_done; // empty for cancellation
+    };
+
+    void run();
+    void wake();
+    void process_commands();
+    void finish(CURL* easy, CURLcode result);
+    void read_completions();
+    void run_due_timers();
+
+    static int socket_callback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp);
+    static int timer_callback(CURLM* multi, long timeout_ms, void* userp);
+
+    CURLM* multi_ = nullptr;
+    int wake_fds_[2] = {-1, -1};
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::vector<Command> commands_;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> timers_;
+    bool stopping_ = false;
+
+    // Owned by the I/O thread
+    std::unordered_map<curl_socket_t, int> sockets_; // socket -> CURL_POLL_* mask
+    std::unordered_map<CURL*, Completion> transfers_;
+    bool timer_armed_ = false;
+    std::chrono::steady_clock::time_point timer_deadline_;
+};
+
+} // namespace leafodbc
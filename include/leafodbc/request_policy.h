@@ -0,0 +1,64 @@
+#pragma once
+
+#include "common.h"
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+namespace leafodbc {
+
+struct RequestPolicyConfig {
+    int max_retries = DEFAULT_MAX_RETRIES;
+    int backoff_base_ms = DEFAULT_RETRY_BACKOFF_MS;
+    int backoff_max_ms = DEFAULT_RETRY_BACKOFF_MAX_MS;
+    bool hedge_requests = DEFAULT_HEDGE_REQUESTS;
+    int hedge_percentile = DEFAULT_HEDGE_PERCENTILE;
+    int retry_budget_percent = DEFAULT_RETRY_BUDGET_PERCENT;
+};
+
+// Per-connection retry/hedge policy.
+//
+// Retries use exponential backoff with full jitter. Every request deposits
+// retry_budget_percent/100 of a token into a bucket and every retry or hedge
+// withdraws a whole token, so during an outage extra load is capped at that
+// percentage of normal traffic (plus a small reserve for quiet connections).
+class RequestPolicy {
+public:
+    explicit RequestPolicy(const RequestPolicyConfig& config);
+
+    const RequestPolicyConfig& config() const { return config_; }
+
+    // 429/502/503/504 and transport failures that happen before a response
+    static bool is_retryable(int status_code, int curl_code);
+
+    // Delay before retry number `retry` (1-based), never below retry_after_ms
+    int backoff_ms(int retry, int retry_after_ms);
+
+    // Retry budget
+    void on_request();
+    bool try_spend_retry();
+
+    // Hedging: delay after which a duplicate request is sent, based on the
+    // configured percentile of recent latencies; negative until enough samples
+    void record_latency(int64_t latency_us);
+    int64_t hedge_delay_us();
+
+private:
+    static constexpr int64_t TOKEN_SCALE = 1000;          // milli-tokens
+    static constexpr int64_t BUDGET_RESERVE = 10 * TOKEN_SCALE;
+    static constexpr int64_t BUDGET_MAX = 100 * TOKEN_SCALE;
+    static constexpr size_t LATENCY_WINDOW = 128;
+    static constexpr size_t LATENCY_MIN_SAMPLES = 20;
+
+    RequestPolicyConfig config_;
+    std::atomic<int64_t> budget_;
+
+    std::mutex mutex_;
+    std::mt19937 rng_;
+    std::vector<int64_t> latencies_;
+    size_t latency_next_ = 0;
+};
+
+} // namespace leafodbc
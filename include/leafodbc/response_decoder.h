@@ -0,0 +1,104 @@
+#pragma once
+
+#include "common.h"
+#include "json_decoder.h"
+#include "result_store.h"
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace leafodbc {
+
+// Turns the body of a query response into rows of a ResultStoreBuilder.
+// Every wire format yields the same typed cells, so results do not depend
+// on the format the server answered in.
+class ResponseDecoder {
+public:
+    virtual ~ResponseDecoder() = default;
+    
+    // Returns false with `error` set if the body is malformed. May modify `body`.
+    virtual bool decode(std::string& body, ResultStoreBuilder& builder, std::string& error) = 0;
+    
+    // Same for a body that cannot be modified, such as a response spooled
+    // to disk (BodySpool)
+    virtual bool decode_mapped(std::string_view body, ResultStoreBuilder& builder, std::string& error) = 0;
+    
+    // For LazyDecode; null if the format cannot be indexed, in which case
+    // the body must be decoded
+    virtual std::shared_ptr<ResultStore> index(std::string& /*body*/, std::shared_ptr<Arena> /*arena*/) {
+        return nullptr;
+    }
+};
+
+// Follows a response body as it arrives to find where its first max_rows
+// rows end, so that the transfer can stop there. Top-level JSON arrays,
+// NDJSON and CSV are followed; other documents (an object wrapping the
+// rows, an error) never reach the limit.
+class RowLimiter {
+public:
+    RowLimiter(ResponseFormat format, size_t max_rows) : format_(format), max_rows_(max_rows) {}
+    
+    // Scans what was appended to `body` since the last call. Once max_rows
+    // rows are complete, cuts `body` after them, closes the document and
+    // returns true.
+    bool append(std::string& body);
+    
+private:
+    ResponseFormat format_;
+    size_t max_rows_;
+    size_t rows_ = 0;
+    size_t scanned_ = 0;
+    bool started_ = false;
+    bool ignored_ = false;
+    bool in_string_ = false;
+    bool escaped_ = false;
+    int depth_ = 0;
+    bool line_has_data_ = false;
+    bool header_seen_ = false;
+};
+
+// Response body written to an unlinked temporary file as it arrives, for
+// bodies too large for the memory budget, and mapped back for decoding
+class BodySpool {
+public:
+    // Null with `error` set if the file cannot be created
+    static std::unique_ptr<BodySpool> create(std::string& error);
+    ~BodySpool();
+    
+    BodySpool(const BodySpool&) = delete;
+    BodySpool& operator=(const BodySpool&) = delete;
+    
+    // Returns false once a write has failed
+    bool append(const char* data, size_t size);
+    
+    size_t size() const { return size_; }
+    
+    // The whole body, mapped read-only; empty with `error` set on failure.
+    // Nothing can be appended afterwards.
+    std::string_view map(std::string& error);
+    
+private:
+    explicit BodySpool(int fd) : fd_(fd) {}
+    
+    bool flush();
+    bool write(const char* data, size_t size);
+    
+    int fd_;
+    std::string buffer_;
+    size_t size_ = 0;
+    bool ok_ = true;
+    int error_ = 0;
+    void* data_ = nullptr;
+    size_t mapped_ = 0;
+};
+
+std::unique_ptr<ResponseDecoder> make_response_decoder(ResponseFormat format, const DecodeOptions& options);
+
+// Format of a response with the given Content-Type header; `requested` if
+// the header is missing or not recognized
+ResponseFormat response_format_of(const std::string& content_type, ResponseFormat requested);
+
+// Accept header asking for `format`, with JSON as the fallback
+const char* accept_header(ResponseFormat format);
+
+} // namespace leafodbc
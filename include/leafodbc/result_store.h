@@ -0,0 +1,318 @@
+#pragma once
+
+#include "arena.h"
+#include <sql.h>
+#include <nlohmann/json.hpp>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <functional>
+
+namespace leafodbc {
+
+struct ColumnInfo {
+    std::string name;
+    SQLSMALLINT sql_type;
+    SQLULEN column_size;
+    SQLSMALLINT decimal_digits;
+    SQLSMALLINT nullable;
+    std::string type_name;
+};
+
+// One decoded cell. Text points into the result's arena, so a Value is
+// trivially copyable and needs no destructor.
+struct Value {
+    enum class Kind : uint8_t { Null, Bool, Int, UInt, Double, String, Json };
+
+    union {
+        bool b;
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char* text;
+    };
+    uint32_t length = 0; // Of text
+    Kind kind = Kind::Null;
+
+    Value() : i(0) {}
+
+    static Value make_bool(bool v) { Value x; x.kind = Kind::Bool; x.b = v; return x; }
+    static Value make_int(int64_t v) { Value x; x.kind = Kind::Int; x.i = v; return x; }
+    static Value make_uint(uint64_t v) { Value x; x.kind = Kind::UInt; x.u = v; return x; }
+    static Value make_double(double v) { Value x; x.kind = Kind::Double; x.d = v; return x; }
+    // Text must already live in the arena
+    static Value make_text(Kind kind, std::string_view s) {
+        Value x;
+        x.kind = kind;
+        x.text = s.data();
+        x.length = static_cast<uint32_t>(s.size());
+        return x;
+    }
+
+    bool is_null() const { return kind == Kind::Null; }
+    bool is_number() const { return kind == Kind::Int || kind == Kind::UInt || kind == Kind::Double; }
+    std::string_view str() const { return std::string_view(text, length); }
+
+    // Same conversions nlohmann::json's get<int64_t>() / get<double>() apply
+    int64_t as_int64() const;
+    double as_double() const;
+
+    // Compact JSON text of the value, as nlohmann::json::dump() prints it
+    std::string dump() const;
+
+    // Converts a DOM value; nested objects and arrays are stored as JSON text
+    static Value from_json(const nlohmann::json& json, Arena& arena);
+};
+
+// Raw response of a result plus the location of every field, for results
+// whose cells are decoded one column at a time on first read (LazyDecode).
+// Safe to read from several threads.
+class LazyColumns {
+public:
+    static constexpr uint32_t NO_COLUMN = UINT32_MAX;
+    
+    // Location of one field value in the response
+    struct Field {
+        uint32_t column; // NO_COLUMN for keys that are not in the schema
+        uint32_t length;
+        uint64_t offset;
+    };
+    
+    // Decodes the text of one value; strings are copied into the arena
+    using DecodeFn = Value (*)(std::string_view text, Arena& arena);
+    
+    // Fields of row r are fields[row_offsets[r] .. row_offsets[r + 1])
+    LazyColumns(std::string body, std::vector<Field> fields, std::vector<size_t> row_offsets,
+                size_t column_count, DecodeFn decode);
+    
+    const Value& cell(size_t row, size_t column, Arena& arena) const;
+    
+    // Raw response, index and the columns decoded so far
+    size_t memory_bytes() const;
+    
+private:
+    std::string body_;
+    std::vector<Field> fields_;
+    std::vector<size_t> row_offsets_;
+    DecodeFn decode_;
+    
+    mutable std::unique_ptr<std::once_flag[]> decoded_;
+    mutable std::vector<std::vector<Value>> columns_;
+    mutable std::mutex arena_mutex_;
+    
+    void decode_column(size_t column, Arena& arena) const;
+};
+
+struct ResultStore;
+
+// Creates an unlinked temporary file in $TMPDIR (or /tmp) for data moved
+// out of memory. Returns its descriptor, or -1 with `error` set.
+int create_spill_file(std::string& error);
+
+// Cells of a result moved to an unlinked temporary file and mapped back
+// read-only (MemoryBudgetMB). The file holds one or more segments of
+// consecutive rows, each column-major: the 8-byte payloads of every column,
+// then their 1-byte kinds, then a heap of the strings, each behind its
+// 32-bit length. It disappears with the mapping.
+class SpilledColumns {
+    // Rows [first_row, first_row + rows) and the file offsets of their parts
+    struct Segment {
+        size_t first_row;
+        size_t rows;
+        uint64_t payloads;
+        uint64_t kinds;
+        uint64_t heap;
+    };
+    
+public:
+    // Writes a spill file a segment of rows at a time, so that a result can
+    // be spilled while it is still being decoded
+    class Writer {
+    public:
+        // Null with `error` set if the file cannot be created
+        static std::unique_ptr<Writer> create(std::string& error);
+        ~Writer();
+        
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        
+        // Appends rows [first, first + count) of `store` as a segment.
+        // Returns false once a write has failed.
+        bool append(const ResultStore& store, size_t first, size_t count);
+        
+        size_t rows() const { return rows_; }
+        
+        // Maps the file back; null with `error` set if a write or the
+        // mapping failed. The writer is spent afterwards.
+        std::unique_ptr<SpilledColumns> finish(std::string& error);
+        
+    private:
+        explicit Writer(int fd);
+        
+        void put(const void* data, size_t size);
+        bool flush();
+        
+        int fd_;
+        std::vector<char> buffer_;
+        uint64_t offset_ = 0; // Of the next byte put
+        size_t rows_ = 0;
+        bool ok_ = true;
+        int error_ = 0;
+        std::vector<Segment> segments_;
+    };
+    
+    ~SpilledColumns();
+    
+    SpilledColumns(const SpilledColumns&) = delete;
+    SpilledColumns& operator=(const SpilledColumns&) = delete;
+    
+    // Writes the cells of `store` to a new spill file. Returns null with
+    // `error` set if the file cannot be written or mapped.
+    static std::unique_ptr<SpilledColumns> write(const ResultStore& store, std::string& error);
+    
+    // Strings point into the mapping
+    Value cell(size_t row, size_t column) const;
+    
+    size_t file_size() const { return size_; }
+    
+private:
+    SpilledColumns() = default;
+    
+    const Segment& segment_of(size_t row) const;
+    
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<Segment> segments_;
+};
+
+// Decoded rows and schema of one query result. Immutable once built, so
+// several statements can read it concurrently through their own cursors.
+// Cells are stored row-major in the result's arena.
+struct ResultStore {
+    std::vector<ColumnInfo> columns;
+    size_t row_count = 0;
+    std::shared_ptr<Arena> arena; // Declared before cells: destroyed after them
+    std::vector<std::shared_ptr<Arena>> chunk_arenas; // Text of rows decoded in parallel
+    std::pmr::vector<Value> cells;
+    std::unique_ptr<LazyColumns> lazy; // Instead of cells, with LazyDecode
+    std::unique_ptr<SpilledColumns> spilled; // Instead of cells and lazy, once spilled
+
+    explicit ResultStore(std::shared_ptr<Arena> result_arena = std::make_shared<Arena>(1024))
+        : arena(std::move(result_arena)), cells(arena.get()) {}
+
+    Value cell(size_t row, size_t column) const {
+        if (spilled) {
+            return spilled->cell(row, column);
+        }
+        return lazy ? lazy->cell(row, column, *arena) : cells[row * columns.size() + column];
+    }
+    
+    // Heap memory held by the cells
+    size_t memory_bytes() const;
+    
+    // Moves the cells to disk and frees their memory. Must happen before the
+    // store is shared. Returns false with `error` set, and the store
+    // unchanged, if the file cannot be written.
+    bool spill(std::string& error);
+};
+
+// Collects decoded rows and turns them into a ResultStore. Decoders call
+// begin_row and then set for each field; the schema is inferred from the
+// first SCHEMA_SAMPLE_ROWS rows, with columns in order of first appearance.
+class ResultStoreBuilder {
+public:
+    static constexpr size_t SCHEMA_SAMPLE_ROWS = 50;
+
+    explicit ResultStoreBuilder(std::shared_ptr<Arena> arena);
+
+    Arena& arena() { return *arena_; }
+
+    // Capacity hint for decoders that know the size of the result up front
+    void reserve(size_t rows, size_t fields_per_row);
+    
+    void begin_row();
+
+    // Column key of a field; fast when rows list their fields in the same order
+    uint32_t key(std::string_view name);
+    void set(uint32_t key, Value value) { entries_.push_back(Entry{key, value}); }
+
+    size_t row_count() const { return row_offsets_.size() + chunk_rows_; }
+    
+    // Caps the memory of the rows collected at `bytes` (MemoryBudgetMB; 0 =
+    // no limit): past it, the completed rows are written to a spill file as
+    // a segment and freed, and finish() returns a spilled store. `prepare`,
+    // if set, gets each segment before it is written. Rows are held until
+    // the schema sample is complete. If the file cannot be created, the rows
+    // stay in memory.
+    void set_memory_budget(size_t bytes, std::function<void(ResultStore&)> prepare = nullptr);
+    
+    // Set if rows could not be written to the spill file; the store
+    // returned by finish() then lacks them
+    const std::string& spill_error() const { return spill_error_; }
+    
+    // Places the rows of a builder that decoded a later part of the same
+    // response behind the rows collected so far. They are not copied until
+    // finish(), and no rows can be added to this builder afterwards.
+    void append(std::unique_ptr<ResultStoreBuilder> chunk);
+
+    // Schema inference and row-major layout; the builder is spent afterwards
+    std::shared_ptr<ResultStore> finish();
+    
+    // Rows between checks of the memory budget
+    static constexpr size_t BUDGET_CHECK_ROWS = 64;
+
+private:
+    struct Entry {
+        uint32_t key;
+        Value value;
+    };
+    
+    // Appended rows, with their keys mapped to this builder's
+    struct Chunk {
+        std::unique_ptr<ResultStoreBuilder> rows;
+        std::vector<uint32_t> key_map;
+    };
+
+    std::shared_ptr<Arena> arena_;
+    std::vector<std::string> key_names_;
+    std::unordered_map<std::string, uint32_t> key_ids_;
+    uint32_t next_key_hint_ = 0;
+
+    // Sparse rows: entries_[row_offsets_[r] .. row_offsets_[r + 1])
+    std::vector<Entry> entries_;
+    std::vector<size_t> row_offsets_;
+    
+    std::vector<Chunk> chunks_;
+    size_t chunk_rows_ = 0;
+    
+    // Fixed by infer_schema(), at the first spill or in finish()
+    bool schema_ready_ = false;
+    std::vector<ColumnInfo> columns_;
+    std::vector<uint32_t> column_of_key_;
+    
+    size_t memory_budget_ = 0;
+    size_t rows_unchecked_ = 0;
+    std::function<void(ResultStore&)> prepare_segment_;
+    std::unique_ptr<SpilledColumns::Writer> spill_;
+    std::string spill_error_;
+    
+    size_t row_end(size_t row) const {
+        return row + 1 < row_offsets_.size() ? row_offsets_[row + 1] : entries_.size();
+    }
+    
+    // Heap memory of the rows collected, appended chunks included
+    size_t memory_bytes() const;
+    void infer_schema();
+    // Writes the rows collected, in order, to `cells` (row-major, zeroed)
+    void layout(Value* cells) const;
+    // Moves the rows collected to the spill file once they exceed the budget
+    void check_budget();
+    void spill_rows();
+};
+
+} // namespace leafodbc
@@ -1,56 +1,58 @@
 #pragma once
 
 #include "common.h"
+#include "result_store.h"
 #include <sql.h>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <memory>
 
 namespace leafodbc {
 
-struct ColumnInfo {
-    std::string name;
-    SQLSMALLINT sql_type;
-    SQLULEN column_size;
-    SQLSMALLINT decimal_digits;
-    SQLSMALLINT nullable;
-    std::string type_name;
-};
-
+// Cursor over a ResultStore
 class ResultSet {
 public:
     ResultSet();
+    // Shares an already loaded store
+    explicit ResultSet(std::shared_ptr<const ResultStore> store);
     
-    void load_from_json(const nlohmann::json& json_data);
+    // For metadata construction, after get_columns() is set: fields are
+    // matched to columns by name, missing ones read as NULL
     void add_row(const nlohmann::json& row);
     
     SQLRETURN fetch();
+    // Moves the cursor as SQLFetchScroll does with one-row rowsets, in
+    // constant time: SQL_FETCH_NEXT, _PRIOR, _FIRST, _LAST, _ABSOLUTE or
+    // _RELATIVE. SQL_NO_DATA leaves it before the first or after the last row.
+    SQLRETURN fetch_scroll(SQLSMALLINT orientation, SQLLEN offset);
     SQLRETURN get_data(SQLUSMALLINT column_number, SQLSMALLINT target_type,
                       SQLPOINTER target_value_ptr, SQLLEN buffer_length,
                       SQLLEN* str_len_or_ind_ptr);
     
-    SQLSMALLINT get_column_count() const { return static_cast<SQLSMALLINT>(columns_.size()); }
+    SQLSMALLINT get_column_count() const { return static_cast<SQLSMALLINT>(store_->columns.size()); }
+    size_t get_row_count() const { return store_->row_count; }
+    // 1-based number of the current row; 0 before the first row and
+    // row count + 1 after the last
+    size_t get_position() const { return current_row_; }
     const ColumnInfo& get_column_info(SQLUSMALLINT column_number) const;
     bool has_column(const std::string& name) const;
     SQLUSMALLINT get_column_index(const std::string& name) const;
     
     void reset();
     
-    // For metadata construction
-    std::vector<ColumnInfo>& get_columns() { return columns_; }
+    // For metadata construction; only valid before the store is shared
+    std::vector<ColumnInfo>& get_columns() { return mutable_store().columns; }
+    
+    std::shared_ptr<const ResultStore> store() const { return store_; }
     
 private:
-    std::vector<ColumnInfo> columns_;
-    std::vector<nlohmann::json> rows_;
+    std::shared_ptr<const ResultStore> store_;
     SQLULEN current_row_;
     
-    void infer_schema(const std::vector<nlohmann::json>& sample_rows);
-    SQLSMALLINT infer_sql_type(const nlohmann::json& value) const;
-    std::string infer_type_name(SQLSMALLINT sql_type) const;
-    SQLULEN infer_column_size(SQLSMALLINT sql_type) const;
+    ResultStore& mutable_store() { return const_cast<ResultStore&>(*store_); }
     
-    bool convert_value(const nlohmann::json& value, SQLSMALLINT target_type,
+    bool convert_value(const Value& value, SQLSMALLINT target_type,
                       SQLPOINTER target_value_ptr, SQLLEN buffer_length,
                       SQLLEN* str_len_or_ind_ptr) const;
 };
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "common.h"
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace leafodbc {
+
+enum class RequestPriority : int {
+    Interactive = SQL_LEAF_PRIORITY_INTERACTIVE,
+    Normal = SQL_LEAF_PRIORITY_NORMAL,
+    Bulk = SQL_LEAF_PRIORITY_BULK
+};
+
+// Admission limits for one endpoint; zero means unlimited
+struct SchedulerLimits {
+    int rate_limit_per_sec = DEFAULT_RATE_LIMIT_PER_SEC;
+    int rate_limit_burst = DEFAULT_RATE_LIMIT_BURST;
+    int max_inflight_per_endpoint = DEFAULT_MAX_INFLIGHT_PER_ENDPOINT;
+    int max_inflight_per_user = DEFAULT_MAX_INFLIGHT_PER_USER;
+
+    bool unlimited() const {
+        return rate_limit_per_sec <= 0 && max_inflight_per_endpoint <= 0 && max_inflight_per_user <= 0;
+    }
+};
+
+struct SchedulerEndpoint;
+class CancelToken;
+
+// Process-wide admission control for HTTP requests to the Leaf API.
+//
+// Every request takes a ticket before it is sent. Per endpoint there is a
+// token bucket rate limit and a cap on in-flight requests, plus a cap per
+// (endpoint, user). Waiters are admitted strictly by priority class and then
+// in arrival order; a waiter held back only by its own user cap does not
+// block waiters of other users. Limits are per endpoint and the values of
+// the most recent request apply.
+class RequestScheduler {
+public:
+    static RequestScheduler& instance();
+
+    // Admission slot, released on destruction
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(Ticket&& other) noexcept;
+        Ticket& operator=(Ticket&& other) noexcept;
+        ~Ticket();
+
+        int64_t wait_us() const { return wait_us_; }
+
+    private:
+        friend class RequestScheduler;
+        SchedulerEndpoint* endpoint_ = nullptr;
+        std::string user_;
+        int64_t wait_us_ = 0;
+
+        void release();
+    };
+
+    // Blocks until the request may be sent. Returns early without a slot if
+    // `cancel` is stopped while waiting; callers check it before sending.
+    Ticket acquire(const std::string& endpoint, const std::string& user,
+                   RequestPriority priority, const SchedulerLimits& limits,
+                   const CancelToken* cancel = nullptr);
+
+    // Admits the request only if that is possible without waiting
+    bool try_acquire(const std::string& endpoint, const std::string& user,
+                     RequestPriority priority, const SchedulerLimits& limits, Ticket& ticket);
+
+    using Admitted = std::function<void(Ticket ticket)>;
+
+    // Queues the request like acquire() without blocking a thread. `admitted`
+    // runs once with the slot: on the calling thread if the request may go
+    // right away, otherwise on a TaskPool worker when a released ticket (or
+    // a refilled token) admits it. If `cancel` is stopped first, it gets an
+    // empty ticket.
+    void acquire_async(const std::string& endpoint, const std::string& user, RequestPriority priority,
+                       const SchedulerLimits& limits, std::shared_ptr<const CancelToken> cancel,
+                       Admitted admitted);
+
+private:
+    RequestScheduler() = default;
+
+    using Ready = std::vector<std::pair<Ticket, Admitted>>;
+
+    SchedulerEndpoint* endpoint_state(const std::string& endpoint, const SchedulerLimits& limits);
+
+    // Admits the asynchronous waiters that may go now and moves them to
+    // `ready`; called with mutex_ held whenever admission may have changed
+    void admit_async(SchedulerEndpoint* ep, Ready& ready);
+    // Runs the callbacks of admitted waiters, without mutex_ held
+    static void start_ready(Ready& ready);
+    // Waiters that no released ticket would wake, ones waiting for a token
+    // or with a cancel token, are rechecked on a reactor timer. Returns the
+    // delay of the recheck to post, zero if none is needed; with mutex_ held.
+    std::chrono::milliseconds recheck_delay(SchedulerEndpoint* ep);
+    void recheck_after(SchedulerEndpoint* ep, std::chrono::milliseconds delay);
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<SchedulerEndpoint>> endpoints_;
+};
+
+} // namespace leafodbc
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "arena.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+namespace leafodbc {
+
+struct ConnHandle;
+
+// Authenticated state a connection hands back on SQLDisconnect
+struct PooledSession {
+    std::string auth_token;
+    std::chrono::system_clock::time_point token_obtained_at;
+    std::shared_ptr<ArenaPool> arena_pool; // Warm result arenas
+};
+
+// Process-wide pool of authenticated sessions (SessionPoolIdleSec).
+//
+// SQLDisconnect parks the connection's token and result arenas here, and a
+// later SQLConnect or SQLDriverConnect with the same endpoint, credentials,
+// engine and TLS settings takes them over instead of authenticating again.
+// HTTP connections need no pooling: all clients share the Reactor's
+// connection cache. A token the server expired while parked is renewed by
+// the usual reauthentication after a 401. Passwords are not kept: sessions
+// are matched by a SHA-256 of the password with a per-process random salt.
+class SessionPool {
+public:
+    static constexpr size_t MAX_IDLE_PER_KEY = 8;
+
+    static SessionPool& instance();
+
+    // Endpoint, user, engine and TLS/client settings of the connection
+    static std::string make_key(const ConnHandle& conn);
+
+    // Takes an idle session for key whose password matches; false if none
+    bool acquire(const std::string& key, const std::string& password, PooledSession& session);
+
+    // Parks a session for up to idle_sec seconds
+    void release(const std::string& key, const std::string& password, PooledSession session, int idle_sec);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string password_hash;
+        PooledSession session;
+        Clock::time_point expires;
+    };
+
+    SessionPool();
+
+    std::string hash_password(const std::string& password) const;
+    void evict_expired(Clock::time_point now);
+
+    std::string salt_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<Entry>> idle_;
+};
+
+} // namespace leafodbc
@@ -2,9 +2,23 @@
 
 #include "common.h"
 #include <string>
+#include <vector>
 
 namespace leafodbc {
 
+// Bounding-box filter of an extent query (SQLGuard::find_envelope_filter)
+struct EnvelopeFilter {
+    std::string column; // Geometry column, unqualified and unquoted
+    double min_x = 0;
+    double min_y = 0;
+    double max_x = 0;
+    double max_y = 0;
+    // Span of the four coordinates in the statement, replaced to query
+    // another extent
+    size_t args_begin = 0;
+    size_t args_end = 0;
+};
+
 class SQLGuard {
 public:
     // Check if SQL statement is allowed (read-only: only SELECT)
@@ -13,6 +27,27 @@ public:
     // Check if SQL is a SELECT statement (heuristic)
     static bool is_select(const std::string& sql);
     
+    // Splits a batch at semicolons outside quotes and comments, dropping
+    // empty statements
+    static std::vector<std::string> split_statements(const std::string& sql);
+    
+    // Rewrites a SELECT to return at most max_rows rows: a numeric top-level
+    // LIMIT is lowered, a query without one gets LIMIT appended (after any
+    // ORDER BY), and other row-limiting clauses are wrapped in a subquery
+    static std::string apply_row_limit(const std::string& sql, size_t max_rows);
+    
+    // Finds `ST_Intersects(<column>, ST_MakeEnvelope(xmin, ymin, xmax, ymax[, srid]))`
+    // (or ST_PolygonFromEnvelope, or the arguments swapped) ANDed into the
+    // WHERE clause of a plain SELECT: one without LIMIT, ORDER BY, grouping,
+    // aggregates, DISTINCT, set operations, joins, OR or NOT, so that its
+    // rows for an extent are the rows of any cover of that extent. The
+    // select list must return the filter column, as * or by its own name.
+    static bool find_envelope_filter(const std::string& sql, EnvelopeFilter& filter);
+    
+    // Unqualified, unquoted name of the one table a SELECT reads from; empty
+    // for joins, subqueries in FROM and set operations
+    static std::string source_table(const std::string& sql);
+    
 private:
     static std::string normalize_sql(const std::string& sql);
     static std::string trim(const std::string& str);
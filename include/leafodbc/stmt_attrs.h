@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+ * Driver-specific statement attributes.
+ *
+ * Kept free of C++ so that applications can include it next to <sqlext.h>
+ * and pass these IDs to SQLGetStmtAttr/SQLSetStmtAttr.
+ */
+
+/* Driver-specific attributes must start at SQL_DRIVER_STMT_ATTR_BASE */
+#define SQL_ATTR_LEAF_BASE                   0x00004000
+
+/* Timing breakdown of the last execution (read-only, SQLBIGINT, microseconds) */
+#define SQL_ATTR_LEAF_TIMING_NAME_LOOKUP_US  (SQL_ATTR_LEAF_BASE + 1)
+#define SQL_ATTR_LEAF_TIMING_CONNECT_US      (SQL_ATTR_LEAF_BASE + 2)
+#define SQL_ATTR_LEAF_TIMING_TLS_US          (SQL_ATTR_LEAF_BASE + 3)
+#define SQL_ATTR_LEAF_TIMING_TTFB_US         (SQL_ATTR_LEAF_BASE + 4)
+#define SQL_ATTR_LEAF_TIMING_TRANSFER_US     (SQL_ATTR_LEAF_BASE + 5)
+#define SQL_ATTR_LEAF_TIMING_DECODE_US       (SQL_ATTR_LEAF_BASE + 6)
+#define SQL_ATTR_LEAF_TIMING_SCHEMA_US       (SQL_ATTR_LEAF_BASE + 7)
+#define SQL_ATTR_LEAF_TIMING_FETCH_US        (SQL_ATTR_LEAF_BASE + 8)
+#define SQL_ATTR_LEAF_TIMING_TOTAL_US        (SQL_ATTR_LEAF_BASE + 9)
+
+/* Size of the last execution (read-only, SQLBIGINT) */
+#define SQL_ATTR_LEAF_TIMING_BYTES_RECEIVED  (SQL_ATTR_LEAF_BASE + 10)
+#define SQL_ATTR_LEAF_TIMING_ROWS            (SQL_ATTR_LEAF_BASE + 11)
+
+/* One-line summary of the above (read-only, character string) */
+#define SQL_ATTR_LEAF_TIMING_SUMMARY         (SQL_ATTR_LEAF_BASE + 12)
+
+/*
+ * When set to 1, a successful execution returns SQL_SUCCESS_WITH_INFO and
+ * posts the timing summary as an 01000 diagnostic record (SQLULEN, default 0)
+ */
+#define SQL_ATTR_LEAF_TIMING_DIAG            (SQL_ATTR_LEAF_BASE + 13)
+
+/*
+ * Scheduling class of the statement's requests (SQLULEN, default from the
+ * Priority connection parameter). Waiting requests of a higher class are
+ * always admitted before those of a lower class.
+ */
+#define SQL_ATTR_LEAF_PRIORITY               (SQL_ATTR_LEAF_BASE + 14)
+#define SQL_LEAF_PRIORITY_INTERACTIVE        0
+#define SQL_LEAF_PRIORITY_NORMAL             1
+#define SQL_LEAF_PRIORITY_BULK               2
+
+/* Time the last execution waited for admission by the scheduler (read-only, SQLBIGINT, microseconds) */
+#define SQL_ATTR_LEAF_TIMING_QUEUE_WAIT_US   (SQL_ATTR_LEAF_BASE + 15)
+
+/*
+ * Result of the last execution as an Arrow C stream (read-only). ValuePtr
+ * points to a caller-allocated struct ArrowArrayStream from arrow_c.h, which
+ * receives the rows the cursor has not fetched yet in record batches of
+ * SQL_LEAF_ARROW_BATCH_ROWS rows. The stream stays valid after the statement
+ * is closed or re-executed and is released through its release callback.
+ */
+#define SQL_ATTR_LEAF_ARROW_STREAM           (SQL_ATTR_LEAF_BASE + 16)
+#define SQL_LEAF_ARROW_BATCH_ROWS            65536
+
+/*
+ * Memory the result of the next execution may use, in MB (SQLULEN, default
+ * from the MemoryBudgetMB connection parameter; 0 = no limit). A larger
+ * result is moved to an unlinked temporary file and read back through mmap.
+ */
+#define SQL_ATTR_LEAF_MEMORY_BUDGET_MB       (SQL_ATTR_LEAF_BASE + 17)
+
+/*
+ * Level of detail of WKT geometries in the result of the next execution
+ * (ValuePtr points to an SQLDOUBLE, default from the SimplifyTolerance
+ * connection parameter; 0 = full resolution). Linestrings and polygon rings
+ * are simplified with Douglas-Peucker at this tolerance, in coordinate units.
+ */
+#define SQL_ATTR_LEAF_SIMPLIFY_TOLERANCE     (SQL_ATTR_LEAF_BASE + 18)
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace leafodbc {
+
+// Small process-wide pool of worker threads for CPU work that must not run
+// on the reactor thread or block an application thread (decoding responses
+// of asynchronous statements, for example).
+//
+// The size is min(hardware threads, 8), at least 2, and can be overridden
+// with LEAFODBC_WORKER_THREADS.
+class TaskPool {
+public:
+    static TaskPool& instance();
+    ~TaskPool();
+
+    void submit(std::function<void()> task);
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void worker_loop();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_ = false;
+};
+
+} // namespace leafodbc
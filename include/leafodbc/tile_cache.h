@@ -0,0 +1,114 @@
+#pragma once
+
+#include "geometry.h"
+#include "result_store.h"
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+namespace leafodbc {
+
+// One tile of the quadtree grid over lon/lat: at zoom z the world
+// [-180, 180] x [-90, 90] is split into 2^z x 2^z tiles
+struct TileId {
+    int zoom = 0;
+    int64_t x = 0;
+    int64_t y = 0;
+};
+
+// Process-wide cache of extent query results cut into tiles (TileCacheSec).
+//
+// An extent query (see SQLGuard::find_envelope_filter) is snapped to the
+// zoom level whose tiles are at least as large as its extent, so it covers
+// at most 2 x 2 tiles; only the tiles not cached are sent to the server,
+// each as the same query with the tile's envelope. Slightly shifted extents
+// while panning therefore hit the tiles they share with earlier ones.
+//
+// Tiles live in memory up to LEAFODBC_TILE_CACHE_MB (default 256). The
+// least recently used move to files in LEAFODBC_TILE_CACHE_DIR (default
+// $TMPDIR or /tmp) up to LEAFODBC_TILE_CACHE_DISK_MB (default 1024; 0 keeps
+// tiles in memory only), and are dropped beyond that. Files are removed on
+// eviction and when the process exits.
+class TileCache {
+public:
+    static constexpr int MAX_ZOOM = 24;
+    static constexpr size_t MAX_PREFETCHES_IN_FLIGHT = 16;
+
+    static TileCache& instance();
+    ~TileCache();
+
+    // Zoom level and tiles [first, last] covering `extent`; false if the
+    // extent is not within lon/lat bounds
+    static bool cover(const Bounds& extent, TileId& first, TileId& last);
+    static Bounds tile_bounds(const TileId& tile);
+
+    // Key of one tile of the query identified by query_key (endpoint, user,
+    // engine and the statement without its envelope)
+    static std::string tile_key(const std::string& query_key, const TileId& tile);
+
+    // Tile cached less than max_age_sec seconds ago, or null
+    std::shared_ptr<const ResultStore> get(const std::string& key, int max_age_sec);
+    void put(const std::string& key, std::shared_ptr<const ResultStore> store);
+
+    // Reserves a prefetch of the tile; false if it is already being fetched
+    // or too many prefetches are running
+    bool begin_prefetch(const std::string& key);
+    void end_prefetch(const std::string& key);
+
+private:
+    TileCache();
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    struct Entry {
+        std::string key;
+        std::chrono::steady_clock::time_point stored_at;
+        std::shared_ptr<const ResultStore> store; // Null once on disk
+        size_t bytes = 0;
+        std::string path; // Of the tile on disk
+    };
+    using EntryList = std::list<Entry>;
+
+    size_t memory_limit_ = 0;
+    size_t disk_limit_ = 0;
+    std::string disk_dir_; // Created on first use
+
+    std::mutex mutex_;
+    // Most recently used first; a tile is in exactly one of the two lists
+    EntryList memory_;
+    EntryList disk_;
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    size_t memory_bytes_ = 0;
+    size_t disk_bytes_ = 0;
+    uint64_t next_file_ = 0;
+    std::unordered_set<std::string> prefetching_;
+
+    void remove(EntryList::iterator entry, bool on_disk);
+    // Moves least recently used tiles to disk, or drops them, until both
+    // tiers are within their limits
+    void evict();
+    bool write_tile(Entry& entry);
+    std::shared_ptr<const ResultStore> read_tile(const Entry& entry);
+};
+
+// Rows of tiles fetched for `extent`, in tile order, without the rows of
+// features whose bounding box lies outside the extent and without the
+// copies a feature spanning several tiles has in later tiles. Returns null
+// if a tile has rows but no `geometry_column`, as the rows cannot be
+// matched to the extent then.
+//
+// The extent test compares bounding boxes, so it is exact for points but
+// looser than the ST_Intersects of the statement for other shapes: a line
+// or polygon whose box overlaps the extent while the shape itself does not
+// is kept, where the server would leave it out.
+std::shared_ptr<ResultStore> merge_tiles(const std::vector<std::shared_ptr<const ResultStore>>& tiles,
+                                         const std::string& geometry_column, const Bounds& extent,
+                                         std::shared_ptr<Arena> arena);
+
+} // namespace leafodbc
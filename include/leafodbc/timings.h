@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <chrono>
+
+namespace leafodbc {
+
+// Per-execution timing breakdown. Network phases come from libcurl and are
+// disjoint, so they add up to the wall time of the HTTP request.
+struct QueryTimings {
+    int64_t queue_wait_us = 0;   // Waiting for admission by the request scheduler
+    int64_t name_lookup_us = 0;  // DNS resolution
+    int64_t connect_us = 0;      // TCP connect
+    int64_t tls_us = 0;          // TLS handshake
+    int64_t ttfb_us = 0;         // Request sent until first response byte (server time)
+    int64_t transfer_us = 0;     // First byte until last byte
+    int64_t decode_us = 0;       // JSON parse of the response body
+    int64_t schema_us = 0;       // Result set load and schema inference
+    int64_t fetch_us = 0;        // Time spent in SQLFetch/SQLGetData
+    int64_t total_us = 0;        // Whole execute call
+    int64_t bytes_received = 0;
+    int64_t rows = 0;
+
+    void clear() { *this = QueryTimings(); }
+    std::string summary() const;
+};
+
+// Microseconds elapsed since start
+inline int64_t elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace leafodbc
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "bounded_ring.h"
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+
+namespace leafodbc {
+
+// 1 when LEAFODBC_TRACE_FILE is set, 0 when not, negative until checked
+extern std::atomic<int> g_trace_state;
+
+int init_trace_state();
+
+inline bool trace_enabled() {
+    int state = g_trace_state.load(std::memory_order_relaxed);
+    if (state < 0) {
+        state = init_trace_state();
+    }
+    return state > 0;
+}
+
+// Microseconds on the trace clock (steady, relative to driver load)
+int64_t trace_now_us();
+
+// Session timeline in Chrome trace JSON (opens in Perfetto and chrome://tracing).
+//
+// Enabled by LEAFODBC_TRACE_FILE. Spans are complete ("ph":"X") events with
+// static names, pushed into a bounded lock-free ring and serialized by a
+// background writer thread. If the ring is full the span is dropped and
+// counted. The file stays loadable even if the process dies mid-session.
+class Tracer {
+public:
+    static Tracer& instance();
+    ~Tracer();
+
+    // name, category and arg_name must be string literals
+    void record(const char* name, const char* category, int64_t start_us, int64_t duration_us,
+                const char* arg_name = nullptr, int64_t arg_value = 0);
+
+private:
+    static constexpr size_t SLOT_COUNT = 65536; // power of two
+
+    struct Span {
+        const char* name;
+        const char* category;
+        const char* arg_name;
+        int64_t arg_value;
+        int64_t start_us;
+        int64_t duration_us;
+        uint64_t thread_id;
+    };
+
+    Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    void writer_loop();
+    bool drain_once();
+    void write_span(const Span& span);
+
+    std::unique_ptr<BoundedRing<Span, SLOT_COUNT>> ring_; // Allocated only when enabled
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> stopping_{false};
+    bool enabled_ = false;
+    bool first_event_ = true;
+    long pid_ = 0;
+    FILE* file_ = nullptr;
+    std::thread writer_thread_;
+
+    friend int init_trace_state();
+};
+
+// Records a span covering the enclosing scope
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category)
+        : name_(name), category_(category), start_us_(trace_enabled() ? trace_now_us() : -1) {}
+    ~TraceSpan() {
+        if (start_us_ >= 0) {
+            Tracer::instance().record(name_, category_, start_us_, trace_now_us() - start_us_);
+        }
+    }
+
+private:
+    const char* name_;
+    const char* category_;
+    int64_t start_us_;
+};
+
+} // namespace leafodbc
+
+#define LEAF_TRACE_CONCAT_INNER(a, b) a##b
+#define LEAF_TRACE_CONCAT(a, b) LEAF_TRACE_CONCAT_INNER(a, b)
+#define LEAF_TRACE_SCOPE(name, category) \
+    ::leafodbc::TraceSpan LEAF_TRACE_CONCAT(leaf_trace_span_, __LINE__)(name, category)
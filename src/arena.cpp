@@ -0,0 +1,114 @@
+#include "leafodbc/arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace leafodbc {
+
+namespace {
+
+constexpr size_t MAX_BLOCK_SIZE = 8 * 1024 * 1024;
+
+} // namespace
+
+Arena::Arena(size_t first_block_size) : next_block_size_(first_block_size) {
+}
+
+Arena::~Arena() {
+    for (const auto& block : blocks_) {
+        ::operator delete(block.data);
+    }
+}
+
+void Arena::add_block(size_t min_size) {
+    size_t size = std::max(next_block_size_, min_size);
+    Block block{static_cast<char*>(::operator new(size)), size};
+    blocks_.push_back(block);
+    capacity_ += size;
+    cursor_ = block.data;
+    remaining_ = size;
+    next_block_size_ = std::min(next_block_size_ * 2, MAX_BLOCK_SIZE);
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    auto misalignment = reinterpret_cast<uintptr_t>(cursor_) & (alignment - 1);
+    size_t padding = misalignment ? alignment - misalignment : 0;
+    if (!cursor_ || padding + bytes > remaining_) {
+        // ::operator new returns memory aligned for any fundamental type
+        add_block(bytes + alignment);
+        misalignment = reinterpret_cast<uintptr_t>(cursor_) & (alignment - 1);
+        padding = misalignment ? alignment - misalignment : 0;
+    }
+    char* result = cursor_ + padding;
+    cursor_ += padding + bytes;
+    remaining_ -= padding + bytes;
+    return result;
+}
+
+std::string_view Arena::copy(std::string_view s) {
+    if (s.empty()) {
+        return std::string_view();
+    }
+    char* data = static_cast<char*>(allocate(s.size(), 1));
+    std::memcpy(data, s.data(), s.size());
+    return std::string_view(data, s.size());
+}
+
+void Arena::reset(size_t max_retained) {
+    auto largest = std::max_element(blocks_.begin(), blocks_.end(),
+                                    [](const Block& a, const Block& b) { return a.size < b.size; });
+    Block kept{nullptr, 0};
+    if (largest != blocks_.end() && largest->size <= max_retained) {
+        kept = *largest;
+    }
+    for (const auto& block : blocks_) {
+        if (block.data != kept.data) {
+            ::operator delete(block.data);
+        }
+    }
+    blocks_.clear();
+    capacity_ = 0;
+    cursor_ = nullptr;
+    remaining_ = 0;
+    if (kept.data) {
+        blocks_.push_back(kept);
+        capacity_ = kept.size;
+        cursor_ = kept.data;
+        remaining_ = kept.size;
+    }
+}
+
+std::shared_ptr<Arena> ArenaPool::acquire() {
+    std::unique_ptr<Arena> arena;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            arena = std::move(idle_.back());
+            idle_.pop_back();
+        }
+    }
+    if (!arena) {
+        arena = std::make_unique<Arena>();
+    }
+    // Results can outlive their connection (coalesced statements elsewhere)
+    std::weak_ptr<ArenaPool> pool = weak_from_this();
+    return std::shared_ptr<Arena>(arena.release(), [pool](Arena* a) {
+        if (auto owner = pool.lock()) {
+            owner->release(a);
+        } else {
+            delete a;
+        }
+    });
+}
+
+void ArenaPool::release(Arena* arena) {
+    arena->reset(MAX_RETAINED_BYTES);
+    std::unique_ptr<Arena> owned(arena);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < MAX_IDLE_ARENAS) {
+        idle_.push_back(std::move(owned));
+    }
+}
+
+} // namespace leafodbc
@@ -0,0 +1,335 @@
+#include "leafodbc/arrow_export.h"
+#include "leafodbc/common.h"
+#include "leafodbc/stmt_attrs.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace leafodbc {
+
+namespace {
+
+enum class ArrowType { Bool, Int64, Float64, Utf8, LargeUtf8 };
+
+ArrowType arrow_type(SQLSMALLINT sql_type) {
+    switch (sql_type) {
+        case SQL_BIT: return ArrowType::Bool;
+        case SQL_INTEGER:
+        case SQL_BIGINT: return ArrowType::Int64;
+        case SQL_DOUBLE: return ArrowType::Float64;
+        case SQL_LONGVARCHAR: return ArrowType::LargeUtf8;
+        default: return ArrowType::Utf8;
+    }
+}
+
+const char* arrow_format(ArrowType type) {
+    switch (type) {
+        case ArrowType::Bool: return "b";
+        case ArrowType::Int64: return "l";
+        case ArrowType::Float64: return "g";
+        case ArrowType::LargeUtf8: return "U";
+        default: return "u";
+    }
+}
+
+// Names and child structs of an exported schema, freed by its release callback
+struct SchemaData {
+    std::string name;
+    std::vector<ArrowSchema> children;
+    std::vector<ArrowSchema*> child_ptrs;
+};
+
+void release_schema(ArrowSchema* schema) {
+    auto* data = static_cast<SchemaData*>(schema->private_data);
+    for (ArrowSchema* child : data->child_ptrs) {
+        if (child->release) {
+            child->release(child);
+        }
+    }
+    delete data;
+    schema->release = nullptr;
+}
+
+void init_schema(ArrowSchema* schema, const char* format, std::string name, int64_t flags, size_t n_children) {
+    auto* data = new SchemaData;
+    data->name = std::move(name);
+    data->children.resize(n_children);
+    for (ArrowSchema& child : data->children) {
+        data->child_ptrs.push_back(&child);
+    }
+    schema->format = format;
+    schema->name = data->name.c_str();
+    schema->metadata = nullptr;
+    schema->flags = flags;
+    schema->n_children = static_cast<int64_t>(n_children);
+    schema->children = n_children ? data->child_ptrs.data() : nullptr;
+    schema->dictionary = nullptr;
+    schema->release = release_schema;
+    schema->private_data = data;
+}
+
+// Buffers and child structs of an exported array, freed by its release callback
+struct ArrayData {
+    std::vector<uint8_t> validity;
+    std::vector<uint8_t> values; // Fixed-width values, or text of string arrays
+    std::vector<uint8_t> offsets;
+    std::vector<const void*> buffers;
+    std::vector<ArrowArray> children;
+    std::vector<ArrowArray*> child_ptrs;
+};
+
+void release_array(ArrowArray* array) {
+    auto* data = static_cast<ArrayData*>(array->private_data);
+    for (ArrowArray* child : data->child_ptrs) {
+        if (child->release) {
+            child->release(child);
+        }
+    }
+    delete data;
+    array->release = nullptr;
+}
+
+void set_bit(std::vector<uint8_t>& bits, size_t i) {
+    bits[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+}
+
+bool to_bool(const Value& value, bool& out) {
+    if (value.kind == Value::Kind::Bool) {
+        out = value.b;
+    } else if (value.is_number()) {
+        out = value.as_int64() != 0;
+    } else if (value.kind == Value::Kind::String) {
+        std::string_view s = value.str();
+        out = (s == "true" || s == "1" || s == "yes");
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool to_int64(const Value& value, int64_t& out) {
+    if (value.is_number() || value.kind == Value::Kind::Bool) {
+        out = value.as_int64();
+        return true;
+    } else if (value.kind == Value::Kind::String) {
+        std::string_view s = value.str();
+        auto result = std::from_chars(s.data(), s.data() + s.size(), out);
+        return result.ec == std::errc();
+    }
+    return false;
+}
+
+bool to_double(const Value& value, double& out) {
+    if (value.is_number() || value.kind == Value::Kind::Bool) {
+        out = value.as_double();
+        return true;
+    } else if (value.kind == Value::Kind::String) {
+        std::string s(value.str());
+        char* end = nullptr;
+        out = std::strtod(s.c_str(), &end);
+        return !s.empty() && end != s.c_str();
+    }
+    return false;
+}
+
+// Text of a cell as SQLGetData returns it for SQL_C_CHAR
+std::string_view to_text(const Value& value, std::string& scratch) {
+    if (value.kind == Value::Kind::String || value.kind == Value::Kind::Json) {
+        return value.str();
+    } else if (value.kind == Value::Kind::Bool) {
+        return value.b ? "1" : "0";
+    }
+    scratch = value.dump();
+    return scratch;
+}
+
+template <typename Offset>
+bool fill_strings(const ResultStore& store, size_t column, size_t first, size_t rows, ArrayData& data,
+                  int64_t& null_count) {
+    std::vector<Offset> offsets(rows + 1, 0);
+    std::string scratch;
+    for (size_t r = 0; r < rows; ++r) {
+        Value value = store.cell(first + r, column);
+        if (!value.is_null()) {
+            std::string_view text = to_text(value, scratch);
+            if (sizeof(Offset) == 4 && data.values.size() + text.size() > static_cast<size_t>(INT32_MAX)) {
+                return false;
+            }
+            data.values.insert(data.values.end(), text.begin(), text.end());
+            set_bit(data.validity, r);
+        } else {
+            ++null_count;
+        }
+        offsets[r + 1] = static_cast<Offset>(data.values.size());
+    }
+    data.offsets.resize(offsets.size() * sizeof(Offset));
+    std::memcpy(data.offsets.data(), offsets.data(), data.offsets.size());
+    return true;
+}
+
+// Builds the column array of rows [first, first + rows)
+bool fill_column(const ResultStore& store, size_t column, size_t first, size_t rows, ArrowArray* out,
+                 std::string& error) {
+    auto* data = new ArrayData;
+    data->validity.assign((rows + 7) / 8, 0);
+    ArrowType type = arrow_type(store.columns[column].sql_type);
+    int64_t null_count = 0;
+    
+    switch (type) {
+        case ArrowType::Bool: {
+            data->values.assign((rows + 7) / 8, 0);
+            for (size_t r = 0; r < rows; ++r) {
+                bool v;
+                if (to_bool(store.cell(first + r, column), v)) {
+                    set_bit(data->validity, r);
+                    if (v) {
+                        set_bit(data->values, r);
+                    }
+                } else {
+                    ++null_count;
+                }
+            }
+            break;
+        }
+        case ArrowType::Int64: {
+            data->values.assign(rows * sizeof(int64_t), 0);
+            auto* values = reinterpret_cast<int64_t*>(data->values.data());
+            for (size_t r = 0; r < rows; ++r) {
+                if (to_int64(store.cell(first + r, column), values[r])) {
+                    set_bit(data->validity, r);
+                } else {
+                    values[r] = 0;
+                    ++null_count;
+                }
+            }
+            break;
+        }
+        case ArrowType::Float64: {
+            data->values.assign(rows * sizeof(double), 0);
+            auto* values = reinterpret_cast<double*>(data->values.data());
+            for (size_t r = 0; r < rows; ++r) {
+                if (to_double(store.cell(first + r, column), values[r])) {
+                    set_bit(data->validity, r);
+                } else {
+                    values[r] = 0.0;
+                    ++null_count;
+                }
+            }
+            break;
+        }
+        case ArrowType::Utf8:
+        case ArrowType::LargeUtf8: {
+            bool fits = type == ArrowType::Utf8
+                ? fill_strings<int32_t>(store, column, first, rows, *data, null_count)
+                : fill_strings<int64_t>(store, column, first, rows, *data, null_count);
+            if (!fits) {
+                error = "Text of column " + store.columns[column].name + " exceeds 2 GB in one batch";
+                delete data;
+                return false;
+            }
+            break;
+        }
+    }
+    
+    data->buffers.push_back(null_count ? data->validity.data() : nullptr);
+    if (type == ArrowType::Utf8 || type == ArrowType::LargeUtf8) {
+        data->buffers.push_back(data->offsets.data());
+    }
+    // Non-null even when empty, as consumers may not expect a null data buffer
+    data->buffers.push_back(data->values.empty() ? data->offsets.data() : data->values.data());
+    
+    out->length = static_cast<int64_t>(rows);
+    out->null_count = null_count;
+    out->offset = 0;
+    out->n_buffers = static_cast<int64_t>(data->buffers.size());
+    out->n_children = 0;
+    out->buffers = data->buffers.data();
+    out->children = nullptr;
+    out->dictionary = nullptr;
+    out->release = release_array;
+    out->private_data = data;
+    return true;
+}
+
+struct StreamState {
+    std::shared_ptr<const ResultStore> store;
+    size_t next_row;
+    std::string last_error;
+};
+
+int stream_get_schema(ArrowArrayStream* stream, ArrowSchema* out) {
+    const ResultStore& store = *static_cast<StreamState*>(stream->private_data)->store;
+    init_schema(out, "+s", "", 0, store.columns.size());
+    for (size_t c = 0; c < store.columns.size(); ++c) {
+        init_schema(out->children[c], arrow_format(arrow_type(store.columns[c].sql_type)), store.columns[c].name,
+                    ARROW_FLAG_NULLABLE, 0);
+    }
+    return 0;
+}
+
+int stream_get_next(ArrowArrayStream* stream, ArrowArray* out) {
+    auto* state = static_cast<StreamState*>(stream->private_data);
+    const ResultStore& store = *state->store;
+    if (state->next_row >= store.row_count) {
+        // End of stream
+        out->release = nullptr;
+        return 0;
+    }
+    size_t rows = std::min<size_t>(SQL_LEAF_ARROW_BATCH_ROWS, store.row_count - state->next_row);
+    
+    auto* data = new ArrayData;
+    data->buffers.push_back(nullptr); // No null rows
+    data->children.resize(store.columns.size());
+    for (size_t c = 0; c < store.columns.size(); ++c) {
+        ArrowArray* child = &data->children[c];
+        child->release = nullptr;
+        data->child_ptrs.push_back(child);
+        if (!fill_column(store, c, state->next_row, rows, child, state->last_error)) {
+            for (size_t d = 0; d < c; ++d) {
+                data->children[d].release(&data->children[d]);
+            }
+            delete data;
+            return EOVERFLOW;
+        }
+    }
+    
+    out->length = static_cast<int64_t>(rows);
+    out->null_count = 0;
+    out->offset = 0;
+    out->n_buffers = 1;
+    out->n_children = static_cast<int64_t>(data->child_ptrs.size());
+    out->buffers = data->buffers.data();
+    out->children = data->child_ptrs.empty() ? nullptr : data->child_ptrs.data();
+    out->dictionary = nullptr;
+    out->release = release_array;
+    out->private_data = data;
+    state->next_row += rows;
+    return 0;
+}
+
+const char* stream_get_last_error(ArrowArrayStream* stream) {
+    auto* state = static_cast<StreamState*>(stream->private_data);
+    return state->last_error.empty() ? nullptr : state->last_error.c_str();
+}
+
+void stream_release(ArrowArrayStream* stream) {
+    delete static_cast<StreamState*>(stream->private_data);
+    stream->release = nullptr;
+}
+
+} // namespace
+
+void export_arrow_stream(std::shared_ptr<const ResultStore> store, size_t first_row, ArrowArrayStream* out) {
+    out->get_schema = stream_get_schema;
+    out->get_next = stream_get_next;
+    out->get_last_error = stream_get_last_error;
+    out->release = stream_release;
+    out->private_data = new StreamState{std::move(store), first_row, std::string()};
+}
+
+} // namespace leafodbc
@@ -0,0 +1,62 @@
+#include "leafodbc/cancel.h"
+#include "leafodbc/reactor.h"
+#include <algorithm>
+
+namespace leafodbc {
+
+CancelToken::CancelToken(int timeout_sec) {
+    if (timeout_sec > 0) {
+        has_deadline_ = true;
+        deadline_ = Clock::now() + std::chrono::seconds(timeout_sec);
+    }
+}
+
+void CancelToken::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_.store(true, std::memory_order_release);
+    // Handles are detached before they are cleaned up, so every one of
+    // these is still owned by the reactor when the cancel is queued
+    for (CURL* easy : transfers_) {
+        Reactor::instance().cancel(easy);
+    }
+    cv_.notify_all();
+}
+
+int64_t CancelToken::remaining_ms() const {
+    if (!has_deadline_) {
+        return -1;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline_ - Clock::now()).count();
+    return std::max<int64_t>(1, remaining);
+}
+
+bool CancelToken::wait_for(std::chrono::milliseconds delay) {
+    auto until = Clock::now() + delay;
+    if (has_deadline_ && deadline_ < until) {
+        until = deadline_;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_until(lock, until, [this] { return cancelled(); });
+    return !stop_requested();
+}
+
+bool CancelToken::attach(CURL* easy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_requested()) {
+        return false;
+    }
+    transfers_.push_back(easy);
+    return true;
+}
+
+void CancelToken::detach(CURL* easy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    transfers_.erase(std::remove(transfers_.begin(), transfers_.end(), easy), transfers_.end());
+}
+
+int CancelToken::progress_callback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    // Non-zero aborts the transfer with CURLE_ABORTED_BY_CALLBACK
+    return static_cast<CancelToken*>(clientp)->stop_requested() ? 1 : 0;
+}
+
+} // namespace leafodbc
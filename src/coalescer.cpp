@@ -0,0 +1,144 @@
+#include "leafodbc/coalescer.h"
+#include "leafodbc/cancel.h"
+#include <cctype>
+#include <chrono>
+
+namespace leafodbc {
+
+QueryCoalescer& QueryCoalescer::instance() {
+    static QueryCoalescer coalescer;
+    return coalescer;
+}
+
+bool QueryCoalescer::Flight::wait(const CancelToken* cancel) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!done_) {
+        if (cancel && cancel->stop_requested()) {
+            return false;
+        }
+        // SQLCancel cannot reach this condition variable, so check periodically
+        if (cancel) {
+            cv_.wait_for(lock, std::chrono::milliseconds(100));
+        } else {
+            cv_.wait(lock);
+        }
+    }
+    return true;
+}
+
+void QueryCoalescer::Flight::on_done(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!done_) {
+            callbacks_.push_back(std::move(fn));
+            return;
+        }
+    }
+    fn();
+}
+
+std::shared_ptr<QueryCoalescer::Flight> QueryCoalescer::join(const std::string& key, bool& leader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& slot = flights_[key];
+    leader = !slot;
+    if (leader) {
+        slot = std::make_shared<Flight>();
+        slot->key_ = key;
+    }
+    return slot;
+}
+
+void QueryCoalescer::complete(const std::shared_ptr<Flight>& flight, QueryOutcome outcome) {
+    {
+        // Later executions of the same query send a new request
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = flights_.find(flight->key_);
+        if (it != flights_.end() && it->second == flight) {
+            flights_.erase(it);
+        }
+    }
+
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex_);
+        flight->outcome_ = std::move(outcome);
+        flight->done_ = true;
+        callbacks.swap(flight->callbacks_);
+    }
+    flight->cv_.notify_all();
+    for (auto& fn : callbacks) {
+        fn();
+    }
+}
+
+std::string QueryCoalescer::make_key(const std::string& endpoint, const std::string& user,
+                                     const std::string& sql_engine, const std::string& sql) {
+    std::string key;
+    key.reserve(endpoint.size() + user.size() + sql_engine.size() + sql.size() + 3);
+    key += endpoint;
+    key += '\n';
+    key += user;
+    key += '\n';
+    key += sql_engine;
+    key += '\n';
+    key += normalize_sql(sql);
+    return key;
+}
+
+std::string QueryCoalescer::normalize_sql(const std::string& sql) {
+    std::string out;
+    out.reserve(sql.size());
+    char quote = 0;
+    bool pending_space = false;
+
+    for (size_t i = 0; i < sql.size(); ++i) {
+        char c = sql[i];
+        if (quote) {
+            out += c;
+            if (c == '\\' && i + 1 < sql.size()) {
+                // Spark SQL escapes quotes with a backslash; the escaped
+                // character stays part of the literal
+                out += sql[++i];
+            } else if (c == quote) {
+                quote = 0;
+            }
+            continue;
+        }
+        // Comments count as whitespace. Collapsing the newline that ends a
+        // -- comment would pull the rest of the statement into the comment,
+        // so different statements could share a key.
+        if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+            i = sql.find('\n', i);
+            if (i == std::string::npos) {
+                i = sql.size();
+            }
+            pending_space = !out.empty();
+            continue;
+        }
+        if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+            size_t end = sql.find("*/", i + 2);
+            i = end == std::string::npos ? sql.size() : end + 1;
+            pending_space = !out.empty();
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pending_space = !out.empty();
+            continue;
+        }
+        if (pending_space) {
+            out += ' ';
+            pending_space = false;
+        }
+        if (c == '\'' || c == '"' || c == '`') {
+            quote = c;
+        }
+        out += c;
+    }
+
+    while (!quote && !out.empty() && (out.back() == ';' || out.back() == ' ')) {
+        out.pop_back();
+    }
+    return out;
+}
+
+} // namespace leafodbc
@@ -35,6 +35,50 @@ int ConnectionStringParser::parse_int(const std::string& value) {
     }
 }
 
+double ConnectionStringParser::parse_double(const std::string& value) {
+    try {
+        return std::stod(trim(value));
+    } catch (...) {
+        return 0.0;
+    }
+}
+
+int ConnectionStringParser::parse_priority(const std::string& value) {
+    std::string lower = to_lower(trim(value));
+    if (lower == "interactive" || lower == "0") {
+        return SQL_LEAF_PRIORITY_INTERACTIVE;
+    }
+    if (lower == "bulk" || lower == "2") {
+        return SQL_LEAF_PRIORITY_BULK;
+    }
+    return SQL_LEAF_PRIORITY_NORMAL;
+}
+
+JsonParser ConnectionStringParser::parse_json_parser(const std::string& value) {
+    std::string lower = to_lower(trim(value));
+    if (lower == "nlohmann") {
+        return JsonParser::Nlohmann;
+    }
+    if (lower == "simd" || lower == "simdjson") {
+        return JsonParser::Simd;
+    }
+    return DEFAULT_JSON_PARSER;
+}
+
+ResponseFormat ConnectionStringParser::parse_response_format(const std::string& value) {
+    std::string lower = to_lower(trim(value));
+    if (lower == "json") {
+        return ResponseFormat::Json;
+    }
+    if (lower == "ndjson" || lower == "jsonl") {
+        return ResponseFormat::NdJson;
+    }
+    if (lower == "csv") {
+        return ResponseFormat::Csv;
+    }
+    return DEFAULT_RESPONSE_FORMAT;
+}
+
 std::unordered_map<std::string, std::string> ConnectionStringParser::parse_key_value_pairs(const std::string& conn_str) {
     std::unordered_map<std::string, std::string> params;
     std::string current_key;
@@ -80,32 +124,84 @@ std::unordered_map<std::string, std::string> ConnectionStringParser::parse_key_v
     return params;
 }
 
+void ConnectionStringParser::apply_param(ConnectionParams& params, const std::string& key, const std::string& value) {
+    if (key == "endpointbase" || key == "endpoint_base") {
+        params.endpoint_base = value;
+    } else if (key == "username" || key == "uid" || key == "user") {
+        params.username = value;
+    } else if (key == "password" || key == "pwd") {
+        params.password = value;
+    } else if (key == "rememberme" || key == "remember_me") {
+        params.remember_me = parse_bool(value);
+    } else if (key == "sqlengine" || key == "sql_engine") {
+        params.sql_engine = value;
+    } else if (key == "timeoutsec" || key == "timeout_sec" || key == "timeout") {
+        params.timeout_sec = parse_int(value);
+        if (params.timeout_sec <= 0) params.timeout_sec = DEFAULT_TIMEOUT_SEC;
+    } else if (key == "verifytls" || key == "verify_tls" || key == "sslverify") {
+        params.verify_tls = parse_bool(value);
+    } else if (key == "useragent" || key == "user_agent") {
+        params.user_agent = value;
+    } else if (key == "maxretries" || key == "max_retries") {
+        params.max_retries = std::max(0, parse_int(value));
+    } else if (key == "retrybackoffms" || key == "retry_backoff_ms") {
+        params.retry_backoff_ms = parse_int(value);
+        if (params.retry_backoff_ms <= 0) params.retry_backoff_ms = DEFAULT_RETRY_BACKOFF_MS;
+    } else if (key == "retrybackoffmaxms" || key == "retry_backoff_max_ms") {
+        params.retry_backoff_max_ms = parse_int(value);
+        if (params.retry_backoff_max_ms <= 0) params.retry_backoff_max_ms = DEFAULT_RETRY_BACKOFF_MAX_MS;
+    } else if (key == "hedgerequests" || key == "hedge_requests") {
+        params.hedge_requests = parse_bool(value);
+    } else if (key == "hedgepercentile" || key == "hedge_percentile") {
+        params.hedge_percentile = parse_int(value);
+        if (params.hedge_percentile <= 0 || params.hedge_percentile > 100) {
+            params.hedge_percentile = DEFAULT_HEDGE_PERCENTILE;
+        }
+    } else if (key == "retrybudgetpercent" || key == "retry_budget_percent") {
+        params.retry_budget_percent = std::max(0, parse_int(value));
+    } else if (key == "ratelimitpersec" || key == "rate_limit_per_sec") {
+        params.rate_limit_per_sec = std::max(0, parse_int(value));
+    } else if (key == "ratelimitburst" || key == "rate_limit_burst") {
+        params.rate_limit_burst = std::max(0, parse_int(value));
+    } else if (key == "maxinflightperendpoint" || key == "max_inflight_per_endpoint") {
+        params.max_inflight_per_endpoint = std::max(0, parse_int(value));
+    } else if (key == "maxinflightperuser" || key == "max_inflight_per_user") {
+        params.max_inflight_per_user = std::max(0, parse_int(value));
+    } else if (key == "priority") {
+        params.priority = parse_priority(value);
+    } else if (key == "coalescequeries" || key == "coalesce_queries") {
+        params.coalesce_queries = parse_bool(value);
+    } else if (key == "jsonparser" || key == "json_parser") {
+        params.json_parser = parse_json_parser(value);
+    } else if (key == "decodethreads" || key == "decode_threads") {
+        params.decode_threads = std::max(0, parse_int(value));
+    } else if (key == "lazydecode" || key == "lazy_decode") {
+        params.lazy_decode = parse_bool(value);
+    } else if (key == "responseformat" || key == "response_format") {
+        params.response_format = parse_response_format(value);
+    } else if (key == "memorybudgetmb" || key == "memory_budget_mb") {
+        params.memory_budget_mb = std::max(0, parse_int(value));
+    } else if (key == "sessionpoolidlesec" || key == "session_pool_idle_sec") {
+        params.session_pool_idle_sec = std::max(0, parse_int(value));
+    } else if (key == "lazyconnect" || key == "lazy_connect") {
+        params.lazy_connect = parse_bool(value);
+    } else if (key == "simplifytolerance" || key == "simplify_tolerance") {
+        params.simplify_tolerance = std::max(0.0, parse_double(value));
+    } else if (key == "tilecachesec" || key == "tile_cache_sec") {
+        params.tile_cache_sec = std::max(0, parse_int(value));
+    } else if (key == "tileprefetch" || key == "tile_prefetch") {
+        params.tile_prefetch = parse_bool(value);
+    } else if (key == "layerstatssample" || key == "layer_stats_sample") {
+        params.layer_stats_sample = std::max(0, parse_int(value));
+    }
+}
+
 ConnectionParams ConnectionStringParser::parse(const std::string& conn_str) {
     ConnectionParams params;
     auto pairs = parse_key_value_pairs(conn_str);
     
     for (const auto& pair : pairs) {
-        const std::string& key = pair.first;
-        const std::string& value = pair.second;
-        
-        if (key == "endpointbase" || key == "endpoint_base") {
-            params.endpoint_base = value;
-        } else if (key == "username" || key == "uid" || key == "user") {
-            params.username = value;
-        } else if (key == "password" || key == "pwd") {
-            params.password = value;
-        } else if (key == "rememberme" || key == "remember_me") {
-            params.remember_me = parse_bool(value);
-        } else if (key == "sqlengine" || key == "sql_engine") {
-            params.sql_engine = value;
-        } else if (key == "timeoutsec" || key == "timeout_sec" || key == "timeout") {
-            params.timeout_sec = parse_int(value);
-            if (params.timeout_sec <= 0) params.timeout_sec = DEFAULT_TIMEOUT_SEC;
-        } else if (key == "verifytls" || key == "verify_tls" || key == "sslverify") {
-            params.verify_tls = parse_bool(value);
-        } else if (key == "useragent" || key == "user_agent") {
-            params.user_agent = value;
-        }
+        apply_param(params, pair.first, pair.second);
     }
     
     return params;
@@ -126,13 +222,13 @@ ConnectionParams ConnectionStringParser::parse_dsn(const std::string& dsn_name)
     for (const auto& path : odbc_ini_paths) {
         file.open(path);
         if (file.is_open()) {
-            log("Reading DSN from " + path);
+            LEAF_LOG_DEBUG("Reading DSN from %s", path.c_str());
             break;
         }
     }
     
     if (!file.is_open()) {
-        log("Could not find odbc.ini file");
+        LEAF_LOG_WARN("Could not find odbc.ini file");
         return params;
     }
     
@@ -155,25 +251,7 @@ ConnectionParams ConnectionStringParser::parse_dsn(const std::string& dsn_name)
             if (eq_pos != std::string::npos) {
                 std::string key = to_lower(trim(line.substr(0, eq_pos)));
                 std::string value = trim(line.substr(eq_pos + 1));
-                
-                if (key == "endpointbase" || key == "endpoint_base") {
-                    params.endpoint_base = value;
-                } else if (key == "username" || key == "uid" || key == "user") {
-                    params.username = value;
-                } else if (key == "password" || key == "pwd") {
-                    params.password = value;
-                } else if (key == "rememberme" || key == "remember_me") {
-                    params.remember_me = parse_bool(value);
-                } else if (key == "sqlengine" || key == "sql_engine") {
-                    params.sql_engine = value;
-                } else if (key == "timeoutsec" || key == "timeout_sec" || key == "timeout") {
-                    params.timeout_sec = parse_int(value);
-                    if (params.timeout_sec <= 0) params.timeout_sec = DEFAULT_TIMEOUT_SEC;
-                } else if (key == "verifytls" || key == "verify_tls" || key == "sslverify") {
-                    params.verify_tls = parse_bool(value);
-                } else if (key == "useragent" || key == "user_agent") {
-                    params.user_agent = value;
-                }
+                apply_param(params, key, value);
             }
         }
     }
@@ -209,6 +287,75 @@ ConnectionParams ConnectionStringParser::merge(const ConnectionParams& dsn_param
     if (!conn_str_params.user_agent.empty()) {
         merged.user_agent = conn_str_params.user_agent;
     }
+    if (conn_str_params.max_retries != DEFAULT_MAX_RETRIES) {
+        merged.max_retries = conn_str_params.max_retries;
+    }
+    if (conn_str_params.retry_backoff_ms != DEFAULT_RETRY_BACKOFF_MS) {
+        merged.retry_backoff_ms = conn_str_params.retry_backoff_ms;
+    }
+    if (conn_str_params.retry_backoff_max_ms != DEFAULT_RETRY_BACKOFF_MAX_MS) {
+        merged.retry_backoff_max_ms = conn_str_params.retry_backoff_max_ms;
+    }
+    if (conn_str_params.hedge_requests != DEFAULT_HEDGE_REQUESTS) {
+        merged.hedge_requests = conn_str_params.hedge_requests;
+    }
+    if (conn_str_params.hedge_percentile != DEFAULT_HEDGE_PERCENTILE) {
+        merged.hedge_percentile = conn_str_params.hedge_percentile;
+    }
+    if (conn_str_params.retry_budget_percent != DEFAULT_RETRY_BUDGET_PERCENT) {
+        merged.retry_budget_percent = conn_str_params.retry_budget_percent;
+    }
+    if (conn_str_params.rate_limit_per_sec != DEFAULT_RATE_LIMIT_PER_SEC) {
+        merged.rate_limit_per_sec = conn_str_params.rate_limit_per_sec;
+    }
+    if (conn_str_params.rate_limit_burst != DEFAULT_RATE_LIMIT_BURST) {
+        merged.rate_limit_burst = conn_str_params.rate_limit_burst;
+    }
+    if (conn_str_params.max_inflight_per_endpoint != DEFAULT_MAX_INFLIGHT_PER_ENDPOINT) {
+        merged.max_inflight_per_endpoint = conn_str_params.max_inflight_per_endpoint;
+    }
+    if (conn_str_params.max_inflight_per_user != DEFAULT_MAX_INFLIGHT_PER_USER) {
+        merged.max_inflight_per_user = conn_str_params.max_inflight_per_user;
+    }
+    if (conn_str_params.priority != DEFAULT_PRIORITY) {
+        merged.priority = conn_str_params.priority;
+    }
+    if (conn_str_params.coalesce_queries != DEFAULT_COALESCE_QUERIES) {
+        merged.coalesce_queries = conn_str_params.coalesce_queries;
+    }
+    if (conn_str_params.json_parser != DEFAULT_JSON_PARSER) {
+        merged.json_parser = conn_str_params.json_parser;
+    }
+    if (conn_str_params.decode_threads != DEFAULT_DECODE_THREADS) {
+        merged.decode_threads = conn_str_params.decode_threads;
+    }
+    if (conn_str_params.lazy_decode != DEFAULT_LAZY_DECODE) {
+        merged.lazy_decode = conn_str_params.lazy_decode;
+    }
+    if (conn_str_params.response_format != DEFAULT_RESPONSE_FORMAT) {
+        merged.response_format = conn_str_params.response_format;
+    }
+    if (conn_str_params.memory_budget_mb != DEFAULT_MEMORY_BUDGET_MB) {
+        merged.memory_budget_mb = conn_str_params.memory_budget_mb;
+    }
+    if (conn_str_params.session_pool_idle_sec != DEFAULT_SESSION_POOL_IDLE_SEC) {
+        merged.session_pool_idle_sec = conn_str_params.session_pool_idle_sec;
+    }
+    if (conn_str_params.lazy_connect != DEFAULT_LAZY_CONNECT) {
+        merged.lazy_connect = conn_str_params.lazy_connect;
+    }
+    if (conn_str_params.simplify_tolerance != DEFAULT_SIMPLIFY_TOLERANCE) {
+        merged.simplify_tolerance = conn_str_params.simplify_tolerance;
+    }
+    if (conn_str_params.tile_cache_sec != DEFAULT_TILE_CACHE_SEC) {
+        merged.tile_cache_sec = conn_str_params.tile_cache_sec;
+    }
+    if (conn_str_params.tile_prefetch != DEFAULT_TILE_PREFETCH) {
+        merged.tile_prefetch = conn_str_params.tile_prefetch;
+    }
+    if (conn_str_params.layer_stats_sample != DEFAULT_LAYER_STATS_SAMPLE) {
+        merged.layer_stats_sample = conn_str_params.layer_stats_sample;
+    }
     
     return merged;
 }
@@ -0,0 +1,232 @@
+#include "leafodbc/exec_job.h"
+#include "leafodbc/metrics.h"
+#include "leafodbc/trace.h"
+#include "leafodbc/layer_stats.h"
+#include <curl/curl.h>
+#include <cstdio>
+
+namespace leafodbc {
+
+void ExecJob::fail(const std::string& sqlstate, SQLINTEGER native_error, const std::string& message) {
+    diags.push_back(DiagRecord{sqlstate, native_error, message});
+    ret = SQL_ERROR;
+}
+
+bool ExecJob::fail_if_stopped() {
+    if (cancel && cancel->cancelled()) {
+        fail("HY008", 0, "Operation canceled");
+        Metrics::instance().statements_cancelled.add();
+    } else if ((cancel && cancel->expired()) || client->last_curl_code() == CURLE_OPERATION_TIMEDOUT) {
+        fail("HYT00", 0, "Timeout expired");
+        Metrics::instance().statement_timeouts.add();
+    } else {
+        return false;
+    }
+    stopped_ = true;
+    result_store.reset();
+    return true;
+}
+
+void ExecJob::run() {
+    while (follow()) {
+        bool done = false;
+        {
+            LEAF_TRACE_SCOPE("coalesced_wait", "http");
+            done = flight_->wait(cancel.get());
+        }
+        if (!done) {
+            flight_.reset();
+            fail_if_stopped();
+            return;
+        }
+        if (finish_following()) {
+            return;
+        }
+    }
+    finish(client->execute_query(sql, sql_engine, result_store, priority));
+}
+
+bool ExecJob::follow() {
+    if (!coalesce) {
+        return false;
+    }
+    std::string key = QueryCoalescer::make_key(endpoint, username, sql_engine, sql);
+    if (simplify_tolerance > 0) {
+        char tolerance[32];
+        std::snprintf(tolerance, sizeof(tolerance), "\n%.17g", simplify_tolerance);
+        key += tolerance;
+    }
+    flight_ = QueryCoalescer::instance().join(key, leader_);
+    if (leader_) {
+        return false;
+    }
+    LEAF_LOG_DEBUG("Joining identical in-flight query: %.100s...", sql.c_str());
+    return true;
+}
+
+bool ExecJob::finish_following() {
+    auto flight = std::move(flight_);
+    const QueryOutcome& outcome = flight->outcome();
+    if (outcome.stopped) {
+        // The leader's SQLCancel or timeout does not apply to this statement
+        return false;
+    }
+    Metrics::instance().coalesced_queries.add();
+    if (fail_if_stopped()) {
+        return true;
+    }
+    
+    ret = outcome.ret;
+    diags = outcome.diags;
+    if (outcome.store) {
+        resultset = std::make_unique<ResultSet>(outcome.store);
+        timings = outcome.timings;
+        timings.total_us = elapsed_us(start);
+        Metrics::instance().statement_latency.observe_us(timings.total_us);
+    }
+    return true;
+}
+
+void ExecJob::finish(bool query_ok) {
+    if (needs_reauthentication(query_ok)) {
+        if (!reauthenticated(client->authenticate(username, password, remember_me))) {
+            complete_flight();
+            return;
+        }
+        query_ok = client->execute_query(sql, sql_engine, result_store, priority);
+    }
+    load_result(query_ok);
+    complete_flight();
+}
+
+void ExecJob::finish_async(bool query_ok, std::function<void()> done) {
+    if (!needs_reauthentication(query_ok)) {
+        load_result(query_ok);
+        complete_flight();
+        done();
+        return;
+    }
+    client->authenticate_async(username, password, remember_me, [this, done](bool auth_ok) {
+        if (!reauthenticated(auth_ok)) {
+            complete_flight();
+            done();
+            return;
+        }
+        client->execute_query_async(sql, sql_engine, result_store, priority, [this, done](bool ok) {
+            load_result(ok);
+            complete_flight();
+            done();
+        });
+    });
+}
+
+void ExecJob::complete_flight() {
+    if (!leader_) {
+        return;
+    }
+    QueryOutcome outcome;
+    outcome.ret = ret;
+    outcome.diags = diags;
+    outcome.store = resultset ? resultset->store() : nullptr;
+    outcome.timings = timings;
+    outcome.stopped = stopped_;
+    QueryCoalescer::instance().complete(flight_, std::move(outcome));
+    flight_.reset();
+    leader_ = false;
+}
+
+bool ExecJob::needs_reauthentication(bool query_ok) {
+    // Only an expired token warrants reauthentication and a second attempt
+    if (query_ok || (cancel && cancel->stop_requested()) || client->last_status_code() != 401) {
+        return false;
+    }
+    Metrics::instance().retries.add();
+    return true;
+}
+
+bool ExecJob::reauthenticated(bool auth_ok) {
+    if (!auth_ok) {
+        if (!fail_if_stopped()) {
+            fail("28000", 0, "Reauthentication failed");
+        }
+        return false;
+    }
+    new_token = client->get_token();
+    return true;
+}
+
+void ExecJob::load_result(bool query_ok) {
+    if (!query_ok) {
+        if (!fail_if_stopped()) {
+            fail("HY000", client->last_status_code(), "Query execution failed");
+        }
+        return;
+    }
+    
+    // A cancel that arrives after the download still discards the response
+    if (cancel && cancel->cancelled()) {
+        fail_if_stopped();
+        return;
+    }
+    
+    // Decode and schema timings come from the client
+    timings = client->last_timings();
+    if (!layer_stats_key.empty()) {
+        LayerStatsCache::instance().observe(layer_stats_key, result_store);
+    }
+    resultset = std::make_unique<ResultSet>(std::move(result_store));
+    
+    timings.rows = static_cast<int64_t>(resultset->get_row_count());
+    timings.total_us = elapsed_us(start);
+    Metrics::instance().statement_latency.observe_us(timings.total_us);
+}
+
+void AsyncExec::start(std::shared_ptr<AsyncExec> op) {
+    ExecJob& job = op->job;
+    if (job.follow()) {
+        // SQLCancel on a follower takes effect once the shared request is done
+        job.flight()->on_done([op] {
+            if (!op->job.finish_following()) {
+                start(op);
+                return;
+            }
+            op->complete();
+        });
+        return;
+    }
+    job.client->execute_query_async(job.sql, job.sql_engine, job.result_store, job.priority, [op](bool ok) {
+        op->job.finish_async(ok, [op] { op->complete(); });
+    });
+}
+
+void AsyncExec::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return done.load(std::memory_order_acquire); });
+}
+
+bool AsyncExec::notify_when_done(AsyncNotificationCallback notify, SQLPOINTER notify_context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done.load(std::memory_order_acquire)) {
+        return false;
+    }
+    callback = notify;
+    context = notify_context;
+    return true;
+}
+
+void AsyncExec::complete() {
+    AsyncNotificationCallback notify;
+    SQLPOINTER notify_context;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done.store(true, std::memory_order_release);
+        notify = callback;
+        notify_context = context;
+    }
+    done_cv_.notify_all();
+    if (notify) {
+        notify(notify_context, 1);
+    }
+}
+
+} // namespace leafodbc
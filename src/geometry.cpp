@@ -0,0 +1,380 @@
+#include "leafodbc/geometry.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+namespace leafodbc {
+
+namespace {
+
+bool is_alpha(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) != 0;
+}
+
+bool is_space(char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::toupper(static_cast<unsigned char>(a[i])) != std::toupper(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && is_space(s.front())) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && is_space(s.back())) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// First two ordinates of a vertex ("x y", "x y z" or "x y z m")
+bool parse_xy(std::string_view vertex, double& x, double& y) {
+    const char* p = vertex.data();
+    const char* end = p + vertex.size();
+    auto parsed = std::from_chars(p, end, x);
+    if (parsed.ec != std::errc() || parsed.ptr == end || !is_space(*parsed.ptr)) {
+        return false;
+    }
+    p = parsed.ptr;
+    while (p != end && is_space(*p)) {
+        ++p;
+    }
+    parsed = std::from_chars(p, end, y);
+    return parsed.ec == std::errc();
+}
+
+const char* const GEOMETRY_TYPES[] = {
+    "POINT", "LINESTRING", "POLYGON", "MULTIPOINT", "MULTILINESTRING", "MULTIPOLYGON", "GEOMETRYCOLLECTION",
+};
+
+} // namespace
+
+bool wkt_bounds(std::string_view wkt, Bounds& bounds, size_t* vertices) {
+    if (!WktSimplifier::looks_like_wkt(wkt)) {
+        return false;
+    }
+    bool found = false;
+    size_t count = 0;
+    size_t open = wkt.find('(');
+    while (open != std::string_view::npos) {
+        size_t next = wkt.find_first_of("()", open + 1);
+        if (next == std::string_view::npos) {
+            return false;
+        }
+        if (wkt[next] == ')') {
+            // Innermost parentheses: a coordinate list
+            std::string_view list = wkt.substr(open + 1, next - open - 1);
+            size_t pos = 0;
+            while (true) {
+                size_t comma = list.find(',', pos);
+                if (comma == std::string_view::npos) {
+                    comma = list.size();
+                }
+                double x = 0;
+                double y = 0;
+                if (!parse_xy(trim(list.substr(pos, comma - pos)), x, y)) {
+                    return false;
+                }
+                if (!found) {
+                    bounds = Bounds{x, y, x, y};
+                    found = true;
+                } else {
+                    bounds.min_x = std::min(bounds.min_x, x);
+                    bounds.min_y = std::min(bounds.min_y, y);
+                    bounds.max_x = std::max(bounds.max_x, x);
+                    bounds.max_y = std::max(bounds.max_y, y);
+                }
+                ++count;
+                if (comma == list.size()) {
+                    break;
+                }
+                pos = comma + 1;
+            }
+        }
+        open = wkt.find('(', next);
+    }
+    if (vertices) {
+        *vertices = count;
+    }
+    return found;
+}
+
+bool WktSimplifier::looks_like_wkt(std::string_view text) {
+    text = trim(text);
+    // EWKT: SRID=4326;POLYGON(...)
+    if (text.size() > 5 && iequals(text.substr(0, 5), "SRID=")) {
+        size_t semicolon = text.find(';');
+        if (semicolon == std::string_view::npos) {
+            return false;
+        }
+        text.remove_prefix(semicolon + 1);
+    }
+    size_t word_end = 0;
+    while (word_end < text.size() && is_alpha(text[word_end])) {
+        ++word_end;
+    }
+    std::string_view word = text.substr(0, word_end);
+    for (const char* type : GEOMETRY_TYPES) {
+        if (iequals(word, type)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WktSimplifier::simplify(std::string_view wkt, std::string& out) {
+    if (!looks_like_wkt(wkt)) {
+        return false;
+    }
+    out.clear();
+    out.reserve(wkt.size());
+    size_t removed_before = removed_;
+    bool changed = false;
+    bool line = false; // Inside a LINESTRING or MULTILINESTRING
+    bool ring = false; // Inside a POLYGON or MULTIPOLYGON
+    size_t copied = 0;
+    size_t i = 0;
+    while (i < wkt.size()) {
+        char c = wkt[i];
+        if (is_alpha(c)) {
+            // Type keywords; members of a GEOMETRYCOLLECTION have their own
+            size_t start = i;
+            while (i < wkt.size() && is_alpha(wkt[i])) {
+                ++i;
+            }
+            std::string_view word = wkt.substr(start, i - start);
+            if (!iequals(word, "Z") && !iequals(word, "M") && !iequals(word, "ZM") && !iequals(word, "EMPTY")) {
+                line = iequals(word, "LINESTRING") || iequals(word, "MULTILINESTRING");
+                ring = iequals(word, "POLYGON") || iequals(word, "MULTIPOLYGON");
+            }
+            continue;
+        }
+        if (c != '(') {
+            ++i;
+            continue;
+        }
+        size_t next = wkt.find_first_of("()", i + 1);
+        if (next == std::string_view::npos) {
+            removed_ = removed_before;
+            return false;
+        }
+        if (wkt[next] == ')' && (line || ring)) {
+            // Innermost parentheses: a coordinate list
+            out.append(wkt.substr(copied, i + 1 - copied));
+            std::string_view list = wkt.substr(i + 1, next - i - 1);
+            if (simplify_list(list, ring, out)) {
+                changed = true;
+            } else {
+                out.append(list);
+            }
+            copied = next;
+        }
+        i = next;
+    }
+    out.append(wkt.substr(copied));
+    if (!changed || out.size() > wkt.size()) {
+        removed_ = removed_before;
+        return false;
+    }
+    return true;
+}
+
+bool WktSimplifier::simplify_list(std::string_view list, bool ring, std::string& out) {
+    vertices_.clear();
+    x_.clear();
+    y_.clear();
+    size_t pos = 0;
+    while (true) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string_view::npos) {
+            comma = list.size();
+        }
+        std::string_view vertex = trim(list.substr(pos, comma - pos));
+        double x = 0;
+        double y = 0;
+        if (!parse_xy(vertex, x, y)) {
+            return false;
+        }
+        vertices_.push_back(vertex);
+        x_.push_back(x);
+        y_.push_back(y);
+        if (comma == list.size()) {
+            break;
+        }
+        pos = comma + 1;
+    }
+
+    const size_t n = vertices_.size();
+    if (n <= (ring ? 4u : 2u)) {
+        return false;
+    }
+    distance_.resize(n);
+    keep_.assign(n, 0);
+    keep_[0] = 1;
+    keep_[n - 1] = 1;
+
+    if (ring && x_[0] == x_[n - 1] && y_[0] == y_[n - 1]) {
+        // The closing segment has no length: split the ring at the vertex
+        // farthest from its start and simplify both halves
+        double distance_sq = 0;
+        size_t split = farthest(0, n - 1, distance_sq);
+        if (distance_sq <= 0) {
+            return false;
+        }
+        keep_[split] = 1;
+        douglas_peucker(0, split);
+        douglas_peucker(split, n - 1);
+        size_t kept = 0;
+        for (char k : keep_) {
+            kept += k;
+        }
+        if (kept < 4) {
+            // Keep a triangle so that the ring still has an area
+            double first_sq = 0;
+            double second_sq = 0;
+            size_t first = farthest(0, split, first_sq);
+            size_t second = farthest(split, n - 1, second_sq);
+            if (first_sq < 0 && second_sq < 0) {
+                return false;
+            }
+            keep_[first_sq >= second_sq ? first : second] = 1;
+        }
+    } else {
+        douglas_peucker(0, n - 1);
+    }
+
+    size_t kept = 0;
+    for (char k : keep_) {
+        kept += k;
+    }
+    if (kept == n) {
+        return false;
+    }
+    removed_ += n - kept;
+
+    // Same spacing as the original: what precedes the first vertex, between
+    // the first two, and follows the last
+    const char* first_end = vertices_[0].data() + vertices_[0].size();
+    std::string_view separator(first_end, static_cast<size_t>(vertices_[1].data() - first_end));
+    out.append(list.data(), static_cast<size_t>(vertices_[0].data() - list.data()));
+    bool first = true;
+    for (size_t v = 0; v < n; ++v) {
+        if (!keep_[v]) {
+            continue;
+        }
+        if (!first) {
+            out.append(separator);
+        }
+        out.append(vertices_[v]);
+        first = false;
+    }
+    const char* last_end = vertices_[n - 1].data() + vertices_[n - 1].size();
+    out.append(last_end, static_cast<size_t>(list.data() + list.size() - last_end));
+    return true;
+}
+
+void WktSimplifier::douglas_peucker(size_t first, size_t last) {
+    stack_.clear();
+    stack_.emplace_back(first, last);
+    while (!stack_.empty()) {
+        auto [from, to] = stack_.back();
+        stack_.pop_back();
+        double distance_sq = 0;
+        size_t k = farthest(from, to, distance_sq);
+        if (distance_sq <= tolerance_sq_) {
+            continue;
+        }
+        keep_[k] = 1;
+        stack_.emplace_back(from, k);
+        stack_.emplace_back(k, to);
+    }
+}
+
+size_t WktSimplifier::farthest(size_t first, size_t last, double& distance_sq) {
+    distance_sq = -1;
+    if (last - first < 2) {
+        return last;
+    }
+    const size_t count = last - first - 1;
+    const double* px = x_.data() + first + 1;
+    const double* py = y_.data() + first + 1;
+    double* d = distance_.data();
+    const double ax = x_[first];
+    const double ay = y_[first];
+    const double dx = x_[last] - ax;
+    const double dy = y_[last] - ay;
+    const double length_sq = dx * dx + dy * dy;
+
+    // Branch-free loops over contiguous coordinates, so that the compiler
+    // vectorizes them. The squared cross product is the squared distance to
+    // the line times length_sq; a zero-length segment measures to its start.
+    if (length_sq > 0) {
+        for (size_t k = 0; k < count; ++k) {
+            double cross = dx * (py[k] - ay) - dy * (px[k] - ax);
+            d[k] = cross * cross;
+        }
+    } else {
+        for (size_t k = 0; k < count; ++k) {
+            double ex = px[k] - ax;
+            double ey = py[k] - ay;
+            d[k] = ex * ex + ey * ey;
+        }
+    }
+    double max_d = 0;
+    for (size_t k = 0; k < count; ++k) {
+        max_d = d[k] > max_d ? d[k] : max_d;
+    }
+    size_t k = 0;
+    while (k + 1 < count && d[k] != max_d) {
+        ++k;
+    }
+    distance_sq = length_sq > 0 ? max_d / length_sq : max_d;
+    return first + 1 + k;
+}
+
+size_t simplify_geometries(ResultStore& store, double tolerance) {
+    if (tolerance <= 0 || store.lazy || store.spilled) {
+        return 0;
+    }
+    const size_t column_count = store.columns.size();
+    WktSimplifier simplifier(tolerance);
+    std::string simplified;
+    for (size_t column = 0; column < column_count; ++column) {
+        // The first value decides whether a column holds geometries
+        bool geometry = false;
+        for (size_t row = 0; row < store.row_count; ++row) {
+            const Value& value = store.cells[row * column_count + column];
+            if (!value.is_null()) {
+                geometry = value.kind == Value::Kind::String && WktSimplifier::looks_like_wkt(value.str());
+                break;
+            }
+        }
+        if (!geometry) {
+            continue;
+        }
+        for (size_t row = 0; row < store.row_count; ++row) {
+            Value& value = store.cells[row * column_count + column];
+            if (value.kind != Value::Kind::String || !simplifier.simplify(value.str(), simplified)) {
+                continue;
+            }
+            // Never longer than the original, so it takes the original's place
+            // in the arena
+            std::memcpy(const_cast<char*>(value.text), simplified.data(), simplified.size());
+            value.length = static_cast<uint32_t>(simplified.size());
+        }
+    }
+    return simplifier.removed_vertices();
+}
+
+} // namespace leafodbc
@@ -1,11 +1,17 @@
 #include "leafodbc/handles.h"
 #include "leafodbc/common.h"
 #include "leafodbc/resultset.h"
+#include "leafodbc/metrics.h"
 #include <algorithm>
 #include <cstring>
 
 namespace leafodbc {
 
+void PendingConnect::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return done; });
+}
+
 void DiagStack::add(const std::string& sqlstate, SQLINTEGER native_error, const std::string& message) {
     std::lock_guard<std::mutex> lock(mutex_);
     DiagRecord rec;
@@ -117,6 +123,7 @@ SQLRETURN HandleRegistry::alloc_env(SQLHENV* env_handle) {
     next_env_handle_ = h;
     env_handles_[h] = std::move(handle);
     *env_handle = h;
+    Metrics::instance().open_env_handles.inc();
     return SQL_SUCCESS;
 }
 
@@ -135,6 +142,7 @@ SQLRETURN HandleRegistry::alloc_connect(SQLHENV env_handle, SQLHDBC* conn_handle
     next_conn_handle_ = h;
     conn_handles_[h] = std::move(handle);
     *conn_handle = h;
+    Metrics::instance().open_conn_handles.inc();
     return SQL_SUCCESS;
 }
 
@@ -144,16 +152,27 @@ SQLRETURN HandleRegistry::alloc_stmt(SQLHDBC conn_handle, SQLHSTMT* stmt_handle)
     }
     
     std::lock_guard<std::mutex> lock(mutex_);
-    if (conn_handles_.find(conn_handle) == conn_handles_.end()) {
+    auto conn_it = conn_handles_.find(conn_handle);
+    if (conn_it == conn_handles_.end()) {
         return SQL_INVALID_HANDLE;
     }
     
     auto handle = std::make_unique<StmtHandle>();
     handle->conn_handle = conn_handle; // Store parent connection
+    {
+        // Connection defaults are written under the connection's mutex; it
+        // is only ever taken after the registry's, never before
+        ConnHandle& conn = *conn_it->second;
+        std::lock_guard<std::mutex> conn_lock(conn.mutex);
+        handle->priority = conn.default_priority;
+        handle->memory_budget_mb = static_cast<SQLULEN>(conn.memory_budget_mb);
+        handle->simplify_tolerance = conn.simplify_tolerance;
+    }
     SQLHSTMT h = reinterpret_cast<SQLHSTMT>(reinterpret_cast<uintptr_t>(next_stmt_handle_) + 1);
     next_stmt_handle_ = h;
     stmt_handles_[h] = std::move(handle);
     *stmt_handle = h;
+    Metrics::instance().open_stmt_handles.inc();
     return SQL_SUCCESS;
 }
 
@@ -164,6 +183,7 @@ SQLRETURN HandleRegistry::free_env(SQLHENV env_handle) {
         return SQL_INVALID_HANDLE;
     }
     env_handles_.erase(it);
+    Metrics::instance().open_env_handles.dec();
     return SQL_SUCCESS;
 }
 
@@ -174,6 +194,7 @@ SQLRETURN HandleRegistry::free_connect(SQLHDBC conn_handle) {
         return SQL_INVALID_HANDLE;
     }
     conn_handles_.erase(it);
+    Metrics::instance().open_conn_handles.dec();
     return SQL_SUCCESS;
 }
 
@@ -184,6 +205,7 @@ SQLRETURN HandleRegistry::free_stmt(SQLHSTMT stmt_handle) {
         return SQL_INVALID_HANDLE;
     }
     stmt_handles_.erase(it);
+    Metrics::instance().open_stmt_handles.dec();
     return SQL_SUCCESS;
 }
 
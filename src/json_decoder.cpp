@@ -0,0 +1,989 @@
+#include "leafodbc/json_decoder.h"
+#include "leafodbc/task_pool.h"
+#include "leafodbc/trace.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <charconv>
+#include <unordered_map>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef LEAFODBC_HAVE_SIMDJSON
+#include <simdjson.h>
+#endif
+
+namespace leafodbc {
+
+namespace {
+
+using json = nlohmann::json;
+
+// SAX handler; see nlohmann::json_sax for the event interface
+class RowsHandler {
+public:
+    // With `in_rows`, each top-level value is a row, as in NDJSON
+    explicit RowsHandler(ResultStoreBuilder& builder, bool in_rows = false) : builder_(builder) {
+        if (in_rows) {
+            frames_.push_back(Frame::Rows);
+        }
+    }
+
+    std::string error;
+
+    bool null() { return scalar(Value(), nullptr); }
+    bool boolean(bool v) { return scalar(Value::make_bool(v), [v] { return json(v); }); }
+    bool number_integer(json::number_integer_t v) { return scalar(Value::make_int(v), [v] { return json(v); }); }
+    bool number_unsigned(json::number_unsigned_t v) { return scalar(Value::make_uint(v), [v] { return json(v); }); }
+    bool number_float(json::number_float_t v, const json::string_t&) {
+        return scalar(Value::make_double(v), [v] { return json(v); });
+    }
+    bool string(json::string_t& v) {
+        if (top() == Frame::Row) {
+            builder_.set(field_, Value::make_text(Value::Kind::String, builder_.arena().copy(v)));
+            return true;
+        }
+        return scalar(Value(), [&v] { return json(std::move(v)); });
+    }
+    bool binary(json::binary_t&) { return scalar(Value(), [] { return json(); }); }
+
+    bool start_object(size_t) { return open(Frame::Envelope, json::value_t::object); }
+    bool start_array(size_t) { return open(Frame::Rows, json::value_t::array); }
+    bool end_object() { return close(); }
+    bool end_array() { return close(); }
+
+    bool key(json::string_t& k) {
+        switch (top()) {
+            case Frame::Envelope:
+                expect_rows_ = (k == "rows");
+                break;
+            case Frame::Row:
+                field_ = builder_.key(k);
+                break;
+            case Frame::Nested:
+                nested_key_ = k;
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) {
+        error = ex.what();
+        return false;
+    }
+
+private:
+    enum class Frame : uint8_t {
+        None,     // Top level
+        Envelope, // Object that may hold "rows"
+        Rows,     // Array of rows
+        Row,      // One row object
+        BadRow,   // Row element that is not an object: a row of NULLs
+        Nested,   // Object or array inside a row, kept as JSON text
+        Skip      // Anything else
+    };
+
+    ResultStoreBuilder& builder_;
+    std::vector<Frame> frames_;
+    bool expect_rows_ = false;
+    uint32_t field_ = 0;
+
+    // DOM of the nested value being captured
+    json nested_root_;
+    std::vector<json*> nested_;
+    std::string nested_key_;
+
+    Frame top() const { return frames_.empty() ? Frame::None : frames_.back(); }
+
+    // Adds a value to the innermost nested container
+    json* nested_insert(json value) {
+        json* parent = nested_.back();
+        if (parent->is_object()) {
+            json& slot = (*parent)[nested_key_];
+            slot = std::move(value);
+            return &slot;
+        }
+        parent->push_back(std::move(value));
+        return &parent->back();
+    }
+
+    template <typename MakeJson>
+    bool scalar(Value value, MakeJson make_json) {
+        switch (top()) {
+            case Frame::Row:
+                builder_.set(field_, value);
+                break;
+            case Frame::Rows:
+                builder_.begin_row();
+                break;
+            case Frame::Nested:
+                nested_insert(make_json());
+                break;
+            default:
+                break;
+        }
+        expect_rows_ = false;
+        return true;
+    }
+
+    bool scalar(Value value, std::nullptr_t) {
+        return scalar(value, [] { return json(); });
+    }
+
+    bool open(Frame container, json::value_t type) {
+        bool is_object = type == json::value_t::object;
+        Frame next = Frame::Skip;
+        switch (top()) {
+            case Frame::None:
+                next = container;
+                break;
+            case Frame::Envelope:
+                // At most {"rows": {"rows": [...]}}
+                next = expect_rows_ && (container == Frame::Rows || frames_.size() < 2) ? container : Frame::Skip;
+                break;
+            case Frame::Rows:
+                builder_.begin_row();
+                next = is_object ? Frame::Row : Frame::BadRow;
+                break;
+            case Frame::Row:
+                nested_root_ = json(type);
+                nested_.assign(1, &nested_root_);
+                next = Frame::Nested;
+                break;
+            case Frame::Nested:
+                nested_.push_back(nested_insert(json(type)));
+                next = Frame::Nested;
+                break;
+            default:
+                break;
+        }
+        expect_rows_ = false;
+        frames_.push_back(next);
+        return true;
+    }
+
+    bool close() {
+        Frame closed = top();
+        frames_.pop_back();
+        switch (closed) {
+            case Frame::Nested:
+                nested_.pop_back();
+                if (nested_.empty()) {
+                    builder_.set(field_, Value::make_text(Value::Kind::Json, builder_.arena().copy(nested_root_.dump())));
+                    nested_root_ = json();
+                }
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+};
+
+bool decode_with_nlohmann(const std::string& body, ResultStoreBuilder& builder, std::string& error) {
+    RowsHandler handler(builder);
+    bool ok = json::sax_parse(body, &handler);
+    if (!ok) {
+        error = handler.error.empty() ? "Invalid JSON" : handler.error;
+    }
+    return ok;
+}
+
+bool decode_ndjson_with_nlohmann(std::string_view text, ResultStoreBuilder& builder, std::string& error) {
+    RowsHandler handler(builder, true);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string_view::npos) {
+            end = text.size();
+        }
+        std::string_view line = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+            continue;
+        }
+        if (!json::sax_parse(line.begin(), line.end(), &handler)) {
+            error = handler.error.empty() ? "Invalid JSON" : handler.error;
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef LEAFODBC_HAVE_SIMDJSON
+
+// Parsers keep their buffers for the next document; larger documents get a
+// parser of their own so that worker threads do not pin that much memory
+constexpr size_t MAX_CACHED_PARSER_DOCUMENT = 16 * 1024 * 1024;
+
+json to_nlohmann(simdjson::dom::element element) {
+    switch (element.type()) {
+        case simdjson::dom::element_type::ARRAY: {
+            json array = json::array();
+            for (simdjson::dom::element item : simdjson::dom::array(element)) {
+                array.push_back(to_nlohmann(item));
+            }
+            return array;
+        }
+        case simdjson::dom::element_type::OBJECT: {
+            json object = json::object();
+            for (simdjson::dom::key_value_pair field : simdjson::dom::object(element)) {
+                object[std::string(field.key)] = to_nlohmann(field.value);
+            }
+            return object;
+        }
+        case simdjson::dom::element_type::INT64: return json(int64_t(element));
+        case simdjson::dom::element_type::UINT64: return json(uint64_t(element));
+        case simdjson::dom::element_type::DOUBLE: return json(double(element));
+        case simdjson::dom::element_type::STRING: return json(std::string(std::string_view(element)));
+        case simdjson::dom::element_type::BOOL: return json(bool(element));
+        default: return json();
+    }
+}
+
+Value to_value(simdjson::dom::element element, Arena& arena) {
+    switch (element.type()) {
+        case simdjson::dom::element_type::INT64: return Value::make_int(int64_t(element));
+        case simdjson::dom::element_type::UINT64: return Value::make_uint(uint64_t(element));
+        case simdjson::dom::element_type::DOUBLE: return Value::make_double(double(element));
+        case simdjson::dom::element_type::STRING:
+            return Value::make_text(Value::Kind::String, arena.copy(std::string_view(element)));
+        case simdjson::dom::element_type::BOOL: return Value::make_bool(bool(element));
+        case simdjson::dom::element_type::NULL_VALUE: return Value();
+        default:
+            // Same text the nlohmann path stores for nested values
+            return Value::make_text(Value::Kind::Json, arena.copy(to_nlohmann(element).dump()));
+    }
+}
+
+// Rows array of a parsed response, in the shapes decode_json_rows accepts
+bool find_rows(simdjson::dom::element doc, simdjson::dom::array& rows) {
+    for (int depth = 0; depth < 3; ++depth) {
+        if (doc.is_array()) {
+            rows = simdjson::dom::array(doc);
+            return true;
+        }
+        if (!doc.is_object() || depth == 2 || doc["rows"].get(doc) != simdjson::SUCCESS) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool decode_with_simdjson(std::string& body, ResultStoreBuilder& builder, std::string& error) {
+    thread_local simdjson::dom::parser cached_parser;
+    simdjson::dom::parser large_parser;
+    simdjson::dom::parser& parser = body.size() <= MAX_CACHED_PARSER_DOCUMENT ? cached_parser : large_parser;
+    
+    // simdjson reads up to SIMDJSON_PADDING bytes past the end of the input
+    if (body.capacity() - body.size() < simdjson::SIMDJSON_PADDING) {
+        body.reserve(body.size() + simdjson::SIMDJSON_PADDING);
+    }
+    simdjson::dom::element doc;
+    auto err = parser.parse(body.data(), body.size(), false).get(doc);
+    if (err) {
+        error = simdjson::error_message(err);
+        return false;
+    }
+    
+    simdjson::dom::array rows;
+    if (!find_rows(doc, rows)) {
+        return true;
+    }
+    simdjson::dom::element first_row;
+    simdjson::dom::object first_fields;
+    if (rows.at(0).get(first_row) == simdjson::SUCCESS && first_row.get(first_fields) == simdjson::SUCCESS) {
+        builder.reserve(rows.size(), first_fields.size());
+    }
+    Arena& arena = builder.arena();
+    for (simdjson::dom::element row : rows) {
+        builder.begin_row();
+        if (row.is_object()) {
+            for (simdjson::dom::key_value_pair field : simdjson::dom::object(row)) {
+                builder.set(builder.key(field.key), to_value(field.value, arena));
+            }
+        }
+    }
+    return true;
+}
+
+bool decode_ndjson_with_simdjson(std::string& text, ResultStoreBuilder& builder, std::string& error) {
+    // Every document must fit in one batch
+    size_t batch = simdjson::dom::DEFAULT_BATCH_SIZE;
+    if (text.size() > batch) {
+        size_t pos = 0;
+        while (pos < text.size()) {
+            const void* found = std::memchr(text.data() + pos, '\n', text.size() - pos);
+            size_t end = found ? static_cast<size_t>(static_cast<const char*>(found) - text.data()) : text.size();
+            batch = std::max(batch, end - pos + 1);
+            pos = end + 1;
+        }
+    }
+    
+    thread_local simdjson::dom::parser cached_parser;
+    simdjson::dom::parser large_parser;
+    simdjson::dom::parser& parser = batch <= MAX_CACHED_PARSER_DOCUMENT ? cached_parser : large_parser;
+    if (text.capacity() - text.size() < simdjson::SIMDJSON_PADDING) {
+        text.reserve(text.size() + simdjson::SIMDJSON_PADDING);
+    }
+    simdjson::dom::document_stream rows;
+    auto err = parser.parse_many(text.data(), text.size(), batch).get(rows);
+    if (err) {
+        error = simdjson::error_message(err);
+        return false;
+    }
+    Arena& arena = builder.arena();
+    for (auto result : rows) {
+        simdjson::dom::element row;
+        if ((err = result.get(row))) {
+            error = simdjson::error_message(err);
+            return false;
+        }
+        builder.begin_row();
+        if (row.is_object()) {
+            for (simdjson::dom::key_value_pair field : simdjson::dom::object(row)) {
+                builder.set(builder.key(field.key), to_value(field.value, arena));
+            }
+        }
+    }
+    if (rows.truncated_bytes() > 0) {
+        error = "Truncated JSON document in NDJSON response";
+        return false;
+    }
+    return true;
+}
+
+#endif // LEAFODBC_HAVE_SIMDJSON
+
+bool decode_serial(JsonParser parser, std::string& body, ResultStoreBuilder& builder, std::string& error) {
+#ifdef LEAFODBC_HAVE_SIMDJSON
+    if (parser == JsonParser::Simd) {
+        return decode_with_simdjson(body, builder, error);
+    }
+#endif
+    (void)parser;
+    return decode_with_nlohmann(body, builder, error);
+}
+
+// Responses smaller than this are decoded on one thread
+constexpr size_t PARALLEL_DECODE_MIN_BYTES = 4 * 1024 * 1024;
+constexpr size_t MIN_CHUNK_BYTES = 1024 * 1024;
+// More chunks than threads, so that uneven rows still balance
+constexpr size_t CHUNKS_PER_THREAD = 4;
+// Under a memory budget, the chunks decoded at once hold at most
+// 1/BUDGET_CHUNK_SHARE of it as text
+constexpr size_t BUDGET_CHUNK_SHARE = 8;
+constexpr size_t MIN_BUDGET_CHUNK_BYTES = 64 * 1024;
+
+size_t skip_ws(std::string_view s, size_t i) {
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r')) {
+        ++i;
+    }
+    return i;
+}
+
+// Index one past the closing quote of the string opening at `i`, or npos
+size_t skip_string(std::string_view s, size_t i) {
+    const char* data = s.data();
+    size_t pos = i + 1;
+    while (pos < s.size()) {
+        const void* found = std::memchr(data + pos, '"', s.size() - pos);
+        if (!found) {
+            break;
+        }
+        size_t quote = static_cast<size_t>(static_cast<const char*>(found) - data);
+        size_t backslashes = 0;
+        while (quote - backslashes > i + 1 && data[quote - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        if (backslashes % 2 == 0) {
+            return quote + 1;
+        }
+        pos = quote + 1;
+    }
+    return std::string::npos;
+}
+
+// Index one past the value starting at `i`, or npos. Only brackets and
+// strings are tracked; the decoders validate everything else.
+size_t skip_value(std::string_view s, size_t i) {
+    int depth = 0;
+    for (; i < s.size(); ++i) {
+        char c = s[i];
+        switch (c) {
+            case '"':
+                i = skip_string(s, i);
+                if (i == std::string::npos) {
+                    return i;
+                }
+                if (depth == 0) {
+                    return i;
+                }
+                --i;
+                break;
+            case '[':
+            case '{':
+                ++depth;
+                break;
+            case ']':
+            case '}':
+                if (depth == 0) {
+                    return i;
+                }
+                if (--depth == 0) {
+                    return i + 1;
+                }
+                break;
+            case ',':
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                if (depth == 0) {
+                    return i;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return depth == 0 ? i : std::string::npos;
+}
+
+// Opening bracket of the rows array, in the same response shapes the
+// decoders accept, or npos
+size_t find_rows_array(std::string_view s) {
+    size_t i = skip_ws(s, 0);
+    for (int level = 0; level < 3; ++level) {
+        if (i < s.size() && s[i] == '[') {
+            return i;
+        }
+        if (i >= s.size() || s[i] != '{' || level == 2) {
+            return std::string::npos;
+        }
+        i = skip_ws(s, i + 1);
+        bool found = false;
+        while (!found && i < s.size() && s[i] == '"') {
+            size_t key_end = skip_value(s, i);
+            if (key_end == std::string::npos) {
+                return std::string::npos;
+            }
+            found = s.compare(i, key_end - i, "\"rows\"") == 0;
+            i = skip_ws(s, key_end);
+            if (i >= s.size() || s[i] != ':') {
+                return std::string::npos;
+            }
+            i = skip_ws(s, i + 1);
+            if (!found) {
+                i = skip_value(s, i);
+                if (i == std::string::npos) {
+                    return std::string::npos;
+                }
+                i = skip_ws(s, i);
+                if (i < s.size() && s[i] == ',') {
+                    i = skip_ws(s, i + 1);
+                }
+            }
+        }
+        if (!found) {
+            return std::string::npos;
+        }
+    }
+    return std::string::npos;
+}
+
+// Splits the elements of the array opening at `open` into ranges of about
+// `chunk_bytes`, cutting only between elements. Returns the index of the
+// closing bracket, or npos if the array is not well formed.
+size_t split_array(std::string_view s, size_t open, size_t chunk_bytes,
+                   std::vector<std::pair<size_t, size_t>>& ranges) {
+    size_t begin = open + 1;
+    size_t next_cut = begin + chunk_bytes;
+    int depth = 1;
+    for (size_t i = begin; i < s.size(); ++i) {
+        char c = s[i];
+        switch (c) {
+            case '"':
+                i = skip_string(s, i);
+                if (i == std::string::npos) {
+                    return i;
+                }
+                --i;
+                break;
+            case '[':
+            case '{':
+                ++depth;
+                break;
+            case ']':
+            case '}':
+                if (--depth == 0) {
+                    if (c != ']') {
+                        return std::string::npos;
+                    }
+                    ranges.emplace_back(begin, i);
+                    // A cut next to a stray comma would hide the syntax error
+                    for (const auto& range : ranges) {
+                        if (ranges.size() > 1 && skip_ws(s, range.first) >= range.second) {
+                            return std::string::npos;
+                        }
+                    }
+                    return i;
+                }
+                break;
+            case ',':
+                if (depth == 1 && i >= next_cut) {
+                    ranges.emplace_back(begin, i);
+                    begin = i + 1;
+                    next_cut = begin + chunk_bytes;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return std::string::npos;
+}
+
+// Rows of one chunk, decoded by whichever thread claims it first
+struct ChunkWork {
+    ChunkDecoder decode_chunk;
+    std::shared_ptr<ArenaPool> arena_pool;
+    std::string_view body;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::vector<std::unique_ptr<ResultStoreBuilder>> builders;
+    std::vector<std::string> errors;
+    std::vector<char> decoded;
+    
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t finished = 0;
+    
+    // Decodes chunks until none are left unclaimed
+    void run() {
+        size_t index;
+        while ((index = next.fetch_add(1)) < ranges.size()) {
+            {
+                LEAF_TRACE_SCOPE("decode_chunk", "decode");
+                size_t begin = ranges[index].first;
+                std::string_view chunk = body.substr(begin, ranges[index].second - begin);
+                auto arena = arena_pool ? arena_pool->acquire() : std::make_shared<Arena>();
+                builders[index] = std::make_unique<ResultStoreBuilder>(std::move(arena));
+                decoded[index] = decode_chunk(chunk, *builders[index], errors[index]);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++finished == ranges.size()) {
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+size_t chunk_bytes_for(size_t bytes, size_t threads, size_t memory_budget) {
+    size_t chunk_bytes = std::max(MIN_CHUNK_BYTES, bytes / (threads * CHUNKS_PER_THREAD) + 1);
+    if (memory_budget) {
+        chunk_bytes = std::min(chunk_bytes, std::max(MIN_BUDGET_CHUNK_BYTES,
+                                                     memory_budget / (threads * BUDGET_CHUNK_SHARE)));
+    }
+    return chunk_bytes;
+}
+
+// Decodes the rows array in chunks. Returns false without touching `builder`
+// if the response cannot be split; the caller then decodes it whole.
+bool decode_array_chunks(const DecodeOptions& options, size_t threads, std::string_view body,
+                         ResultStoreBuilder& builder, std::string& error, bool& decoded) {
+    size_t open = find_rows_array(body);
+    if (open == std::string::npos) {
+        return false;
+    }
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t close = split_array(body, open, chunk_bytes_for(body.size() - open, threads, options.memory_budget),
+                               ranges);
+    if (close == std::string::npos || ranges.size() < 2) {
+        return false;
+    }
+    
+    // Whatever surrounds the rows array still has to be valid JSON
+    std::string shell = std::string(body.substr(0, open)) + "[]" + std::string(body.substr(close + 1));
+    ResultStoreBuilder shell_rows(std::make_shared<Arena>(1024));
+    if (!decode_serial(options.parser, shell, shell_rows, error)) {
+        decoded = false;
+        return true;
+    }
+    
+    JsonParser parser = options.parser;
+    auto decode_elements = [parser](std::string_view elements, ResultStoreBuilder& rows, std::string& chunk_error) {
+        std::string chunk;
+        chunk.reserve(elements.size() + 2 + 64); // Room for simdjson's padding
+        chunk += '[';
+        chunk.append(elements);
+        chunk += ']';
+        return decode_serial(parser, chunk, rows, chunk_error);
+    };
+    decoded = decode_chunks(options, threads, body, std::move(ranges), decode_elements, builder, error);
+    return true;
+}
+
+bool decode_ndjson_serial(JsonParser parser, std::string& text, ResultStoreBuilder& builder, std::string& error) {
+#ifdef LEAFODBC_HAVE_SIMDJSON
+    if (parser == JsonParser::Simd) {
+        return decode_ndjson_with_simdjson(text, builder, error);
+    }
+#endif
+    (void)parser;
+    return decode_ndjson_with_nlohmann(text, builder, error);
+}
+
+// Value of one JSON token, with the same result as the decoders above
+Value decode_json_token(std::string_view text, Arena& arena) {
+    if (text.empty()) {
+        return Value();
+    }
+    switch (text.front()) {
+        case 'n':
+            if (text == "null") {
+                return Value();
+            }
+            break;
+        case 't':
+            if (text == "true") {
+                return Value::make_bool(true);
+            }
+            break;
+        case 'f':
+            if (text == "false") {
+                return Value::make_bool(false);
+            }
+            break;
+        case '"':
+            if (text.size() >= 2 && text.find('\\') == std::string_view::npos) {
+                return Value::make_text(Value::Kind::String, arena.copy(text.substr(1, text.size() - 2)));
+            }
+            break;
+        default:
+            if (text.find_first_of(".eE") == std::string_view::npos) {
+                int64_t i;
+                auto parsed = std::from_chars(text.data(), text.data() + text.size(), i);
+                if (parsed.ec == std::errc() && parsed.ptr == text.data() + text.size()) {
+                    return Value::make_int(i);
+                }
+            }
+            break;
+    }
+    // Escaped strings, floats, large integers and nested values
+    json parsed = json::parse(text.begin(), text.end(), nullptr, false);
+    if (parsed.is_discarded()) {
+        LEAF_LOG_WARN("Malformed value in query response: %.100s", std::string(text).c_str());
+        return Value();
+    }
+    return Value::from_json(parsed, arena);
+}
+
+} // namespace
+
+std::shared_ptr<ResultStore> index_json_rows(std::string& body, std::shared_ptr<Arena> arena) {
+    const std::string& s = body;
+    size_t open = find_rows_array(s);
+    if (open == std::string::npos) {
+        return nullptr;
+    }
+    
+    std::vector<LazyColumns::Field> fields;
+    std::vector<size_t> row_offsets;
+    std::vector<std::string> key_names;
+    std::unordered_map<std::string, uint32_t> key_ids;
+    uint32_t next_key_hint = 0;
+    auto key_id = [&](std::string name) {
+        if (next_key_hint < key_names.size() && key_names[next_key_hint] == name) {
+            return next_key_hint++;
+        }
+        auto it = key_ids.emplace(name, static_cast<uint32_t>(key_names.size())).first;
+        if (it->second == key_names.size()) {
+            key_names.push_back(std::move(name));
+        }
+        next_key_hint = it->second + 1;
+        return it->second;
+    };
+    
+    // Keys are stored in Field::column until the schema is known
+    size_t i = skip_ws(s, open + 1);
+    bool empty = i < s.size() && s[i] == ']';
+    while (!empty) {
+        row_offsets.push_back(fields.size());
+        next_key_hint = 0;
+        if (i < s.size() && s[i] == '{') {
+            i = skip_ws(s, i + 1);
+            bool members = i < s.size() && s[i] != '}';
+            while (members) {
+                if (i >= s.size() || s[i] != '"') {
+                    return nullptr;
+                }
+                size_t key_end = skip_string(s, i);
+                if (key_end == std::string::npos) {
+                    return nullptr;
+                }
+                std::string key = s.substr(i + 1, key_end - i - 2);
+                if (key.find('\\') != std::string::npos) {
+                    json unescaped = json::parse(s.begin() + i, s.begin() + key_end, nullptr, false);
+                    if (!unescaped.is_string()) {
+                        return nullptr;
+                    }
+                    key = unescaped.get<std::string>();
+                }
+                i = skip_ws(s, key_end);
+                if (i >= s.size() || s[i] != ':') {
+                    return nullptr;
+                }
+                i = skip_ws(s, i + 1);
+                size_t value_end = skip_value(s, i);
+                if (value_end == std::string::npos || value_end == i) {
+                    return nullptr;
+                }
+                fields.push_back(LazyColumns::Field{key_id(std::move(key)), static_cast<uint32_t>(value_end - i), i});
+                i = skip_ws(s, value_end);
+                if (i < s.size() && s[i] == ',') {
+                    i = skip_ws(s, i + 1);
+                } else {
+                    members = false;
+                }
+            }
+            if (i >= s.size() || s[i] != '}') {
+                return nullptr;
+            }
+            ++i;
+        } else {
+            // Not an object: a row of NULLs
+            size_t value_end = skip_value(s, i);
+            if (value_end == std::string::npos || value_end == i) {
+                return nullptr;
+            }
+            i = value_end;
+        }
+        i = skip_ws(s, i);
+        if (i < s.size() && s[i] == ',') {
+            i = skip_ws(s, i + 1);
+        } else {
+            break;
+        }
+    }
+    if (i >= s.size() || s[i] != ']') {
+        return nullptr;
+    }
+    
+    // Whatever surrounds the rows array still has to be valid JSON
+    std::string shell = s.substr(0, open) + "[]" + s.substr(i + 1);
+    ResultStoreBuilder shell_rows(std::make_shared<Arena>(1024));
+    std::string error;
+    if (!decode_with_nlohmann(shell, shell_rows, error)) {
+        return nullptr;
+    }
+    
+    // Schema from the decoded sample rows, as a full decode would infer it
+    size_t rows = row_offsets.size();
+    ResultStoreBuilder sample(std::make_shared<Arena>());
+    for (size_t r = 0; r < rows && r < ResultStoreBuilder::SCHEMA_SAMPLE_ROWS; ++r) {
+        sample.begin_row();
+        size_t end = r + 1 < rows ? row_offsets[r + 1] : fields.size();
+        for (size_t f = row_offsets[r]; f < end; ++f) {
+            std::string_view text(s.data() + fields[f].offset, fields[f].length);
+            sample.set(sample.key(key_names[fields[f].column]), decode_json_token(text, sample.arena()));
+        }
+    }
+    auto store = std::make_shared<ResultStore>(std::move(arena));
+    store->columns = sample.finish()->columns;
+    store->row_count = rows;
+    
+    std::unordered_map<std::string, uint32_t> column_ids;
+    for (size_t c = 0; c < store->columns.size(); ++c) {
+        column_ids.emplace(store->columns[c].name, static_cast<uint32_t>(c));
+    }
+    std::vector<uint32_t> column_of_key(key_names.size(), LazyColumns::NO_COLUMN);
+    for (size_t k = 0; k < key_names.size(); ++k) {
+        auto it = column_ids.find(key_names[k]);
+        if (it != column_ids.end()) {
+            column_of_key[k] = it->second;
+        }
+    }
+    for (auto& field : fields) {
+        field.column = column_of_key[field.column];
+    }
+    
+    store->lazy = std::make_unique<LazyColumns>(std::move(body), std::move(fields), std::move(row_offsets),
+                                                store->columns.size(), decode_json_token);
+    return store;
+}
+
+bool simd_json_available() {
+#ifdef LEAFODBC_HAVE_SIMDJSON
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t parallel_decode_threads(const DecodeOptions& options, size_t bytes) {
+    if (bytes < PARALLEL_DECODE_MIN_BYTES) {
+        return 1;
+    }
+    if (options.threads <= 0) {
+        return std::max<size_t>(1, std::min<size_t>(TaskPool::instance().size(), std::thread::hardware_concurrency()));
+    }
+    return static_cast<size_t>(options.threads);
+}
+
+bool decode_in_ranges(const DecodeOptions& options, size_t threads, size_t bytes) {
+    return threads > 1 || (options.memory_budget && bytes > options.memory_budget / 4);
+}
+
+std::vector<std::pair<size_t, size_t>> split_lines(std::string_view body, size_t begin, size_t end,
+                                                   size_t threads, bool csv_quotes, size_t memory_budget) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t chunk_bytes = chunk_bytes_for(end - begin, threads, memory_budget);
+    const char* data = body.data();
+    bool quoted = false; // Inside a quoted field at `scanned`
+    size_t scanned = begin;
+    while (end - begin > chunk_bytes) {
+        size_t pos = begin + chunk_bytes;
+        if (csv_quotes) {
+            for (size_t i = scanned; i < pos; ++i) {
+                quoted ^= (data[i] == '"');
+            }
+        }
+        // First newline at or after pos that is not inside quotes
+        size_t cut = std::string::npos;
+        while (pos < end) {
+            const void* found = std::memchr(data + pos, '\n', end - pos);
+            size_t newline = found ? static_cast<size_t>(static_cast<const char*>(found) - data) : end;
+            if (csv_quotes) {
+                for (size_t i = pos; i < newline; ++i) {
+                    quoted ^= (data[i] == '"');
+                }
+            }
+            if (newline == end) {
+                break;
+            }
+            if (!quoted) {
+                cut = newline + 1;
+                break;
+            }
+            pos = newline + 1;
+        }
+        if (cut == std::string::npos || cut >= end) {
+            break;
+        }
+        ranges.emplace_back(begin, cut);
+        begin = scanned = cut;
+    }
+    ranges.emplace_back(begin, end);
+    return ranges;
+}
+
+bool decode_chunks(const DecodeOptions& options, size_t threads, std::string_view body,
+                   std::vector<std::pair<size_t, size_t>> ranges, const ChunkDecoder& decode_chunk,
+                   ResultStoreBuilder& builder, std::string& error) {
+    // Under a memory budget only `threads` chunks are decoded at a time, and
+    // their rows reach the builder, which may spill them, before the next ones
+    size_t window = options.memory_budget ? threads : ranges.size();
+    for (size_t first = 0; first < ranges.size(); first += window) {
+        auto work = std::make_shared<ChunkWork>();
+        size_t chunks = std::min(window, ranges.size() - first);
+        work->decode_chunk = decode_chunk;
+        work->arena_pool = options.arena_pool;
+        work->body = body;
+        work->ranges.assign(ranges.begin() + first, ranges.begin() + first + chunks);
+        work->builders.resize(chunks);
+        work->errors.resize(chunks);
+        work->decoded.resize(chunks);
+        // Helpers that start after all chunks are claimed return at once
+        size_t helpers = std::min(threads, chunks) - 1;
+        for (size_t h = 0; h < helpers; ++h) {
+            TaskPool::instance().submit([work] { work->run(); });
+        }
+        work->run();
+        {
+            std::unique_lock<std::mutex> lock(work->mutex);
+            work->cv.wait(lock, [&] { return work->finished == chunks; });
+        }
+        
+        for (size_t c = 0; c < chunks; ++c) {
+            if (!work->decoded[c]) {
+                error = work->errors[c];
+                return false;
+            }
+        }
+        for (size_t c = 0; c < chunks; ++c) {
+            builder.append(std::move(work->builders[c]));
+        }
+    }
+    return true;
+}
+
+bool decode_json_rows(const DecodeOptions& options, std::string& body, ResultStoreBuilder& builder,
+                      std::string& error) {
+    size_t threads = parallel_decode_threads(options, body.size());
+    if (decode_in_ranges(options, threads, body.size())) {
+        bool decoded = false;
+        if (decode_array_chunks(options, threads, body, builder, error, decoded)) {
+            return decoded;
+        }
+    }
+    return decode_serial(options.parser, body, builder, error);
+}
+
+bool decode_json_rows_mapped(const DecodeOptions& options, std::string_view body, ResultStoreBuilder& builder,
+                             std::string& error) {
+    size_t threads = parallel_decode_threads(options, body.size());
+    if (decode_in_ranges(options, threads, body.size())) {
+        bool decoded = false;
+        if (decode_array_chunks(options, threads, body, builder, error, decoded)) {
+            return decoded;
+        }
+    }
+    std::string copy(body);
+    return decode_serial(options.parser, copy, builder, error);
+}
+
+namespace {
+
+bool decode_ndjson_ranges(const DecodeOptions& options, size_t threads, std::string_view body,
+                          std::vector<std::pair<size_t, size_t>> ranges, ResultStoreBuilder& builder,
+                          std::string& error) {
+    JsonParser parser = options.parser;
+    auto decode_lines = [parser](std::string_view lines, ResultStoreBuilder& rows, std::string& chunk_error) {
+        if (parser == JsonParser::Nlohmann) {
+            return decode_ndjson_with_nlohmann(lines, rows, chunk_error);
+        }
+        std::string chunk;
+        chunk.reserve(lines.size() + 64); // Room for simdjson's padding
+        chunk.append(lines);
+        return decode_ndjson_serial(parser, chunk, rows, chunk_error);
+    };
+    return decode_chunks(options, threads, body, std::move(ranges), decode_lines, builder, error);
+}
+
+} // namespace
+
+bool decode_ndjson_rows(const DecodeOptions& options, std::string& body, ResultStoreBuilder& builder,
+                        std::string& error) {
+    size_t threads = parallel_decode_threads(options, body.size());
+    if (decode_in_ranges(options, threads, body.size())) {
+        auto ranges = split_lines(body, 0, body.size(), threads, false, options.memory_budget);
+        if (ranges.size() > 1) {
+            return decode_ndjson_ranges(options, threads, body, std::move(ranges), builder, error);
+        }
+    }
+    return decode_ndjson_serial(options.parser, body, builder, error);
+}
+
+bool decode_ndjson_rows_mapped(const DecodeOptions& options, std::string_view body, ResultStoreBuilder& builder,
+                               std::string& error) {
+    size_t threads = parallel_decode_threads(options, body.size());
+    // A single range is decoded through a copy as well
+    auto ranges = split_lines(body, 0, body.size(), threads, false, options.memory_budget);
+    return decode_ndjson_ranges(options, threads, body, std::move(ranges), builder, error);
+}
+
+} // namespace leafodbc
@@ -0,0 +1,315 @@
+#include "leafodbc/layer_stats.h"
+#include "leafodbc/leaf_client.h"
+#include "leafodbc/metadata.h"
+#include "leafodbc/task_pool.h"
+#include "leafodbc/metrics.h"
+#include "leafodbc/logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace leafodbc {
+
+namespace {
+
+// Rows per chunk when statistics are computed in parallel
+constexpr size_t STATS_CHUNK_ROWS = 4096;
+
+bool iequals(const std::string& a, const std::string& b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::toupper(static_cast<unsigned char>(x)) == std::toupper(static_cast<unsigned char>(y));
+           });
+}
+
+// Row ranges of a store shared by the threads computing its statistics
+struct StatsWork {
+    const ResultStore* store = nullptr;
+    size_t column = 0;
+    size_t chunks = 0;
+    std::vector<LayerStats> partial;
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t finished = 0;
+
+    void run() {
+        for (size_t c = next.fetch_add(1); c < chunks; c = next.fetch_add(1)) {
+            size_t end = std::min(store->row_count, (c + 1) * STATS_CHUNK_ROWS);
+            for (size_t row = c * STATS_CHUNK_ROWS; row < end; ++row) {
+                partial[c].add(store->cell(row, column));
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++finished == chunks) {
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+void LayerStats::add(const Value& value) {
+    rows++;
+    if (value.kind != Value::Kind::String) {
+        return;
+    }
+    std::string_view wkt = value.str();
+    while (!wkt.empty() && std::isspace(static_cast<unsigned char>(wkt.front()))) {
+        wkt.remove_prefix(1);
+    }
+    Bounds bounds;
+    size_t count = 0;
+    if (!wkt_bounds(wkt, bounds, &count)) {
+        return;
+    }
+    SQLINTEGER srid = 4326;
+    if (wkt.size() > 5 && (wkt[0] == 'S' || wkt[0] == 's')) {
+        // EWKT: SRID=3857;POINT(...)
+        srid = static_cast<SQLINTEGER>(std::strtol(std::string(wkt.substr(5, 12)).c_str(), nullptr, 10));
+        wkt.remove_prefix(wkt.find(';') + 1);
+    }
+    // The type is in the first word, so the rest of the text is not copied
+    SQLINTEGER type = Metadata::infer_geometry_type(std::string(wkt.substr(0, 24)));
+    geometries++;
+    vertices += count;
+    max_vertices = std::max<uint64_t>(max_vertices, count);
+    type_counts[static_cast<size_t>(type)]++;
+    srid_counts[srid]++;
+    if (!has_extent) {
+        extent = bounds;
+        has_extent = true;
+    } else {
+        extent.min_x = std::min(extent.min_x, bounds.min_x);
+        extent.min_y = std::min(extent.min_y, bounds.min_y);
+        extent.max_x = std::max(extent.max_x, bounds.max_x);
+        extent.max_y = std::max(extent.max_y, bounds.max_y);
+    }
+}
+
+void LayerStats::merge(const LayerStats& other) {
+    rows += other.rows;
+    geometries += other.geometries;
+    vertices += other.vertices;
+    max_vertices = std::max(max_vertices, other.max_vertices);
+    for (size_t t = 0; t < type_counts.size(); t++) {
+        type_counts[t] += other.type_counts[t];
+    }
+    for (const auto& [srid, count] : other.srid_counts) {
+        srid_counts[srid] += count;
+    }
+    if (other.has_extent) {
+        if (!has_extent) {
+            extent = other.extent;
+            has_extent = true;
+        } else {
+            extent.min_x = std::min(extent.min_x, other.extent.min_x);
+            extent.min_y = std::min(extent.min_y, other.extent.min_y);
+            extent.max_x = std::max(extent.max_x, other.extent.max_x);
+            extent.max_y = std::max(extent.max_y, other.extent.max_y);
+        }
+    }
+}
+
+SQLINTEGER LayerStats::geometry_type() const {
+    SQLINTEGER found = -1;
+    for (size_t t = 0; t < type_counts.size(); t++) {
+        if (type_counts[t] == 0) {
+            continue;
+        }
+        SQLINTEGER type = static_cast<SQLINTEGER>(t);
+        if (found < 0 || found == type) {
+            found = type;
+        } else if (found == 1 && type == 7) {
+            found = 7; // Points and multipoints
+        } else if (found == 3 && type == 9) {
+            found = 9; // Linestrings and multilinestrings
+        } else if (found == 5 && type == 11) {
+            found = 11; // Polygons and multipolygons
+        } else {
+            return 0;
+        }
+    }
+    return found < 0 ? 0 : found;
+}
+
+SQLINTEGER LayerStats::srid() const {
+    SQLINTEGER srid = 4326;
+    uint64_t most = 0;
+    for (const auto& [candidate, count] : srid_counts) {
+        if (count > most) {
+            srid = candidate;
+            most = count;
+        }
+    }
+    return srid;
+}
+
+bool compute_layer_stats(const ResultStore& store, LayerStats& stats) {
+    // The first value decides whether a column holds geometries
+    size_t column = store.columns.size();
+    for (size_t c = 0; c < store.columns.size() && column == store.columns.size(); ++c) {
+        for (size_t row = 0; row < store.row_count; ++row) {
+            Value value = store.cell(row, c);
+            if (!value.is_null()) {
+                if (value.kind == Value::Kind::String && WktSimplifier::looks_like_wkt(value.str())) {
+                    column = c;
+                }
+                break;
+            }
+        }
+    }
+    if (column == store.columns.size()) {
+        return false;
+    }
+
+    auto work = std::make_shared<StatsWork>();
+    work->store = &store;
+    work->column = column;
+    work->chunks = (store.row_count + STATS_CHUNK_ROWS - 1) / STATS_CHUNK_ROWS;
+    work->partial.resize(work->chunks);
+    // Helpers that start after all chunks are claimed return at once
+    size_t threads = std::max<size_t>(1, std::min<size_t>(TaskPool::instance().size(), std::thread::hardware_concurrency()));
+    size_t helpers = work->chunks > 1 ? std::min(threads, work->chunks) - 1 : 0;
+    for (size_t h = 0; h < helpers; ++h) {
+        TaskPool::instance().submit([work] { work->run(); });
+    }
+    work->run();
+    {
+        std::unique_lock<std::mutex> lock(work->mutex);
+        work->cv.wait(lock, [&] { return work->finished == work->chunks; });
+    }
+
+    stats = LayerStats();
+    stats.geometry_column = store.columns[column].name;
+    for (const auto& partial : work->partial) {
+        stats.merge(partial);
+    }
+    return true;
+}
+
+struct LayerStatsCache::Probe {
+    std::string key;
+    std::shared_ptr<LeafClient> client;
+    std::string sql_engine;
+    std::string table;
+    std::string geometry_column;
+    size_t sample_rows = 0;
+    std::shared_ptr<ResultStore> store;
+};
+
+LayerStatsCache& LayerStatsCache::instance() {
+    static LayerStatsCache cache;
+    return cache;
+}
+
+std::string LayerStatsCache::make_key(const std::string& endpoint, const std::string& username,
+                                      const std::string& table) {
+    std::string lower = table;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    return endpoint + '\n' + username + '\n' + lower;
+}
+
+bool LayerStatsCache::get(const std::string& key, LayerStats& stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || !it->second.has_stats) {
+        return false;
+    }
+    stats = it->second.stats;
+    return true;
+}
+
+void LayerStatsCache::add(const std::string& key, const LayerStats& stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[key];
+    if (!entry.has_stats) {
+        entry.stats = stats;
+        entry.has_stats = true;
+    } else if (iequals(entry.stats.geometry_column, stats.geometry_column)) {
+        entry.stats.merge(stats);
+    }
+}
+
+void LayerStatsCache::probe(const std::string& key, std::shared_ptr<LeafClient> client, const std::string& sql_engine,
+                            const std::string& table, const std::string& geometry_column, size_t sample_rows) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& entry = entries_[key];
+        if (entry.has_stats || entry.probed) {
+            return;
+        }
+        entry.probing = true;
+        entry.probed = true;
+    }
+    auto probe = std::make_shared<Probe>();
+    probe->key = key;
+    probe->client = std::move(client);
+    probe->sql_engine = sql_engine;
+    probe->table = table;
+    probe->geometry_column = geometry_column;
+    probe->sample_rows = sample_rows;
+    run_probe(std::move(probe), true);
+}
+
+void LayerStatsCache::run_probe(std::shared_ptr<Probe> probe, bool sampled) {
+    std::string sql = "SELECT " + probe->geometry_column + " FROM " + probe->table;
+    if (sampled) {
+        sql += " TABLESAMPLE (" + std::to_string(PROBE_SAMPLE_PERCENT) + " PERCENT)";
+    }
+    sql += " LIMIT " + std::to_string(probe->sample_rows);
+    LEAF_LOG_DEBUG("Probing layer statistics: %s", sql.c_str());
+    Metrics::instance().layer_probes.add();
+    probe->client->execute_query_async(sql, probe->sql_engine, probe->store, RequestPriority::Bulk,
+                                       [this, probe, sampled](bool ok) {
+        LayerStats stats;
+        if (ok && probe->store && compute_layer_stats(*probe->store, stats) && stats.geometries > 0) {
+            add(probe->key, stats);
+            end_probe(probe->key);
+            return;
+        }
+        if (sampled && probe->client->last_status_code() != 401) {
+            // Engines without TABLESAMPLE, or a sample that missed every row
+            probe->store.reset();
+            run_probe(probe, false);
+            return;
+        }
+        LEAF_LOG_WARN("Layer statistics probe of %s failed", probe->table.c_str());
+        end_probe(probe->key);
+    });
+}
+
+void LayerStatsCache::end_probe(const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[key].probing = false;
+    }
+    probe_cv_.notify_all();
+}
+
+void LayerStatsCache::wait_probe(const std::string& key, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    probe_cv_.wait_for(lock, timeout, [&] {
+        auto it = entries_.find(key);
+        return it == entries_.end() || !it->second.probing;
+    });
+}
+
+void LayerStatsCache::observe(const std::string& key, std::shared_ptr<const ResultStore> store) {
+    if (!store || store->spilled || store->row_count == 0) {
+        return;
+    }
+    // Runs while the application fetches the rows; the store is immutable
+    TaskPool::instance().submit([this, key, store] {
+        LayerStats stats;
+        if (compute_layer_stats(*store, stats)) {
+            Metrics::instance().layer_stats_rows.add(stats.rows);
+            add(key, stats);
+        }
+    });
+}
+
+} // namespace leafodbc
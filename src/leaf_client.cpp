@@ -1,20 +1,98 @@
 #include "leafodbc/leaf_client.h"
 #include "leafodbc/common.h"
+#include "leafodbc/metrics.h"
+#include "leafodbc/trace.h"
+#include "leafodbc/reactor.h"
+#include "leafodbc/task_pool.h"
+#include "leafodbc/json_decoder.h"
+#include "leafodbc/geometry.h"
+#include "leafodbc/sql_guard.h"
+#include "leafodbc/tile_cache.h"
 #include <curl/curl.h>
 #include <sstream>
 #include <algorithm>
 #include <iomanip>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
 
 namespace leafodbc {
 
 struct WriteCallbackData {
     std::string* buffer;
+    CURL* curl = nullptr;
+    // SQL_ATTR_MAX_ROWS: rows after which the body is complete enough
+    size_t max_rows = 0;
+    ResponseFormat requested_format = DEFAULT_RESPONSE_FORMAT;
+    std::unique_ptr<RowLimiter> limiter;
+    bool row_limit_reached = false;
+    // MemoryBudgetMB: bytes of a 200 body past which it goes to `spool`
+    size_t spool_above = 0;
+    std::unique_ptr<BodySpool>* spool = nullptr;
 };
 
+// Moves the body received so far to a spool file; error bodies stay in memory
+static bool start_spool(WriteCallbackData* data) {
+    long response_code = 0;
+    curl_easy_getinfo(data->curl, CURLINFO_RESPONSE_CODE, &response_code);
+    data->spool_above = 0;
+    if (response_code != 200) {
+        return true;
+    }
+    std::string error;
+    auto spool = BodySpool::create(error);
+    if (!spool) {
+        LEAF_LOG_WARN("Keeping the response in memory: %s", error.c_str());
+        return true;
+    }
+    LEAF_LOG_DEBUG("Response exceeds half the memory budget, spooling it to disk");
+    if (!spool->append(data->buffer->data(), data->buffer->size())) {
+        return false;
+    }
+    std::string().swap(*data->buffer);
+    *data->spool = std::move(spool);
+    return true;
+}
+
 static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
     WriteCallbackData* data = static_cast<WriteCallbackData*>(userp);
     size_t total_size = size * nmemb;
+    if (data->spool && *data->spool) {
+        if (!(*data->spool)->append(static_cast<char*>(contents), total_size)) {
+            LEAF_LOG_WARN("Cannot write response to disk: %s", std::strerror(errno));
+            return 0;
+        }
+        return total_size;
+    }
     data->buffer->append(static_cast<char*>(contents), total_size);
+    if (data->spool_above > 0 && data->buffer->size() > data->spool_above && !start_spool(data)) {
+        LEAF_LOG_WARN("Cannot write response to disk: %s", std::strerror(errno));
+        return 0;
+    }
+    
+    if (data->max_rows > 0 && !data->limiter) {
+        // Headers are complete by the first body byte; error bodies are kept whole
+        long response_code = 0;
+        char* content_type = nullptr;
+        curl_easy_getinfo(data->curl, CURLINFO_RESPONSE_CODE, &response_code);
+        curl_easy_getinfo(data->curl, CURLINFO_CONTENT_TYPE, &content_type);
+        if (response_code != 200) {
+            data->max_rows = 0;
+            return total_size;
+        }
+        data->limiter = std::make_unique<RowLimiter>(
+            response_format_of(content_type ? content_type : "", data->requested_format), data->max_rows);
+    }
+    if (data->limiter && data->limiter->append(*data->buffer)) {
+        // Stop receiving: curl fails the transfer with CURLE_WRITE_ERROR
+        data->row_limit_reached = true;
+        data->limiter.reset();
+        data->max_rows = 0;
+        return 0;
+    }
     return total_size;
 }
 
@@ -60,60 +138,461 @@ std::string LeafClient::escape_json_string(const std::string& str) const {
     return o.str();
 }
 
-bool LeafClient::http_post(const std::string& url, const std::string& body,
-                          const std::vector<std::string>& headers, std::string& response, int& status_code) {
+void LeafClient::read_timings(void* handle, QueryTimings& timings) {
+    CURL* curl = static_cast<CURL*>(handle);
+    
+    // libcurl reports cumulative times since the start of the transfer
+    curl_off_t namelookup = 0, connect = 0, appconnect = 0, pretransfer = 0;
+    curl_off_t starttransfer = 0, total = 0, downloaded = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    
+    // Reused connections report zero for the phases they skipped
+    connect = std::max(connect, namelookup);
+    curl_off_t handshake_done = appconnect > 0 ? std::max(appconnect, connect) : connect;
+    starttransfer = std::max(starttransfer, std::max(pretransfer, handshake_done));
+    total = std::max(total, starttransfer);
+    
+    timings.name_lookup_us = namelookup;
+    timings.connect_us = connect - namelookup;
+    timings.tls_us = handshake_done - connect;
+    timings.ttfb_us = starttransfer - handshake_done;
+    timings.transfer_us = total - starttransfer;
+    timings.bytes_received = downloaded;
+}
+
+// One HTTP exchange in flight on the reactor
+struct LeafClient::Transfer {
+    CURL* curl = nullptr;
+    struct curl_slist* header_list = nullptr;
+    WriteCallbackData callback_data;
+    HttpAttempt* attempt = nullptr;
+    RequestScheduler::Ticket ticket; // Held until the transfer is finished
+    std::shared_ptr<CancelToken> cancel;
+    std::chrono::steady_clock::time_point start;
+    int64_t trace_start_us = -1;
+    
+    ~Transfer() {
+        curl_slist_free_all(header_list);
+        if (curl) {
+            curl_easy_cleanup(curl);
+        }
+    }
+};
+
+std::unique_ptr<LeafClient::Transfer> LeafClient::start_transfer(const std::string& url, const std::string& body,
+                                                                 const std::vector<std::string>& headers,
+                                                                 RequestScheduler::Ticket ticket,
+                                                                 HttpAttempt& attempt,
+                                                                 std::function<void()> on_done) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->attempt = &attempt;
+    transfer->ticket = std::move(ticket);
+    attempt.timings.queue_wait_us = transfer->ticket.wait_us();
+    
+    // The reactor runs curl_global_init, which must precede the first easy handle
+    Reactor& reactor = Reactor::instance();
     CURL* curl = curl_easy_init();
     if (!curl) {
-        log("Failed to initialize CURL");
-        return false;
+        LEAF_LOG_ERROR("Failed to initialize CURL");
+        attempt.curl_code = CURLE_FAILED_INIT;
+        on_done();
+        return transfer;
     }
+    transfer->curl = curl;
     
-    struct curl_slist* header_list = nullptr;
     for (const auto& header : headers) {
-        header_list = curl_slist_append(header_list, header.c_str());
+        transfer->header_list = curl_slist_append(transfer->header_list, header.c_str());
+    }
+    transfer->callback_data.buffer = &attempt.response;
+    transfer->callback_data.curl = curl;
+    transfer->callback_data.max_rows = decode_options_.max_rows;
+    transfer->callback_data.requested_format = decode_options_.format;
+    // RowLimiter cuts the body in memory, which a row limit keeps small anyway
+    if (decode_options_.max_rows == 0) {
+        transfer->callback_data.spool_above = decode_options_.memory_budget / 2;
+        transfer->callback_data.spool = &attempt.spool;
     }
-    
-    WriteCallbackData callback_data;
-    callback_data.buffer = &response;
     
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
     curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, body.length());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->header_list);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &callback_data);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout_sec_);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer->callback_data);
+    // A statement deadline shrinks the timeout of each attempt
+    int64_t timeout_ms = static_cast<int64_t>(timeout_sec_) * 1000;
+    if (cancel_ && cancel_->remaining_ms() >= 0) {
+        timeout_ms = std::min(timeout_ms, cancel_->remaining_ms());
+    }
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout_ms));
     curl_easy_setopt(curl, CURLOPT_USERAGENT, user_agent_.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    
+    // HTTP/2 over TLS, and wait for an existing connection to the host to
+    // accept another stream instead of opening a new one
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
     
     if (!verify_tls_) {
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
     }
     
-    CURLcode res = curl_easy_perform(curl);
+    if (cancel_) {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, &CancelToken::progress_callback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, cancel_.get());
+        if (!cancel_->attach(curl)) {
+            // Stopped before it was sent; nothing to measure
+            curl_easy_cleanup(curl);
+            transfer->curl = nullptr;
+            attempt.curl_code = CURLE_ABORTED_BY_CALLBACK;
+            on_done();
+            return transfer;
+        }
+        transfer->cancel = cancel_;
+    }
     
-    if (res == CURLE_OK) {
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
-    } else {
-        log("CURL error: " + std::string(curl_easy_strerror(res)));
-        status_code = 0;
+    transfer->start = std::chrono::steady_clock::now();
+    transfer->trace_start_us = trace_enabled() ? trace_now_us() : -1;
+    
+    Transfer* t = transfer.get();
+    reactor.submit(curl, [t, on_done](CURLcode result) {
+        if (t->cancel) {
+            t->cancel->detach(t->curl);
+        }
+        t->attempt->wall_us = elapsed_us(t->start);
+        if (result == CURLE_WRITE_ERROR && t->callback_data.row_limit_reached) {
+            LEAF_LOG_DEBUG("Stopped receiving after %zu rows", t->callback_data.max_rows);
+            result = CURLE_OK;
+        }
+        t->attempt->curl_code = result;
+        on_done();
+    });
+    return transfer;
+}
+
+void LeafClient::finish_transfer(Transfer& transfer) {
+    HttpAttempt& attempt = *transfer.attempt;
+    if (attempt.curl_code == CURLE_ABORTED_BY_CALLBACK) {
+        // Cancelled, timed out or lost a hedge: drop the partial body now
+        std::string().swap(attempt.response);
+        attempt.spool.reset();
+    }
+    if (!transfer.curl) {
+        return;
     }
+    CURL* curl = transfer.curl;
     
-    curl_slist_free_all(header_list);
-    curl_easy_cleanup(curl);
+    read_timings(curl, attempt.timings);
+    const QueryTimings& t = attempt.timings;
     
-    return (res == CURLE_OK);
+    if (transfer.trace_start_us >= 0) {
+        // Phases are contiguous, so lay them out back to back from the request start
+        auto& tracer = Tracer::instance();
+        int64_t ts = transfer.trace_start_us;
+        tracer.record("http_post", "http", ts, attempt.wall_us, "bytes", t.bytes_received);
+        tracer.record("dns", "http", ts, t.name_lookup_us);
+        ts += t.name_lookup_us;
+        tracer.record("connect", "http", ts, t.connect_us);
+        ts += t.connect_us;
+        tracer.record("tls", "http", ts, t.tls_us);
+        ts += t.tls_us;
+        tracer.record("wait_first_byte", "http", ts, t.ttfb_us);
+        ts += t.ttfb_us;
+        tracer.record("transfer", "http", ts, t.transfer_us);
+    }
+    
+    long new_connections = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &new_connections);
+    
+    auto& metrics = Metrics::instance();
+    metrics.http_request_latency.observe_us(attempt.wall_us);
+    metrics.bytes_received.add(static_cast<uint64_t>(t.bytes_received));
+    metrics.http_connections_opened.add(static_cast<uint64_t>(new_connections));
+    
+    if (attempt.curl_code == CURLE_OK) {
+        long response_code = 0; // CURLINFO_RESPONSE_CODE writes a long
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        attempt.status_code = static_cast<int>(response_code);
+        
+        curl_off_t retry_after = 0;
+        if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after) == CURLE_OK && retry_after > 0) {
+            attempt.retry_after_ms = static_cast<int>(std::min<curl_off_t>(retry_after, 3600) * 1000);
+        }
+        
+        char* content_type = nullptr;
+        if (curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type) == CURLE_OK && content_type) {
+            attempt.content_type = content_type;
+        }
+    } else if (attempt.curl_code != CURLE_ABORTED_BY_CALLBACK) {
+        LEAF_LOG_WARN("CURL error: %s", curl_easy_strerror(static_cast<CURLcode>(attempt.curl_code)));
+    }
 }
 
-bool LeafClient::authenticate(const std::string& username, const std::string& password, bool remember_me) {
-    std::string url = build_url("/api/authenticate");
+void LeafClient::perform(const std::string& url, const std::string& body,
+                         const std::vector<std::string>& headers, RequestPriority priority,
+                         HttpAttempt& attempt) {
+    auto ticket = RequestScheduler::instance().acquire(endpoint_base_, scheduler_user_, priority,
+                                                       scheduler_limits_, cancel_.get());
+    
+    std::promise<void> done;
+    std::future<void> completed = done.get_future();
+    auto transfer = start_transfer(url, body, headers, std::move(ticket), attempt,
+                                   [&done] { done.set_value(); });
+    completed.wait();
+    finish_transfer(*transfer);
+}
+
+void LeafClient::perform_hedged(const std::string& url, const std::string& body,
+                                const std::vector<std::string>& headers, RequestPriority priority,
+                                int64_t hedge_delay_us, HttpAttempt& result) {
+    struct HedgeState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        int finished = 0;
+        int winner = -1;
+    } state;
+    HttpAttempt attempts[2];
+    std::unique_ptr<Transfer> transfers[2];
+    
+    auto on_done = [&state, &attempts](int i) {
+        return [&state, &attempts, i] {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.finished++;
+            const HttpAttempt& a = attempts[i];
+            // First usable response wins; a retryable failure waits for the other copy
+            if (state.winner < 0 && a.curl_code == CURLE_OK &&
+                !RequestPolicy::is_retryable(a.status_code, a.curl_code)) {
+                state.winner = i;
+            }
+            state.cv.notify_all();
+        };
+    };
+    
+    auto& scheduler = RequestScheduler::instance();
+    transfers[0] = start_transfer(url, body, headers,
+                                  scheduler.acquire(endpoint_base_, scheduler_user_, priority, scheduler_limits_,
+                                                    cancel_.get()),
+                                  attempts[0], on_done(0));
+    int launched = 1;
+    
+    bool slow = false;
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        slow = !state.cv.wait_for(lock, std::chrono::microseconds(hedge_delay_us),
+                                  [&] { return state.finished > 0; });
+    }
+    
+    if (slow) {
+        // A hedge is optional work, so it never queues behind real requests
+        RequestScheduler::Ticket ticket;
+        if (scheduler.try_acquire(endpoint_base_, scheduler_user_, priority, scheduler_limits_, ticket) &&
+            policy_->try_spend_retry()) {
+            LEAF_LOG_DEBUG("Hedging request after %lld us", static_cast<long long>(hedge_delay_us));
+            Metrics::instance().hedges.add();
+            transfers[1] = start_transfer(url, body, headers, std::move(ticket), attempts[1], on_done(1));
+            launched = 2;
+        }
+    }
+    
+    int loser = -1;
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.cv.wait(lock, [&] { return state.winner >= 0 || state.finished == launched; });
+        if (launched == 2 && state.winner >= 0) {
+            loser = 1 - state.winner;
+        }
+    }
+    if (loser >= 0 && transfers[loser]->curl) {
+        Reactor::instance().cancel(transfers[loser]->curl);
+    }
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.cv.wait(lock, [&] { return state.finished == launched; });
+    }
+    
+    for (int i = 0; i < launched; ++i) {
+        finish_transfer(*transfers[i]);
+    }
+    result = std::move(attempts[state.winner >= 0 ? state.winner : 0]);
+}
+
+bool LeafClient::should_retry(const HttpAttempt& attempt, int retry, int max_retries, int& delay_ms) {
+    if (!RequestPolicy::is_retryable(attempt.status_code, attempt.curl_code) || retry >= max_retries) {
+        return false;
+    }
+    if (cancel_ && cancel_->stop_requested()) {
+        return false;
+    }
+    if (!policy_->try_spend_retry()) {
+        LEAF_LOG_WARN("Retry budget exhausted, not retrying (status %d)", attempt.status_code);
+        Metrics::instance().retry_budget_exhausted.add();
+        return false;
+    }
+    
+    delay_ms = policy_->backoff_ms(retry + 1, attempt.retry_after_ms);
+    if (cancel_ && cancel_->remaining_ms() >= 0 && delay_ms >= cancel_->remaining_ms()) {
+        // The retry could not start before the statement deadline
+        return false;
+    }
+    LEAF_LOG_INFO("Retrying request in %d ms (retry %d of %d, status %d, curl %d)",
+                  delay_ms, retry + 1, max_retries, attempt.status_code, attempt.curl_code);
+    Metrics::instance().retries.add();
+    return true;
+}
+
+void LeafClient::complete_post(HttpAttempt& attempt, int64_t queue_wait_us) {
+    last_status_code_ = attempt.status_code;
+    last_curl_code_ = attempt.curl_code;
+    last_content_type_ = attempt.content_type;
+    body_spool_ = std::move(attempt.spool);
+    timings_ = attempt.timings;
+    timings_.queue_wait_us = queue_wait_us;
+}
+
+bool LeafClient::http_post(const std::string& url, const std::string& body,
+                          const std::vector<std::string>& headers, std::string& response, int& status_code,
+                          bool hedgeable, RequestPriority priority) {
+    int max_retries = 0;
+    bool hedge = false;
+    if (policy_) {
+        policy_->on_request();
+        max_retries = policy_->config().max_retries;
+        hedge = hedgeable && policy_->config().hedge_requests;
+    }
+    
+    int64_t queue_wait_us = 0;
+    for (int retry = 0; ; ++retry) {
+        HttpAttempt attempt;
+        int64_t hedge_delay_us = hedge ? policy_->hedge_delay_us() : -1;
+        if (hedge_delay_us >= 0) {
+            perform_hedged(url, body, headers, priority, hedge_delay_us, attempt);
+        } else {
+            perform(url, body, headers, priority, attempt);
+        }
+        
+        queue_wait_us += attempt.timings.queue_wait_us;
+        if (policy_ && attempt.curl_code == CURLE_OK) {
+            policy_->record_latency(attempt.wall_us);
+        }
+        
+        int delay_ms = 0;
+        if (!should_retry(attempt, retry, max_retries, delay_ms)) {
+            response = std::move(attempt.response);
+            status_code = attempt.status_code;
+            complete_post(attempt, queue_wait_us);
+            return attempt.curl_code == CURLE_OK;
+        }
+        if (cancel_) {
+            // A stop during the backoff makes the next attempt fail right away
+            cancel_->wait_for(std::chrono::milliseconds(delay_ms));
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        }
+    }
+}
+
+// State of one asynchronous POST across its retries
+struct LeafClient::AsyncPost {
+    std::string url;
+    std::string body;
+    std::vector<std::string> headers;
+    RequestPriority priority = RequestPriority::Normal;
+    int max_retries = 0;
+    int retry = 0;
+    int64_t queue_wait_us = 0;
+    HttpAttempt attempt;
+    // Held while `transfer` is assigned: a transfer that fails right away can
+    // finish on another worker before start_transfer has returned
+    std::mutex transfer_mutex;
+    std::unique_ptr<Transfer> transfer;
+    std::function<void(HttpAttempt&)> done;
+};
+
+void LeafClient::http_post_async(std::shared_ptr<AsyncPost> op) {
+    if (policy_) {
+        policy_->on_request();
+        op->max_retries = policy_->config().max_retries;
+    }
+    start_async_attempt(op);
+}
+
+void LeafClient::start_async_attempt(std::shared_ptr<AsyncPost> op) {
+    // No thread waits for admission: while the endpoint is at its limits the
+    // attempt is queued, and the ticket released by another request starts it
+    // on a worker. A worker blocked here could hold up that very release.
+    RequestScheduler::instance().acquire_async(endpoint_base_, scheduler_user_, op->priority, scheduler_limits_,
+                                               cancel_, [this, op](RequestScheduler::Ticket ticket) {
+        op->attempt = HttpAttempt();
+        std::lock_guard<std::mutex> lock(op->transfer_mutex);
+        op->transfer = start_transfer(op->url, op->body, op->headers, std::move(ticket), op->attempt, [this, op] {
+            TaskPool::instance().submit([this, op] { finish_async_attempt(op); });
+        });
+    });
+}
+
+void LeafClient::finish_async_attempt(std::shared_ptr<AsyncPost> op) {
+    {
+        std::lock_guard<std::mutex> lock(op->transfer_mutex);
+        finish_transfer(*op->transfer);
+        op->transfer.reset();
+    }
     
+    HttpAttempt& attempt = op->attempt;
+    op->queue_wait_us += attempt.timings.queue_wait_us;
+    if (policy_ && attempt.curl_code == CURLE_OK) {
+        policy_->record_latency(attempt.wall_us);
+    }
+    
+    int delay_ms = 0;
+    if (should_retry(attempt, op->retry, op->max_retries, delay_ms)) {
+        op->retry++;
+        retry_async_after(op, delay_ms);
+        return;
+    }
+    
+    complete_post(attempt, op->queue_wait_us);
+    op->done(attempt);
+}
+
+void LeafClient::retry_async_after(std::shared_ptr<AsyncPost> op, int delay_ms) {
+    // The backoff waits on a reactor timer instead of a sleeping thread. With
+    // a cancel token it wakes up in short steps so a stop ends it early.
+    auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+    auto step = std::chrono::milliseconds(delay_ms);
+    if (cancel_) {
+        step = std::min(step, std::chrono::milliseconds(100));
+    }
+    Reactor::instance().post_after(step, [this, op, due] {
+        auto now = std::chrono::steady_clock::now();
+        if (now < due && !(cancel_ && cancel_->stop_requested())) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+            retry_async_after(op, static_cast<int>(std::max<int64_t>(1, left)));
+            return;
+        }
+        TaskPool::instance().submit([this, op] { start_async_attempt(op); });
+    });
+}
+
+std::string LeafClient::build_auth_body(const std::string& username, const std::string& password,
+                                        bool remember_me) const {
     nlohmann::json auth_json;
     auth_json["username"] = username;
     auth_json["password"] = password;
     auth_json["rememberMe"] = remember_me;
-    
-    std::string body = auth_json.dump();
+    return auth_json.dump();
+}
+
+bool LeafClient::authenticate(const std::string& username, const std::string& password, bool remember_me) {
+    std::string url = build_url("/api/authenticate");
+    std::string body = build_auth_body(username, password, remember_me);
     std::vector<std::string> headers = {
         "Content-Type: application/json"
     };
@@ -121,17 +600,41 @@ bool LeafClient::authenticate(const std::string& username, const std::string& pa
     std::string response;
     int status_code = 0;
     
-    if (should_log()) {
-        log("Authenticating to " + url);
-    }
+    LEAF_LOG_INFO("Authenticating to %s", url.c_str());
+    Metrics::instance().auth_calls.add();
     
-    if (!http_post(url, body, headers, response, status_code)) {
-        log("Authentication HTTP request failed");
+    // Sessions gate every query behind them, so they jump the queue
+    bool sent = http_post(url, body, headers, response, status_code, false, RequestPriority::Interactive);
+    return handle_auth_response(sent, status_code, response);
+}
+
+void LeafClient::authenticate_async(const std::string& username, const std::string& password, bool remember_me,
+                                    std::function<void(bool ok)> done) {
+    auto op = std::make_shared<AsyncPost>();
+    op->url = build_url("/api/authenticate");
+    op->body = build_auth_body(username, password, remember_me);
+    op->headers = {"Content-Type: application/json"};
+    op->priority = RequestPriority::Interactive;
+    op->done = [this, done](HttpAttempt& attempt) {
+        done(handle_auth_response(attempt.curl_code == CURLE_OK, attempt.status_code, attempt.response));
+    };
+    
+    LEAF_LOG_INFO("Authenticating to %s in the background", op->url.c_str());
+    Metrics::instance().auth_calls.add();
+    http_post_async(op);
+}
+
+bool LeafClient::handle_auth_response(bool sent, int status_code, const std::string& response) {
+    auto& metrics = Metrics::instance();
+    if (!sent) {
+        LEAF_LOG_WARN("Authentication HTTP request failed");
+        metrics.auth_failures.add();
         return false;
     }
     
     if (status_code != 200) {
-        log("Authentication failed with status " + std::to_string(status_code) + ": " + response);
+        LEAF_LOG_WARN("Authentication failed with status %d: %.200s", status_code, response.c_str());
+        metrics.auth_failures.add();
         return false;
     }
     
@@ -139,78 +642,471 @@ bool LeafClient::authenticate(const std::string& username, const std::string& pa
         nlohmann::json result = nlohmann::json::parse(response);
         if (result.contains("id_token")) {
             auth_token_ = result["id_token"].get<std::string>();
-            if (should_log()) {
-                log("Authentication successful, token obtained");
-            }
+            LEAF_LOG_INFO("Authentication successful, token obtained");
             return true;
         } else {
-            log("Authentication response missing id_token");
+            LEAF_LOG_WARN("Authentication response missing id_token");
+            metrics.auth_failures.add();
             return false;
         }
     } catch (const std::exception& e) {
-        log("Failed to parse authentication response: " + std::string(e.what()));
+        LEAF_LOG_WARN("Failed to parse authentication response: %s", e.what());
+        metrics.auth_failures.add();
         return false;
     }
 }
 
+std::string LeafClient::build_query_url(const std::string& sql_engine) const {
+    return build_url("/services/pointlake/api/v2/query") + "?sqlEngine=" + sql_engine;
+}
+
+std::vector<std::string> LeafClient::build_query_headers() const {
+    return {
+        "Authorization: Bearer " + auth_token_,
+        "Content-Type: text/plain",
+        accept_header(decode_options_.format)
+    };
+}
+
+struct LeafClient::TiledQuery {
+    struct Tile {
+        TileId id;
+        std::string key;
+        std::shared_ptr<const ResultStore> store;  // Cached, or fetched once done
+        std::shared_ptr<LeafClient> client;        // Set while the tile is fetched
+        std::shared_ptr<ResultStore> fetched;
+        bool ok = false;
+    };
+    
+    std::string sql;
+    std::string sql_engine;
+    RequestPriority priority = RequestPriority::Normal;
+    EnvelopeFilter filter;
+    std::string query_key; // Endpoint, user, engine and the SQL without its envelope
+    TileId first;
+    TileId last;
+    std::vector<Tile> tiles;
+    std::atomic<size_t> pending{0};
+    
+    std::shared_ptr<ResultStore>* result = nullptr;
+    std::function<void(bool ok)> done;
+    
+    // The statement with the envelope of `bounds`
+    std::string sql_for(const Bounds& bounds) const {
+        char envelope[128];
+        std::snprintf(envelope, sizeof(envelope), "%.17g, %.17g, %.17g, %.17g",
+                      bounds.min_x, bounds.min_y, bounds.max_x, bounds.max_y);
+        return sql.substr(0, filter.args_begin) + envelope + sql.substr(filter.args_end);
+    }
+};
+
 bool LeafClient::execute_query(const std::string& sql, const std::string& sql_engine,
-                               nlohmann::json& result) {
+                               std::shared_ptr<ResultStore>& result, RequestPriority priority) {
     if (auth_token_.empty()) {
-        log("Not authenticated");
+        LEAF_LOG_WARN("Not authenticated");
         return false;
     }
     
-    std::string url = build_url("/services/pointlake/api/v2/query");
-    url += "?sqlEngine=" + sql_engine;
-    
-    std::vector<std::string> headers = {
-        "Authorization: Bearer " + auth_token_,
-        "Content-Type: text/plain"
-    };
+    if (tile_cache_sec_ > 0) {
+        if (auto query = make_tiled_query(sql, sql_engine, priority)) {
+            std::promise<bool> finished;
+            auto future = finished.get_future();
+            query->result = &result;
+            query->done = [&finished](bool ok) { finished.set_value(ok); };
+            execute_tiled(std::move(query), false);
+            return future.get();
+        }
+    }
     
+    std::string url = build_query_url(sql_engine);
+    std::vector<std::string> headers = build_query_headers();
+
     std::string response;
     int status_code = 0;
     
-    if (should_log()) {
-        log("Executing query: " + sql.substr(0, std::min(sql.length(), size_t(100))) + "...");
+    LEAF_LOG_DEBUG("Executing query: %.100s...", sql.c_str());
+    
+    Metrics::instance().queries.add();
+    
+    timings_.clear();
+    // Queries are read-only, so duplicating one for hedging is safe
+    bool sent = http_post(url, sql, headers, response, status_code, true, priority);
+    return handle_query_response(sent, status_code, response, result);
+}
+
+void LeafClient::execute_query_async(const std::string& sql, const std::string& sql_engine,
+                                     std::shared_ptr<ResultStore>& result, RequestPriority priority,
+                                     std::function<void(bool ok)> done) {
+    if (auth_token_.empty()) {
+        LEAF_LOG_WARN("Not authenticated");
+        TaskPool::instance().submit([done] { done(false); });
+        return;
+    }
+    
+    if (tile_cache_sec_ > 0) {
+        if (auto query = make_tiled_query(sql, sql_engine, priority)) {
+            query->result = &result;
+            query->done = std::move(done);
+            execute_tiled(std::move(query), true);
+            return;
+        }
+    }
+    
+    auto op = std::make_shared<AsyncPost>();
+    op->url = build_query_url(sql_engine);
+    op->body = sql;
+    op->headers = build_query_headers();
+    op->priority = priority;
+    op->done = [this, &result, done](HttpAttempt& attempt) {
+        bool sent = attempt.curl_code == CURLE_OK;
+        done(handle_query_response(sent, attempt.status_code, attempt.response, result));
+    };
+    
+    LEAF_LOG_DEBUG("Executing query asynchronously: %.100s...", sql.c_str());
+    
+    Metrics::instance().queries.add();
+    
+    timings_.clear();
+    http_post_async(op);
+}
+
+std::shared_ptr<LeafClient::TiledQuery> LeafClient::make_tiled_query(const std::string& sql,
+                                                                     const std::string& sql_engine,
+                                                                     RequestPriority priority) const {
+    auto query = std::make_shared<TiledQuery>();
+    if (!SQLGuard::find_envelope_filter(sql, query->filter)) {
+        return nullptr;
+    }
+    const EnvelopeFilter& filter = query->filter;
+    if (!TileCache::cover(Bounds{filter.min_x, filter.min_y, filter.max_x, filter.max_y}, query->first, query->last)) {
+        return nullptr;
+    }
+    query->sql = sql;
+    query->sql_engine = sql_engine;
+    query->priority = priority;
+    query->query_key = endpoint_base_ + '\n' + scheduler_user_ + '\n' + sql_engine + '\n' +
+                       sql.substr(0, filter.args_begin) + '?' + sql.substr(filter.args_end);
+    return query;
+}
+
+std::shared_ptr<LeafClient> LeafClient::make_tile_client() const {
+    auto client = std::make_shared<LeafClient>(*this);
+    client->tile_cache_sec_ = 0;
+    // Tiles are cached whole; the merged result gets the statement's limits
+    client->decode_options_.lazy = false;
+    client->decode_options_.memory_budget = 0;
+    client->decode_options_.max_rows = 0;
+    client->decode_options_.simplify_tolerance = 0;
+    return client;
+}
+
+void LeafClient::execute_tiled(std::shared_ptr<TiledQuery> query, bool async) {
+    LEAF_LOG_DEBUG("Executing extent query at zoom %d, tiles %lld..%lld x %lld..%lld: %.100s...",
+                   query->first.zoom, static_cast<long long>(query->first.x), static_cast<long long>(query->last.x),
+                   static_cast<long long>(query->first.y), static_cast<long long>(query->last.y), query->sql.c_str());
+    timings_.clear();
+    auto& cache = TileCache::instance();
+    for (int64_t y = query->first.y; y <= query->last.y; y++) {
+        for (int64_t x = query->first.x; x <= query->last.x; x++) {
+            TiledQuery::Tile tile;
+            tile.id = TileId{query->first.zoom, x, y};
+            tile.key = TileCache::tile_key(query->query_key, tile.id);
+            tile.store = cache.get(tile.key, tile_cache_sec_);
+            if (!tile.store) {
+                tile.client = make_tile_client();
+            }
+            query->tiles.push_back(std::move(tile));
+        }
     }
     
-    if (!http_post(url, sql, headers, response, status_code)) {
-        log("Query HTTP request failed");
+    size_t missing = 0;
+    for (const auto& tile : query->tiles) {
+        missing += tile.client ? 1 : 0;
+    }
+    if (missing == 0) {
+        if (async) {
+            TaskPool::instance().submit([this, query] { finish_tiled(query); });
+        } else {
+            finish_tiled(query);
+        }
+        return;
+    }
+    // Missing tiles are fetched concurrently; the last one to finish merges
+    query->pending.store(missing);
+    for (auto& tile : query->tiles) {
+        if (!tile.client) {
+            continue;
+        }
+        TiledQuery::Tile* fetching = &tile;
+        tile.client->execute_query_async(query->sql_for(TileCache::tile_bounds(tile.id)), query->sql_engine,
+                                         tile.fetched, query->priority, [this, query, fetching](bool ok) {
+            fetching->ok = ok;
+            if (query->pending.fetch_sub(1) == 1) {
+                finish_tiled(query);
+            }
+        });
+    }
+}
+
+void LeafClient::finish_tiled(std::shared_ptr<TiledQuery> query) {
+    auto& cache = TileCache::instance();
+    bool failed = false;
+    for (auto& tile : query->tiles) {
+        if (!tile.client) {
+            continue;
+        }
+        const QueryTimings& tile_timings = tile.client->last_timings();
+        timings_.queue_wait_us = std::max(timings_.queue_wait_us, tile_timings.queue_wait_us);
+        timings_.name_lookup_us = std::max(timings_.name_lookup_us, tile_timings.name_lookup_us);
+        timings_.connect_us = std::max(timings_.connect_us, tile_timings.connect_us);
+        timings_.tls_us = std::max(timings_.tls_us, tile_timings.tls_us);
+        timings_.ttfb_us = std::max(timings_.ttfb_us, tile_timings.ttfb_us);
+        timings_.transfer_us = std::max(timings_.transfer_us, tile_timings.transfer_us);
+        timings_.decode_us = std::max(timings_.decode_us, tile_timings.decode_us);
+        timings_.schema_us = std::max(timings_.schema_us, tile_timings.schema_us);
+        timings_.bytes_received += tile_timings.bytes_received;
+        if (!tile.ok) {
+            // Reported like the failure of a single request, so a 401 leads to reauthentication
+            if (!failed) {
+                last_status_code_ = tile.client->last_status_code();
+                last_curl_code_ = tile.client->last_curl_code();
+            }
+            failed = true;
+            continue;
+        }
+        // Kept even if another tile failed, for the retry
+        tile.store = tile.fetched;
+        cache.put(tile.key, tile.store);
+    }
+    if (failed) {
+        query->done(false);
+        return;
+    }
+    
+    auto merge_start = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<const ResultStore>> stores;
+    for (const auto& tile : query->tiles) {
+        stores.push_back(tile.store);
+    }
+    const EnvelopeFilter& filter = query->filter;
+    const auto& arena_pool = decode_options_.arena_pool;
+    std::shared_ptr<ResultStore> merged;
+    {
+        LEAF_TRACE_SCOPE("merge_tiles", "decode");
+        merged = merge_tiles(stores, filter.column, Bounds{filter.min_x, filter.min_y, filter.max_x, filter.max_y},
+                             arena_pool ? arena_pool->acquire() : std::make_shared<Arena>());
+    }
+    if (!merged) {
+        // Rows without their geometry cannot be matched to the extent. The
+        // statement goes out as is, on a copy of this client without the tile
+        // cache: through this one it would be tiled, and merged, again.
+        LEAF_LOG_DEBUG("Extent query does not select %s, sending it as is", filter.column.c_str());
+        auto direct = std::make_shared<LeafClient>(*this);
+        direct->tile_cache_sec_ = 0;
+        direct->execute_query_async(query->sql, query->sql_engine, *query->result, query->priority,
+                                    [this, direct, query](bool ok) {
+            last_status_code_ = direct->last_status_code_;
+            last_curl_code_ = direct->last_curl_code_;
+            last_content_type_ = direct->last_content_type_;
+            timings_ = direct->timings_;
+            query->done(ok);
+        });
+        return;
+    }
+    timings_.schema_us += elapsed_us(merge_start);
+    last_status_code_ = 200;
+    last_curl_code_ = CURLE_OK;
+    apply_result_limits(*merged);
+    *query->result = std::move(merged);
+    if (tile_prefetch_) {
+        prefetch_tiles(*query);
+    }
+    query->done(true);
+}
+
+void LeafClient::prefetch_tiles(const TiledQuery& query) {
+    // The ring of tiles around the extent, where panning goes next
+    int64_t tiles = int64_t{1} << query.first.zoom;
+    auto& cache = TileCache::instance();
+    for (int64_t y = std::max<int64_t>(0, query.first.y - 1); y <= std::min(tiles - 1, query.last.y + 1); y++) {
+        for (int64_t x = std::max<int64_t>(0, query.first.x - 1); x <= std::min(tiles - 1, query.last.x + 1); x++) {
+            if (x >= query.first.x && x <= query.last.x && y >= query.first.y && y <= query.last.y) {
+                continue;
+            }
+            TileId id{query.first.zoom, x, y};
+            std::string key = TileCache::tile_key(query.query_key, id);
+            if (!cache.begin_prefetch(key)) {
+                continue;
+            }
+            struct Prefetch {
+                std::shared_ptr<LeafClient> client;
+                std::shared_ptr<ResultStore> store;
+                std::string key;
+            };
+            auto prefetch = std::make_shared<Prefetch>();
+            prefetch->client = make_tile_client();
+            prefetch->client->cancel_.reset(); // Outlives the statement
+            prefetch->key = std::move(key);
+            prefetch->client->execute_query_async(query.sql_for(TileCache::tile_bounds(id)), query.sql_engine,
+                                                  prefetch->store, RequestPriority::Bulk, [prefetch](bool ok) {
+                auto& tile_cache = TileCache::instance();
+                if (ok) {
+                    tile_cache.put(prefetch->key, prefetch->store);
+                    Metrics::instance().tiles_prefetched.add();
+                }
+                tile_cache.end_prefetch(prefetch->key);
+            });
+        }
+    }
+}
+
+bool LeafClient::handle_query_response(bool sent, int status_code, std::string& response,
+                                       std::shared_ptr<ResultStore>& result) {
+    auto& metrics = Metrics::instance();
+    // Taken right away, so that a spooled body never outlives its response
+    std::shared_ptr<BodySpool> spool = std::move(body_spool_);
+    
+    if (!sent) {
+        LEAF_LOG_WARN("Query HTTP request failed");
+        metrics.query_errors.add();
         return false;
     }
     
     if (status_code == 401) {
-        log("Query returned 401 (unauthorized), token may be expired");
+        LEAF_LOG_INFO("Query returned 401 (unauthorized), token may be expired");
+        metrics.query_errors.add();
         return false;
     }
     
     if (status_code != 200) {
-        log("Query failed with status " + std::to_string(status_code) + ": " + response);
+        LEAF_LOG_WARN("Query failed with status %d: %.200s", status_code, response.c_str());
+        metrics.query_errors.add();
         return false;
     }
     
-    try {
-        result = nlohmann::json::parse(response);
-        
-        // Handle two response formats:
-        // A) Array: [{"colA": 1, ...}, ...]
-        // B) Object with "rows": {"rows": [{"colA": 1, ...}, ...]}
-        if (result.is_array()) {
-            // Already in correct format
-        } else if (result.is_object() && result.contains("rows")) {
-            if (result["rows"].is_array()) {
-                result = result["rows"];
-            } else if (result["rows"].is_object() && result["rows"].contains("rows")) {
-                result = result["rows"]["rows"];
-            }
+    // Rows are decoded straight into arena-backed cells, without a JSON DOM.
+    // JSON responses come in two shapes:
+    // A) Array: [{"colA": 1, ...}, ...]
+    // B) Object with "rows": {"rows": [{"colA": 1, ...}, ...]}
+    // The server may also answer in NDJSON or CSV if asked to.
+    ResponseFormat format = response_format_of(last_content_type_, decode_options_.format);
+    auto decoder = make_response_decoder(format, decode_options_);
+    std::string_view spooled;
+    if (spool) {
+        std::string error;
+        spooled = spool->map(error);
+        if (!error.empty()) {
+            LEAF_LOG_WARN("Failed to read spooled query response: %s", error.c_str());
+            metrics.query_errors.add();
+            return false;
         }
-        
-        return true;
-    } catch (const std::exception& e) {
-        log("Failed to parse query response: " + std::string(e.what()));
+    }
+    const auto& arena_pool = decode_options_.arena_pool;
+    auto arena = arena_pool ? arena_pool->acquire() : std::make_shared<Arena>();
+    size_t budget = decode_options_.memory_budget;
+    // LazyDecode keeps the whole body in memory, so not one over the budget
+    bool fits = !spool && (budget == 0 || response.size() <= budget);
+    if (decode_options_.lazy && decode_options_.simplify_tolerance <= 0 && fits) {
+        // Cells are decoded when first read, so this is all the decode work up front
+        auto index_start = std::chrono::steady_clock::now();
+        {
+            LEAF_TRACE_SCOPE("json_index", "decode");
+            result = decoder->index(response, arena);
+        }
+        if (result) {
+            timings_.decode_us = elapsed_us(index_start);
+            apply_result_limits(*result);
+            return true;
+        }
+    }
+    
+    ResultStoreBuilder builder(std::move(arena));
+    if (budget > 0) {
+        // Rows past the budget are spilled while decoding; their geometries
+        // are simplified on the way, as apply_result_limits does in memory
+        std::function<void(ResultStore&)> simplify;
+        if (decode_options_.simplify_tolerance > 0) {
+            double tolerance = decode_options_.simplify_tolerance;
+            simplify = [tolerance](ResultStore& segment) {
+                size_t removed = simplify_geometries(segment, tolerance);
+                if (removed > 0) {
+                    Metrics::instance().simplified_vertices.add(removed);
+                }
+            };
+        }
+        builder.set_memory_budget(budget, std::move(simplify));
+    }
+    std::string error;
+    auto decode_start = std::chrono::steady_clock::now();
+    bool decoded;
+    {
+        LEAF_TRACE_SCOPE("json_parse", "decode");
+        decoded = spool ? decoder->decode_mapped(spooled, builder, error) : decoder->decode(response, builder, error);
+    }
+    timings_.decode_us = elapsed_us(decode_start);
+    if (!decoded) {
+        LEAF_LOG_WARN("Failed to parse query response: %s", error.c_str());
+        metrics.query_errors.add();
         return false;
     }
+    std::string().swap(response);
+    spool.reset();
+    
+    auto schema_start = std::chrono::steady_clock::now();
+    {
+        LEAF_TRACE_SCOPE("load_resultset", "decode");
+        result = builder.finish();
+    }
+    timings_.schema_us = elapsed_us(schema_start);
+    if (!builder.spill_error().empty()) {
+        LEAF_LOG_WARN("Failed to spill query result: %s", builder.spill_error().c_str());
+        metrics.query_errors.add();
+        result.reset();
+        return false;
+    }
+    if (result->spilled) {
+        LEAF_LOG_INFO("Result exceeded the memory budget of %zu while decoding, spilled %zu bytes to disk",
+                      budget, result->spilled->file_size());
+        metrics.result_spills.add();
+        metrics.spilled_bytes.add(result->spilled->file_size());
+    }
+    apply_result_limits(*result);
+    return true;
+}
+
+void LeafClient::apply_result_limits(ResultStore& store) {
+    // Servers that ignore the LIMIT added for SQL_ATTR_MAX_ROWS may still send more
+    if (decode_options_.max_rows > 0 && store.row_count > decode_options_.max_rows) {
+        store.row_count = decode_options_.max_rows;
+    }
+    
+    if (decode_options_.simplify_tolerance > 0) {
+        LEAF_TRACE_SCOPE("simplify", "decode");
+        size_t removed = simplify_geometries(store, decode_options_.simplify_tolerance);
+        if (removed > 0) {
+            LEAF_LOG_DEBUG("Simplification removed %zu geometry vertices", removed);
+            Metrics::instance().simplified_vertices.add(removed);
+        }
+    }
+    
+    size_t budget = decode_options_.memory_budget;
+    size_t in_memory = store.memory_bytes();
+    if (budget == 0 || in_memory <= budget) {
+        return;
+    }
+    LEAF_TRACE_SCOPE("spill", "decode");
+    std::string error;
+    if (!store.spill(error)) {
+        // Still correct, just not within budget
+        LEAF_LOG_WARN("Result of %zu bytes exceeds the memory budget but could not be spilled: %s",
+                      in_memory, error.c_str());
+        return;
+    }
+    LEAF_LOG_INFO("Result of %zu bytes exceeded the memory budget of %zu, spilled %zu bytes to disk",
+                  in_memory, budget, store.spilled->file_size());
+    auto& metrics = Metrics::instance();
+    metrics.result_spills.add();
+    metrics.spilled_bytes.add(store.spilled->file_size());
 }
 
 } // namespace leafodbc
@@ -0,0 +1,147 @@
+#include "leafodbc/logger.h"
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <algorithm>
+
+namespace leafodbc {
+
+std::atomic<int> g_log_level{-1};
+
+namespace {
+
+int parse_level(const char* value) {
+    if (!value || !*value) {
+        return static_cast<int>(LogLevel::Off);
+    }
+    std::string v(value);
+    std::transform(v.begin(), v.end(), v.begin(), ::tolower);
+    if (v == "1" || v == "debug" || v == "true") return static_cast<int>(LogLevel::Debug);
+    if (v == "info") return static_cast<int>(LogLevel::Info);
+    if (v == "warn" || v == "warning") return static_cast<int>(LogLevel::Warn);
+    if (v == "error") return static_cast<int>(LogLevel::Error);
+    return static_cast<int>(LogLevel::Off);
+}
+
+const char* level_name(LogLevel level) {
+    switch (level) {
+        case LogLevel::Error: return "ERROR";
+        case LogLevel::Warn: return "WARN";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Debug: return "DEBUG";
+        default: return "";
+    }
+}
+
+} // namespace
+
+uint64_t current_thread_number() {
+    static std::atomic<uint64_t> next{1};
+    thread_local uint64_t number = next.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+
+int init_log_level() {
+    int level = Logger::instance().configured_level_;
+    g_log_level.store(level, std::memory_order_relaxed);
+    return level;
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() {
+    configured_level_ = parse_level(std::getenv("LEAFODBC_LOG"));
+    if (configured_level_ == static_cast<int>(LogLevel::Off)) {
+        return;
+    }
+
+    sink_ = stderr;
+    const char* path = std::getenv("LEAFODBC_LOG_FILE");
+    if (path && *path) {
+        FILE* f = std::fopen(path, "a");
+        if (f) {
+            sink_ = f;
+            owns_sink_ = true;
+        }
+    }
+
+    drain_thread_ = std::thread(&Logger::drain_loop, this);
+}
+
+Logger::~Logger() {
+    // Later callers (other static destructors) see logging as disabled
+    g_log_level.store(static_cast<int>(LogLevel::Off), std::memory_order_relaxed);
+
+    if (drain_thread_.joinable()) {
+        stopping_.store(true, std::memory_order_release);
+        drain_thread_.join();
+    }
+    if (owns_sink_) {
+        std::fclose(sink_);
+    }
+}
+
+void Logger::write(LogLevel level, const char* fmt, ...) {
+    if (configured_level_ == static_cast<int>(LogLevel::Off)) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    bool pushed = ring_.try_push([&](Message& message) {
+        message.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        message.thread_id = current_thread_number();
+        message.level = level;
+        int n = std::vsnprintf(message.text, TEXT_SIZE, fmt, args);
+        message.length = n < 0 ? 0 : static_cast<uint32_t>(std::min<size_t>(n, TEXT_SIZE - 1));
+    });
+    va_end(args);
+    if (!pushed) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool Logger::drain_once() {
+    bool drained = ring_.drain([this](const Message& message) { emit(message); }) > 0;
+
+    uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        std::fprintf(sink_, "[LeafODBC] WARN %llu log messages dropped (buffer full)\n",
+                     static_cast<unsigned long long>(dropped));
+    }
+    if (drained || dropped > 0) {
+        std::fflush(sink_);
+    }
+    return drained;
+}
+
+void Logger::emit(const Message& message) {
+    std::time_t seconds = static_cast<std::time_t>(message.timestamp_us / 1000000);
+    std::tm tm_utc;
+    gmtime_r(&seconds, &tm_utc);
+    char time_buf[32];
+    std::strftime(time_buf, sizeof(time_buf), "%Y-%m-%dT%H:%M:%S", &tm_utc);
+    std::fprintf(sink_, "[LeafODBC] %s.%06lldZ %s [t%llu] %.*s\n",
+                 time_buf, static_cast<long long>(message.timestamp_us % 1000000),
+                 level_name(message.level), static_cast<unsigned long long>(message.thread_id),
+                 static_cast<int>(message.length), message.text);
+}
+
+void Logger::drain_loop() {
+    while (!stopping_.load(std::memory_order_acquire)) {
+        if (!drain_once()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    drain_once();
+}
+
+} // namespace leafodbc
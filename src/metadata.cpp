@@ -28,7 +28,8 @@ SQLINTEGER Metadata::infer_geometry_type(const std::string& wkt) {
         return 0; // ST_Geometry generic
     }
     
-    std::string upper_wkt = wkt;
+    // The type is the first word; no need to copy the coordinates
+    std::string upper_wkt = wkt.substr(0, 24);
     std::transform(upper_wkt.begin(), upper_wkt.end(), upper_wkt.begin(), ::toupper);
     
     if (upper_wkt.find("POINT") == 0) {
@@ -46,6 +47,8 @@ SQLINTEGER Metadata::infer_geometry_type(const std::string& wkt) {
             return 11; // ST_MultiPolygon
         }
         return 5; // ST_Polygon
+    } else if (upper_wkt.find("GEOMETRYCOLLECTION") == 0) {
+        return 6; // ST_GeomCollection
     }
     
     return 0; // ST_Geometry generic
@@ -127,6 +130,21 @@ std::unique_ptr<ResultSet> Metadata::get_tables(
         result->add_row(row);
     }
     
+    // Add "LAYER_STATISTICS" table
+    if (matches_pattern("leaf", catalog_pattern) &&
+        (schema_pattern.empty() || schema_pattern == "%" || matches_pattern("public", schema_pattern) || matches_pattern("leaf", schema_pattern)) &&
+        matches_pattern("LAYER_STATISTICS", table_pattern) &&
+        (type_pattern.empty() || type_pattern == "%" || type_pattern == "TABLE")) {
+        
+        nlohmann::json row;
+        row["TABLE_CAT"] = "leaf";
+        row["TABLE_SCHEM"] = "public";
+        row["TABLE_NAME"] = "LAYER_STATISTICS";
+        row["TABLE_TYPE"] = "TABLE";
+        row["REMARKS"] = "";
+        result->add_row(row);
+    }
+    
     return result;
 }
 
@@ -313,10 +331,40 @@ std::unique_ptr<ResultSet> Metadata::get_columns(
         }
     }
     
+    // Handle "LAYER_STATISTICS" table
+    if (is_layer_statistics_table(table_pattern)) {
+        auto stats_result = get_layer_statistics(nullptr);
+        for (const auto& col_def : stats_result->get_columns()) {
+            if (matches_pattern(col_def.name, column_pattern)) {
+                nlohmann::json row;
+                row["TABLE_CAT"] = "leaf";
+                row["TABLE_SCHEM"] = "public";
+                row["TABLE_NAME"] = "LAYER_STATISTICS";
+                row["COLUMN_NAME"] = col_def.name;
+                row["DATA_TYPE"] = col_def.sql_type;
+                row["TYPE_NAME"] = col_def.type_name;
+                row["COLUMN_SIZE"] = col_def.column_size;
+                row["BUFFER_LENGTH"] = col_def.column_size;
+                row["DECIMAL_DIGITS"] = 0;
+                row["NUM_PREC_RADIX"] = 10;
+                row["NULLABLE"] = SQL_NULLABLE;
+                row["REMARKS"] = "";
+                result->add_row(row);
+            }
+        }
+    }
+    
     return result;
 }
 
-std::unique_ptr<ResultSet> Metadata::get_geometry_columns() {
+const std::vector<SpatialTable>& Metadata::spatial_tables() {
+    static const std::vector<SpatialTable> tables = {
+        {"leaf", "pointlake", "points", "geometry"},
+    };
+    return tables;
+}
+
+std::unique_ptr<ResultSet> Metadata::get_geometry_columns(const LayerStatsLookup& lookup) {
     auto result = std::make_unique<ResultSet>();
     
     // Define columns
@@ -364,15 +412,86 @@ std::unique_ptr<ResultSet> Metadata::get_geometry_columns() {
     
     result->get_columns() = {col_catalog, col_schema, col_table, col_geom_col, col_geom_type, col_srid};
     
-    // Add row for "points" table
-    nlohmann::json row;
-    row["F_TABLE_CATALOG"] = "leaf";
-    row["F_TABLE_SCHEMA"] = "pointlake";
-    row["F_TABLE_NAME"] = "points";
-    row["F_GEOMETRY_COLUMN"] = "geometry";
-    row["GEOMETRY_TYPE"] = 0; // ST_Geometry generic (can be inferred from WKT later)
-    row["SRID"] = 4326; // Default assumption (WGS84)
-    result->add_row(row);
+    for (const auto& table : spatial_tables()) {
+        LayerStats stats;
+        bool has_stats = lookup && lookup(table, stats);
+        nlohmann::json row;
+        row["F_TABLE_CATALOG"] = table.catalog;
+        row["F_TABLE_SCHEMA"] = table.schema;
+        row["F_TABLE_NAME"] = table.table;
+        row["F_GEOMETRY_COLUMN"] = table.geometry_column;
+        // ST_Geometry generic and WGS84 unless the layer statistics tell otherwise
+        row["GEOMETRY_TYPE"] = has_stats ? stats.geometry_type() : 0;
+        row["SRID"] = has_stats ? stats.srid() : 4326;
+        result->add_row(row);
+    }
+    
+    return result;
+}
+
+std::unique_ptr<ResultSet> Metadata::get_layer_statistics(const LayerStatsLookup& lookup) {
+    auto result = std::make_unique<ResultSet>();
+    
+    struct StatsColumn {
+        const char* name;
+        SQLSMALLINT sql_type;
+        const char* type_name;
+        SQLULEN column_size;
+    };
+    
+    StatsColumn stats_columns[] = {
+        {"F_TABLE_CATALOG", SQL_VARCHAR, "VARCHAR", 128},
+        {"F_TABLE_SCHEMA", SQL_VARCHAR, "VARCHAR", 128},
+        {"F_TABLE_NAME", SQL_VARCHAR, "VARCHAR", 128},
+        {"F_GEOMETRY_COLUMN", SQL_VARCHAR, "VARCHAR", 128},
+        {"GEOMETRY_TYPE", SQL_INTEGER, "INTEGER", 0},
+        {"SRID", SQL_INTEGER, "INTEGER", 0},
+        {"MIN_X", SQL_DOUBLE, "DOUBLE", 15},
+        {"MIN_Y", SQL_DOUBLE, "DOUBLE", 15},
+        {"MAX_X", SQL_DOUBLE, "DOUBLE", 15},
+        {"MAX_Y", SQL_DOUBLE, "DOUBLE", 15},
+        {"ROWS_SEEN", SQL_BIGINT, "BIGINT", 19},
+        {"GEOMETRIES_SEEN", SQL_BIGINT, "BIGINT", 19},
+        {"AVG_VERTICES", SQL_DOUBLE, "DOUBLE", 15},
+        {"MAX_VERTICES", SQL_BIGINT, "BIGINT", 19}
+    };
+    
+    for (const auto& col_def : stats_columns) {
+        ColumnInfo col;
+        col.name = col_def.name;
+        col.sql_type = col_def.sql_type;
+        col.column_size = col_def.column_size;
+        col.decimal_digits = 0;
+        col.nullable = SQL_NULLABLE;
+        col.type_name = col_def.type_name;
+        result->get_columns().push_back(col);
+    }
+    
+    for (const auto& table : spatial_tables()) {
+        nlohmann::json row;
+        row["F_TABLE_CATALOG"] = table.catalog;
+        row["F_TABLE_SCHEMA"] = table.schema;
+        row["F_TABLE_NAME"] = table.table;
+        row["F_GEOMETRY_COLUMN"] = table.geometry_column;
+        LayerStats stats;
+        if (lookup && lookup(table, stats)) {
+            row["GEOMETRY_TYPE"] = stats.geometry_type();
+            row["SRID"] = stats.srid();
+            if (stats.has_extent) {
+                row["MIN_X"] = stats.extent.min_x;
+                row["MIN_Y"] = stats.extent.min_y;
+                row["MAX_X"] = stats.extent.max_x;
+                row["MAX_Y"] = stats.extent.max_y;
+            }
+            row["ROWS_SEEN"] = stats.rows;
+            row["GEOMETRIES_SEEN"] = stats.geometries;
+            if (stats.geometries > 0) {
+                row["AVG_VERTICES"] = static_cast<double>(stats.vertices) / stats.geometries;
+            }
+            row["MAX_VERTICES"] = stats.max_vertices;
+        }
+        result->add_row(row);
+    }
     
     return result;
 }
@@ -385,4 +504,10 @@ bool Metadata::is_geometry_columns_table(const std::string& catalog,
     return upper_table == "GEOMETRY_COLUMNS";
 }
 
+bool Metadata::is_layer_statistics_table(const std::string& table) {
+    std::string upper_table = table;
+    std::transform(upper_table.begin(), upper_table.end(), upper_table.begin(), ::toupper);
+    return upper_table == "LAYER_STATISTICS";
+}
+
 } // namespace leafodbc
@@ -0,0 +1,169 @@
+#include "leafodbc/metrics.h"
+#include "leafodbc/common.h"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <chrono>
+
+namespace leafodbc {
+
+const std::array<uint64_t, Histogram::BUCKET_COUNT> Histogram::BOUNDS_US = {
+    1000, 5000, 10000, 25000, 50000, 100000, 250000,
+    500000, 1000000, 2500000, 5000000, 10000000, 30000000, 60000000
+};
+
+void Histogram::observe_us(int64_t us) {
+    uint64_t v = us > 0 ? static_cast<uint64_t>(us) : 0;
+    size_t i = 0;
+    while (i < BUCKET_COUNT && v > BOUNDS_US[i]) {
+        ++i;
+    }
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(v, std::memory_order_relaxed);
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics() {
+    const char* path = std::getenv("LEAFODBC_METRICS_FILE");
+    if (!path || !*path) {
+        return;
+    }
+    dump_path_ = path;
+
+    const char* interval = std::getenv("LEAFODBC_METRICS_INTERVAL_SEC");
+    if (interval) {
+        int sec = std::atoi(interval);
+        if (sec > 0) dump_interval_sec_ = sec;
+    }
+
+    dump_thread_ = std::thread(&Metrics::dump_loop, this);
+}
+
+Metrics::~Metrics() {
+    if (dump_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(dump_mutex_);
+            stopping_ = true;
+        }
+        dump_cv_.notify_all();
+        dump_thread_.join();
+    }
+}
+
+void Metrics::dump_loop() {
+    std::unique_lock<std::mutex> lock(dump_mutex_);
+    while (true) {
+        write_file();
+        if (dump_cv_.wait_for(lock, std::chrono::seconds(dump_interval_sec_),
+                              [this] { return stopping_; })) {
+            break;
+        }
+    }
+    // Final snapshot so short-lived processes leave their totals behind
+    write_file();
+}
+
+bool Metrics::write_file() const {
+    // Write to a temporary file and rename so scrapers never see a partial dump
+    std::string tmp_path = dump_path_ + ".tmp";
+    FILE* f = std::fopen(tmp_path.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    std::string text = render();
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmp_path.c_str(), dump_path_.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+void render_counter(std::ostringstream& out, const char* name, const char* help, const Counter& c) {
+    out << "# TYPE " << name << " counter\n";
+    out << "# HELP " << name << " " << help << "\n";
+    out << name << "_total " << c.value() << "\n";
+}
+
+void render_gauge(std::ostringstream& out, const char* name, const char* help, const Gauge& g) {
+    out << "# TYPE " << name << " gauge\n";
+    out << "# HELP " << name << " " << help << "\n";
+    out << name << " " << g.value() << "\n";
+}
+
+void render_histogram(std::ostringstream& out, const char* name, const char* help, const Histogram& h) {
+    out << "# TYPE " << name << " histogram\n";
+    out << "# HELP " << name << " " << help << "\n";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+        cumulative += h.bucket(i);
+        out << name << "_bucket{le=\"" << (Histogram::BOUNDS_US[i] / 1e6) << "\"} " << cumulative << "\n";
+    }
+    cumulative += h.bucket(Histogram::BUCKET_COUNT);
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum " << (h.sum_us() / 1e6) << "\n";
+    out << name << "_count " << cumulative << "\n";
+}
+
+} // namespace
+
+std::string Metrics::render() const {
+    std::ostringstream out;
+    render_counter(out, "leafodbc_queries", "Queries sent to PointLake.", queries);
+    render_counter(out, "leafodbc_query_errors", "Queries that failed.", query_errors);
+    render_counter(out, "leafodbc_bytes_received", "Response bytes received.", bytes_received);
+    render_counter(out, "leafodbc_auth_calls", "Authentication requests.", auth_calls);
+    render_counter(out, "leafodbc_auth_failures", "Failed authentication requests.", auth_failures);
+    render_counter(out, "leafodbc_retries", "Requests retried after a failure.", retries);
+    render_counter(out, "leafodbc_hedges", "Duplicate requests sent to cut tail latency.", hedges);
+    render_counter(out, "leafodbc_retry_budget_exhausted", "Retries skipped because the budget was spent.",
+                   retry_budget_exhausted);
+    render_counter(out, "leafodbc_cache_hits", "Requests answered from a driver cache.", cache_hits);
+    render_counter(out, "leafodbc_cache_misses", "Cacheable requests sent to the server.", cache_misses);
+    render_counter(out, "leafodbc_http_connections_opened", "New connections opened to the Leaf API.",
+                   http_connections_opened);
+    render_counter(out, "leafodbc_statements_cancelled", "Statements stopped by SQLCancel.", statements_cancelled);
+    render_counter(out, "leafodbc_statement_timeouts", "Statements that exceeded their query timeout.",
+                   statement_timeouts);
+    render_counter(out, "leafodbc_coalesced_queries", "Queries that shared an identical in-flight request.",
+                   coalesced_queries);
+    render_counter(out, "leafodbc_result_spills", "Results moved to disk after exceeding their memory budget.",
+                   result_spills);
+    render_counter(out, "leafodbc_spilled_bytes", "Bytes of results written to spill files.", spilled_bytes);
+    render_counter(out, "leafodbc_batched_statements", "Statements executed as part of a multi-statement batch.",
+                   batched_statements);
+    render_counter(out, "leafodbc_sessions_reused", "Connections that took over a pooled session instead of authenticating.",
+                   sessions_reused);
+    render_counter(out, "leafodbc_simplified_vertices", "Geometry vertices removed by SimplifyTolerance.",
+                   simplified_vertices);
+    render_counter(out, "leafodbc_tile_hits", "Tiles of extent queries served from the tile cache.", tile_hits);
+    render_counter(out, "leafodbc_tile_misses", "Tiles of extent queries fetched from the server.", tile_misses);
+    render_counter(out, "leafodbc_tiles_prefetched", "Neighboring tiles fetched ahead of panning.", tiles_prefetched);
+    render_counter(out, "leafodbc_layer_probes", "Sample queries sent to compute layer statistics.", layer_probes);
+    render_counter(out, "leafodbc_layer_stats_rows", "Result rows added to layer statistics.", layer_stats_rows);
+    render_gauge(out, "leafodbc_open_env_handles", "Allocated environment handles.", open_env_handles);
+    render_gauge(out, "leafodbc_open_conn_handles", "Allocated connection handles.", open_conn_handles);
+    render_gauge(out, "leafodbc_open_stmt_handles", "Allocated statement handles.", open_stmt_handles);
+    render_gauge(out, "leafodbc_pooled_sessions", "Authenticated sessions idle in the session pool.", pooled_sessions);
+    render_gauge(out, "leafodbc_tile_cache_bytes", "Memory held by tiles in the tile cache.", tile_cache_bytes);
+    render_gauge(out, "leafodbc_scheduler_queue_depth", "Requests waiting for admission by the scheduler.",
+                 scheduler_queue_depth);
+    render_histogram(out, "leafodbc_http_request_duration_seconds",
+                     "Wall time of HTTP requests to the Leaf API.", http_request_latency);
+    render_histogram(out, "leafodbc_statement_duration_seconds",
+                     "Wall time of successful statement executions.", statement_latency);
+    render_histogram(out, "leafodbc_scheduler_wait_seconds",
+                     "Time requests waited for admission by the scheduler.", scheduler_wait);
+    out << "# EOF\n";
+    return out.str();
+}
+
+} // namespace leafodbc
@@ -5,18 +5,502 @@
 #include "leafodbc/metadata.h"
 #include "leafodbc/sql_guard.h"
 #include "leafodbc/common.h"
+#include "leafodbc/metrics.h"
+#include "leafodbc/trace.h"
+#include "leafodbc/exec_job.h"
+#include "leafodbc/cancel.h"
+#include "leafodbc/arrow_export.h"
+#include "leafodbc/session_pool.h"
+#include "leafodbc/layer_stats.h"
 #include <sql.h>
 #include <sqlext.h>
 #include <cstring>
 #include <memory>
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <chrono>
 #include <nlohmann/json.hpp>
 
+namespace {
+
+// SQLFetch/SQLGetData are traced as batches of rows rather than per call
+constexpr int64_t FETCH_TRACE_BATCH_ROWS = 1024;
+
+void apply_connection_params(leafodbc::ConnHandle* conn, const leafodbc::ConnectionParams& params) {
+    conn->endpoint_base = params.endpoint_base;
+    conn->username = params.username;
+    conn->password = params.password;
+    conn->remember_me = params.remember_me;
+    conn->sql_engine = params.sql_engine;
+    conn->timeout_sec = params.timeout_sec;
+    conn->verify_tls = params.verify_tls;
+    conn->user_agent = params.user_agent;
+    
+    leafodbc::RequestPolicyConfig policy;
+    policy.max_retries = params.max_retries;
+    policy.backoff_base_ms = params.retry_backoff_ms;
+    policy.backoff_max_ms = std::max(params.retry_backoff_max_ms, params.retry_backoff_ms);
+    policy.hedge_requests = params.hedge_requests;
+    policy.hedge_percentile = params.hedge_percentile;
+    policy.retry_budget_percent = params.retry_budget_percent;
+    conn->request_policy = std::make_shared<leafodbc::RequestPolicy>(policy);
+    
+    conn->scheduler_limits.rate_limit_per_sec = params.rate_limit_per_sec;
+    conn->scheduler_limits.rate_limit_burst = params.rate_limit_burst;
+    conn->scheduler_limits.max_inflight_per_endpoint = params.max_inflight_per_endpoint;
+    conn->scheduler_limits.max_inflight_per_user = params.max_inflight_per_user;
+    conn->default_priority = params.priority;
+    conn->coalesce_queries = params.coalesce_queries;
+    conn->json_parser = params.json_parser;
+    conn->decode_threads = params.decode_threads;
+    conn->lazy_decode = params.lazy_decode;
+    conn->response_format = params.response_format;
+    conn->memory_budget_mb = params.memory_budget_mb;
+    conn->session_pool_idle_sec = params.session_pool_idle_sec;
+    conn->lazy_connect = params.lazy_connect;
+    conn->simplify_tolerance = params.simplify_tolerance;
+    conn->tile_cache_sec = params.tile_cache_sec;
+    conn->tile_prefetch = params.tile_prefetch;
+    conn->layer_stats_sample = params.layer_stats_sample;
+}
+
+// Takes over a pooled session for the connection's settings, or authenticates
+bool open_session(leafodbc::ConnHandle* conn) {
+    std::string pool_key = leafodbc::SessionPool::make_key(*conn);
+    leafodbc::PooledSession session;
+    if (conn->session_pool_idle_sec > 0 &&
+        leafodbc::SessionPool::instance().acquire(pool_key, conn->password, session)) {
+        LEAF_LOG_DEBUG("Reusing pooled session for %s", conn->username.c_str());
+        conn->auth_token = std::move(session.auth_token);
+        conn->token_obtained_at = session.token_obtained_at;
+        conn->arena_pool = std::move(session.arena_pool);
+        conn->token_valid = true;
+        return true;
+    }
+    
+    // Authenticate
+    auto client = std::make_shared<leafodbc::LeafClient>(
+        conn->endpoint_base, conn->user_agent, conn->timeout_sec, conn->verify_tls);
+    client->set_request_policy(conn->request_policy);
+    client->set_scheduling(conn->username, conn->scheduler_limits);
+    
+    // LazyConnect: only check what can be checked locally and let the request
+    // (which also warms up DNS, TCP and TLS for the endpoint) run meanwhile
+    if (conn->lazy_connect) {
+        if (conn->endpoint_base.empty() || conn->username.empty()) {
+            conn->diag.add("08001", 0, "Client unable to establish connection: endpoint or user missing");
+            return false;
+        }
+        auto pending = std::make_shared<leafodbc::PendingConnect>();
+        pending->client = client;
+        conn->pending_connect = pending;
+        leafodbc::LeafClient* raw_client = client.get();
+        client->authenticate_async(conn->username, conn->password, conn->remember_me, [pending, raw_client](bool ok) {
+            {
+                std::lock_guard<std::mutex> lock(pending->mutex);
+                pending->ok = ok;
+                pending->auth_token = raw_client->get_token();
+                pending->token_obtained_at = std::chrono::system_clock::now();
+                pending->done = true;
+            }
+            pending->done_cv.notify_all();
+        });
+        return true;
+    }
+    
+    if (!client->authenticate(conn->username, conn->password, conn->remember_me)) {
+        conn->diag.add("28000", 0, "Authentication failed");
+        return false;
+    }
+    
+    conn->auth_token = client->get_token();
+    conn->token_valid = true;
+    conn->token_obtained_at = std::chrono::system_clock::now();
+    return true;
+}
+
+// Starts the sample probes of the layer statistics of the spatial tables
+// (LayerStatsSample), each once per endpoint and user; the caller holds
+// conn->mutex
+void probe_layer_stats(leafodbc::ConnHandle* conn) {
+    if (conn->layer_stats_sample <= 0 || conn->auth_token.empty()) {
+        return;
+    }
+    auto client = std::make_shared<leafodbc::LeafClient>(
+        conn->endpoint_base, conn->user_agent, conn->timeout_sec, conn->verify_tls);
+    client->set_token(conn->auth_token);
+    leafodbc::DecodeOptions decode_options;
+    decode_options.parser = conn->json_parser;
+    decode_options.threads = conn->decode_threads;
+    decode_options.format = conn->response_format;
+    client->set_decode_options(decode_options);
+    client->set_request_policy(conn->request_policy);
+    client->set_scheduling(conn->username, conn->scheduler_limits);
+    for (const auto& table : leafodbc::Metadata::spatial_tables()) {
+        std::string name = std::string(table.catalog) + '.' + table.schema + '.' + table.table;
+        // Keyed by the bare name, like the results of queries on the table
+        leafodbc::LayerStatsCache::instance().probe(
+            leafodbc::LayerStatsCache::make_key(conn->endpoint_base, conn->username, table.table), client,
+            conn->sql_engine, name, table.geometry_column, static_cast<size_t>(conn->layer_stats_sample));
+    }
+}
+
+// Moves the outcome of a finished LazyConnect authentication onto the
+// connection, unless another call already did; the caller holds conn->mutex.
+// Returns false if the authentication failed.
+bool finish_pending_connect(leafodbc::ConnHandle* conn, std::shared_ptr<leafodbc::PendingConnect> pending) {
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    if (conn->pending_connect == pending) {
+        conn->pending_connect.reset();
+        if (pending->ok) {
+            conn->auth_token = pending->auth_token;
+            conn->token_obtained_at = pending->token_obtained_at;
+            conn->token_valid = true;
+            probe_layer_stats(conn);
+        }
+    }
+    return pending->ok;
+}
+
+// Called before a remote query: waits for a LazyConnect authentication
+// still running. Returns false if it failed.
+bool await_pending_connect(leafodbc::ConnHandle* conn) {
+    std::shared_ptr<leafodbc::PendingConnect> pending;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        pending = conn->pending_connect;
+    }
+    if (!pending) {
+        return true;
+    }
+    {
+        LEAF_TRACE_SCOPE("connect_wait", "http");
+        pending->wait();
+    }
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    return finish_pending_connect(conn, pending);
+}
+
+void flush_fetch_trace(leafodbc::StmtHandle* stmt) {
+    if (stmt->fetch_trace_start_us >= 0) {
+        leafodbc::Tracer::instance().record("fetch_batch", "fetch", stmt->fetch_trace_start_us,
+                                            leafodbc::trace_now_us() - stmt->fetch_trace_start_us,
+                                            "rows", stmt->fetch_trace_rows);
+    }
+    stmt->fetch_trace_start_us = -1;
+    stmt->fetch_trace_rows = 0;
+}
+
+
+// While an asynchronous execution is pending, only polling it and reading
+// diagnostics are allowed on the statement
+bool async_pending(leafodbc::StmtHandle* stmt) {
+    if (!stmt->async_exec) {
+        return false;
+    }
+    stmt->diag.add("HY010", 0, "Function sequence error");
+    return true;
+}
+
+// Moves the outcome of a finished job onto the statement and its connection
+SQLRETURN apply_exec_job(leafodbc::StmtHandle* stmt, leafodbc::ExecJob& job) {
+    for (const auto& rec : job.diags) {
+        stmt->diag.add(rec.sqlstate, rec.native_error, rec.message);
+    }
+    
+    if (!job.new_token.empty()) {
+        auto* conn = leafodbc::HandleRegistry::instance().get_conn(stmt->conn_handle);
+        if (conn) {
+            conn->auth_token = job.new_token;
+            conn->token_obtained_at = std::chrono::system_clock::now();
+        }
+    }
+    
+    if (job.ret == SQL_ERROR) {
+        return SQL_ERROR;
+    }
+    
+    stmt->timings = job.timings;
+    stmt->resultset = std::move(job.resultset);
+    stmt->executed = true;
+    stmt->current_row = 0;
+    
+    if (stmt->timing_diag) {
+        stmt->diag.add("01000", 0, stmt->timings.summary());
+        return SQL_SUCCESS_WITH_INFO;
+    }
+    
+    return SQL_SUCCESS;
+}
+
+// Returns SQL_STILL_EXECUTING until the pending execution is done, then its outcome
+SQLRETURN poll_async_exec(leafodbc::StmtHandle* stmt, SQLUSMALLINT function_id) {
+    if (stmt->async_exec->function_id != function_id) {
+        stmt->diag.add("HY010", 0, "Function sequence error");
+        return SQL_ERROR;
+    }
+    if (!stmt->async_exec->done.load(std::memory_order_acquire)) {
+        return SQL_STILL_EXECUTING;
+    }
+    
+    auto finished = std::move(stmt->async_exec);
+    stmt->diag.clear();
+    return apply_exec_job(stmt, finished->job);
+}
+
+// Drops the batch results not yet read, stopping those still running; the
+// caller holds stmt->mutex
+void discard_batch(leafodbc::StmtHandle* stmt) {
+    for (const auto& op : stmt->batch_results) {
+        if (!op->done.load(std::memory_order_acquire) && op->job.cancel) {
+            op->job.cancel->cancel();
+        }
+    }
+    stmt->batch_results.clear();
+}
+
+// Queries of the GEOMETRY_COLUMNS table are answered locally. The table is
+// matched by the one FROM table, so a name in a literal, a comment or a
+// column does not count.
+bool is_geometry_columns_query(const std::string& sql) {
+    std::string table = leafodbc::SQLGuard::source_table(sql);
+    return !table.empty() && leafodbc::Metadata::is_geometry_columns_table("", "", table);
+}
+
+// So are queries of the LAYER_STATISTICS table
+bool is_layer_statistics_query(const std::string& sql) {
+    std::string table = leafodbc::SQLGuard::source_table(sql);
+    return !table.empty() && leafodbc::Metadata::is_layer_statistics_table(table);
+}
+
+bool is_local_query(const std::string& sql) {
+    return is_geometry_columns_query(sql) || is_layer_statistics_query(sql);
+}
+
+// Answers a query of GEOMETRY_COLUMNS or LAYER_STATISTICS. With
+// LayerStatsSample, waits briefly for sample probes still running.
+std::unique_ptr<leafodbc::ResultSet> local_query_result(leafodbc::StmtHandle* stmt, const std::string& sql) {
+    auto* conn = stmt->conn_handle ? leafodbc::HandleRegistry::instance().get_conn(stmt->conn_handle) : nullptr;
+    leafodbc::Metadata::LayerStatsLookup lookup;
+    if (conn && conn->layer_stats_sample > 0 && await_pending_connect(conn)) {
+        std::string endpoint_base;
+        std::string username;
+        int timeout_sec = 0;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            endpoint_base = conn->endpoint_base;
+            username = conn->username;
+            timeout_sec = conn->timeout_sec;
+        }
+        auto& cache = leafodbc::LayerStatsCache::instance();
+        // A GIS client lists the layers before it reads them, so it gets
+        // generic types rather than waiting out a slow probe
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::min<std::chrono::milliseconds>(std::chrono::seconds(timeout_sec),
+                                                            std::chrono::milliseconds(leafodbc::LAYER_STATS_WAIT_MS));
+        {
+            LEAF_TRACE_SCOPE("layer_stats_wait", "http");
+            for (const auto& table : leafodbc::Metadata::spatial_tables()) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0) {
+                    break;
+                }
+                cache.wait_probe(leafodbc::LayerStatsCache::make_key(endpoint_base, username, table.table), left);
+            }
+        }
+        lookup = [endpoint_base, username](const leafodbc::SpatialTable& table, leafodbc::LayerStats& stats) {
+            return leafodbc::LayerStatsCache::instance().get(
+                leafodbc::LayerStatsCache::make_key(endpoint_base, username, table.table), stats);
+        };
+    }
+    if (is_layer_statistics_query(sql)) {
+        return leafodbc::Metadata::get_layer_statistics(lookup);
+    }
+    return leafodbc::Metadata::get_geometry_columns(lookup);
+}
+
+// Sets up `job` to run `sql` for the statement with a client of its own
+void prepare_job(leafodbc::ExecJob& job, leafodbc::StmtHandle* stmt, leafodbc::ConnHandle* conn,
+                 const std::string& sql, const std::shared_ptr<leafodbc::CancelToken>& cancel,
+                 std::chrono::steady_clock::time_point exec_start) {
+    // SQL_ATTR_QUERY_TIMEOUT overrides the connection timeout
+    int query_timeout = static_cast<int>(stmt->query_timeout);
+    
+    // Execute query via LeafClient (transient failures are retried by its request policy)
+    auto client = std::make_shared<leafodbc::LeafClient>(
+        conn->endpoint_base, conn->user_agent, query_timeout > 0 ? query_timeout : conn->timeout_sec,
+        conn->verify_tls);
+    client->set_token(conn->auth_token);
+    client->set_cancel_token(cancel);
+    leafodbc::DecodeOptions decode_options;
+    decode_options.parser = conn->json_parser;
+    decode_options.threads = conn->decode_threads;
+    decode_options.arena_pool = conn->arena_pool;
+    decode_options.lazy = conn->lazy_decode;
+    decode_options.format = conn->response_format;
+    decode_options.memory_budget = static_cast<size_t>(stmt->memory_budget_mb) * 1024 * 1024;
+    decode_options.max_rows = static_cast<size_t>(stmt->max_rows);
+    decode_options.simplify_tolerance = stmt->simplify_tolerance;
+    client->set_decode_options(decode_options);
+    client->set_request_policy(conn->request_policy);
+    client->set_scheduling(conn->username, conn->scheduler_limits);
+    client->set_tile_cache(conn->tile_cache_sec, conn->tile_prefetch);
+    
+    job.client = client;
+    job.endpoint = conn->endpoint_base;
+    // SQL_ATTR_MAX_ROWS is pushed to the server as a LIMIT
+    job.sql = stmt->max_rows > 0 ? leafodbc::SQLGuard::apply_row_limit(sql, stmt->max_rows) : sql;
+    job.sql_engine = conn->sql_engine;
+    job.username = conn->username;
+    job.password = conn->password;
+    job.remember_me = conn->remember_me;
+    job.priority = static_cast<leafodbc::RequestPriority>(stmt->priority);
+    job.start = exec_start;
+    job.cancel = cancel;
+    job.coalesce = conn->coalesce_queries;
+    job.simplify_tolerance = stmt->simplify_tolerance;
+    if (conn->layer_stats_sample > 0) {
+        std::string table = leafodbc::SQLGuard::source_table(sql);
+        if (!table.empty()) {
+            job.layer_stats_key = leafodbc::LayerStatsCache::make_key(conn->endpoint_base, conn->username, table);
+        }
+    }
+}
+
+// Sends every statement of a batch at once. The first result is returned like
+// that of a single statement; the others wait in stmt->batch_results.
+SQLRETURN execute_batch(leafodbc::StmtHandle* stmt, leafodbc::ConnHandle* conn,
+                        const std::vector<std::string>& statements,
+                        const std::shared_ptr<leafodbc::CancelToken>& cancel,
+                        std::chrono::steady_clock::time_point exec_start, SQLUSMALLINT function_id) {
+    std::vector<std::shared_ptr<leafodbc::AsyncExec>> ops;
+    for (const auto& statement : statements) {
+        auto op = std::make_shared<leafodbc::AsyncExec>();
+        op->function_id = function_id;
+        if (is_local_query(statement)) {
+            op->job.resultset = local_query_result(stmt, statement);
+            op->done.store(true, std::memory_order_release);
+        } else {
+            prepare_job(op->job, stmt, conn, statement, cancel, exec_start);
+        }
+        ops.push_back(std::move(op));
+    }
+    LEAF_LOG_INFO("Executing a batch of %zu statements", ops.size());
+    leafodbc::Metrics::instance().batched_statements.add(ops.size());
+    
+    auto first = ops.front();
+    stmt->batch_results.assign(ops.begin() + 1, ops.end());
+    bool pending = stmt->async_enable && !first->done.load(std::memory_order_acquire);
+    if (pending) {
+        first->callback = stmt->async_callback;
+        first->context = stmt->async_context;
+        stmt->async_exec = first;
+    }
+    for (const auto& op : ops) {
+        if (!op->done.load(std::memory_order_acquire)) {
+            leafodbc::AsyncExec::start(op);
+        }
+    }
+    if (pending) {
+        return SQL_STILL_EXECUTING;
+    }
+    
+    first->wait();
+    return apply_exec_job(stmt, first->job);
+}
+
+// Shared by SQLExecDirect and SQLExecute; the caller holds stmt->mutex
+SQLRETURN execute_statement(leafodbc::StmtHandle* stmt, const std::string& sql, SQLUSMALLINT function_id) {
+    if (stmt->async_exec) {
+        return poll_async_exec(stmt, function_id);
+    }
+    
+    stmt->diag.clear();
+    stmt->sql_text = sql;
+    stmt->executed = false;
+    stmt->resultset.reset();
+    stmt->current_row = 0;
+    stmt->timings.clear();
+    discard_batch(stmt);
+    flush_fetch_trace(stmt);
+    auto exec_start = std::chrono::steady_clock::now();
+    
+    // Semicolon-separated SELECTs run as a batch (SQLMoreResults)
+    std::vector<std::string> statements = leafodbc::SQLGuard::split_statements(sql);
+    bool batch = statements.size() > 1;
+    
+    // Handle GEOMETRY_COLUMNS and LAYER_STATISTICS queries (answered locally, so never asynchronous)
+    if (!batch && is_local_query(sql)) {
+        stmt->resultset = local_query_result(stmt, sql);
+        stmt->executed = true;
+        return SQL_SUCCESS;
+    }
+    
+    // Check if allowed (SELECT only); nothing of a batch is sent unless all of it is
+    if (!batch && !leafodbc::SQLGuard::is_allowed(sql)) {
+        stmt->diag.add("42000", 0, "Only SELECT statements are allowed");
+        return SQL_ERROR;
+    }
+    for (size_t i = 0; batch && i < statements.size(); i++) {
+        if (!is_local_query(statements[i]) && !leafodbc::SQLGuard::is_allowed(statements[i])) {
+            stmt->diag.add("42000", 0, "Only SELECT statements are allowed (statement " +
+                           std::to_string(i + 1) + " of the batch)");
+            return SQL_ERROR;
+        }
+    }
+    
+    // Get connection handle from statement
+    if (!stmt->conn_handle) {
+        stmt->diag.add("08003", 0, "Connection does not exist");
+        return SQL_ERROR;
+    }
+    
+    auto* conn = leafodbc::HandleRegistry::instance().get_conn(stmt->conn_handle);
+    if (conn && !await_pending_connect(conn)) {
+        stmt->diag.add("28000", 0, "Authentication failed");
+        return SQL_ERROR;
+    }
+    if (!conn || !conn->is_connected()) {
+        stmt->diag.add("08003", 0, "Connection not established");
+        return SQL_ERROR;
+    }
+    
+    // SQL_ATTR_QUERY_TIMEOUT also bounds retries, and a batch as a whole
+    auto cancel = std::make_shared<leafodbc::CancelToken>(static_cast<int>(stmt->query_timeout));
+    {
+        std::lock_guard<std::mutex> lock(stmt->cancel_mutex);
+        stmt->cancel_token = cancel;
+    }
+    
+    if (batch) {
+        return execute_batch(stmt, conn, statements, cancel, exec_start, function_id);
+    }
+    
+    if (stmt->async_enable) {
+        auto op = std::make_shared<leafodbc::AsyncExec>();
+        op->function_id = function_id;
+        prepare_job(op->job, stmt, conn, sql, cancel, exec_start);
+        op->callback = stmt->async_callback;
+        op->context = stmt->async_context;
+        stmt->async_exec = op;
+        leafodbc::AsyncExec::start(op);
+        return SQL_STILL_EXECUTING;
+    }
+    
+    leafodbc::ExecJob job;
+    prepare_job(job, stmt, conn, sql, cancel, exec_start);
+    job.run();
+    return apply_exec_job(stmt, job);
+}
+
+} // namespace
+
 extern "C" {
 
 // SQLAllocHandle
 SQLRETURN SQLAllocHandle(SQLSMALLINT handle_type, SQLHANDLE input_handle, SQLHANDLE* output_handle) {
+    LEAF_TRACE_SCOPE("SQLAllocHandle", "odbc");
     if (!output_handle) {
         return SQL_ERROR;
     }
@@ -44,6 +528,7 @@ SQLRETURN SQLAllocHandle(SQLSMALLINT handle_type, SQLHANDLE input_handle, SQLHAN
 
 // SQLFreeHandle
 SQLRETURN SQLFreeHandle(SQLSMALLINT handle_type, SQLHANDLE handle) {
+    LEAF_TRACE_SCOPE("SQLFreeHandle", "odbc");
     auto& registry = leafodbc::HandleRegistry::instance();
     
     switch (handle_type) {
@@ -53,8 +538,17 @@ SQLRETURN SQLFreeHandle(SQLSMALLINT handle_type, SQLHANDLE handle) {
         case SQL_HANDLE_DBC:
             return registry.free_connect(reinterpret_cast<SQLHDBC>(handle));
         
-        case SQL_HANDLE_STMT:
+        case SQL_HANDLE_STMT: {
+            auto* stmt = registry.get_stmt(reinterpret_cast<SQLHSTMT>(handle));
+            if (stmt) {
+                std::lock_guard<std::mutex> lock(stmt->mutex);
+                if (async_pending(stmt)) {
+                    return SQL_ERROR;
+                }
+                discard_batch(stmt);
+            }
             return registry.free_stmt(reinterpret_cast<SQLHSTMT>(handle));
+        }
         
         default:
             return SQL_ERROR;
@@ -63,6 +557,7 @@ SQLRETURN SQLFreeHandle(SQLSMALLINT handle_type, SQLHANDLE handle) {
 
 // SQLSetEnvAttr
 SQLRETURN SQLSetEnvAttr(SQLHENV environment_handle, SQLINTEGER attribute, SQLPOINTER value_ptr, SQLINTEGER string_length) {
+    LEAF_TRACE_SCOPE("SQLSetEnvAttr", "odbc");
     auto* env = leafodbc::HandleRegistry::instance().get_env(environment_handle);
     if (!env) {
         return SQL_INVALID_HANDLE;
@@ -85,6 +580,7 @@ SQLRETURN SQLSetEnvAttr(SQLHENV environment_handle, SQLINTEGER attribute, SQLPOI
 
 // SQLGetEnvAttr
 SQLRETURN SQLGetEnvAttr(SQLHENV environment_handle, SQLINTEGER attribute, SQLPOINTER value_ptr, SQLINTEGER buffer_length, SQLINTEGER* string_length_ptr) {
+    LEAF_TRACE_SCOPE("SQLGetEnvAttr", "odbc");
     auto* env = leafodbc::HandleRegistry::instance().get_env(environment_handle);
     if (!env) {
         return SQL_INVALID_HANDLE;
@@ -109,6 +605,7 @@ SQLRETURN SQLGetEnvAttr(SQLHENV environment_handle, SQLINTEGER attribute, SQLPOI
 SQLRETURN SQLConnect(SQLHDBC connection_handle, SQLCHAR* dsn, SQLSMALLINT dsn_length,
                      SQLCHAR* uid, SQLSMALLINT uid_length,
                      SQLCHAR* pwd, SQLSMALLINT pwd_length) {
+    LEAF_TRACE_SCOPE("SQLConnect", "odbc");
     auto* conn = leafodbc::HandleRegistry::instance().get_conn(connection_handle);
     if (!conn) {
         return SQL_INVALID_HANDLE;
@@ -156,27 +653,12 @@ SQLRETURN SQLConnect(SQLHDBC connection_handle, SQLCHAR* dsn, SQLSMALLINT dsn_le
     }
     
     // Apply to connection handle
-    conn->endpoint_base = dsn_params.endpoint_base;
-    conn->username = dsn_params.username;
-    conn->password = dsn_params.password;
-    conn->remember_me = dsn_params.remember_me;
-    conn->sql_engine = dsn_params.sql_engine;
-    conn->timeout_sec = dsn_params.timeout_sec;
-    conn->verify_tls = dsn_params.verify_tls;
-    conn->user_agent = dsn_params.user_agent;
-    
-    // Authenticate
-    auto client = std::make_unique<leafodbc::LeafClient>(
-        conn->endpoint_base, conn->user_agent, conn->timeout_sec, conn->verify_tls);
+    apply_connection_params(conn, dsn_params);
     
-    if (!client->authenticate(conn->username, conn->password, conn->remember_me)) {
-        conn->diag.add("28000", 0, "Authentication failed");
+    if (!open_session(conn)) {
         return SQL_ERROR;
     }
-    
-    conn->auth_token = client->get_token();
-    conn->token_valid = true;
-    conn->token_obtained_at = std::chrono::system_clock::now();
+    probe_layer_stats(conn);
     
     return SQL_SUCCESS;
 }
@@ -186,6 +668,7 @@ SQLRETURN SQLDriverConnect(SQLHDBC connection_handle, SQLHWND window_handle,
                           SQLCHAR* in_connection_string, SQLSMALLINT string_length1,
                           SQLCHAR* out_connection_string, SQLSMALLINT buffer_length,
                           SQLSMALLINT* string_length2_ptr, SQLUSMALLINT driver_completion) {
+    LEAF_TRACE_SCOPE("SQLDriverConnect", "odbc");
     auto* conn = leafodbc::HandleRegistry::instance().get_conn(connection_handle);
     if (!conn) {
         return SQL_INVALID_HANDLE;
@@ -223,27 +706,12 @@ SQLRETURN SQLDriverConnect(SQLHDBC connection_handle, SQLHWND window_handle,
     }
     
     // Apply to connection handle
-    conn->endpoint_base = conn_params.endpoint_base;
-    conn->username = conn_params.username;
-    conn->password = conn_params.password;
-    conn->remember_me = conn_params.remember_me;
-    conn->sql_engine = conn_params.sql_engine;
-    conn->timeout_sec = conn_params.timeout_sec;
-    conn->verify_tls = conn_params.verify_tls;
-    conn->user_agent = conn_params.user_agent;
+    apply_connection_params(conn, conn_params);
     
-    // Authenticate
-    auto client = std::make_unique<leafodbc::LeafClient>(
-        conn->endpoint_base, conn->user_agent, conn->timeout_sec, conn->verify_tls);
-    
-    if (!client->authenticate(conn->username, conn->password, conn->remember_me)) {
-        conn->diag.add("28000", 0, "Authentication failed");
+    if (!open_session(conn)) {
         return SQL_ERROR;
     }
-    
-    conn->auth_token = client->get_token();
-    conn->token_valid = true;
-    conn->token_obtained_at = std::chrono::system_clock::now();
+    probe_layer_stats(conn);
     
     // Copy connection string to output if requested
     if (out_connection_string && buffer_length > 0) {
@@ -261,12 +729,37 @@ SQLRETURN SQLDriverConnect(SQLHDBC connection_handle, SQLHWND window_handle,
 
 // SQLDisconnect
 SQLRETURN SQLDisconnect(SQLHDBC connection_handle) {
+    LEAF_TRACE_SCOPE("SQLDisconnect", "odbc");
     auto* conn = leafodbc::HandleRegistry::instance().get_conn(connection_handle);
     if (!conn) {
         return SQL_INVALID_HANDLE;
     }
     
     std::lock_guard<std::mutex> lock(conn->mutex);
+    
+    // A LazyConnect authentication still running is abandoned
+    if (conn->pending_connect) {
+        bool done;
+        {
+            std::lock_guard<std::mutex> pending_lock(conn->pending_connect->mutex);
+            done = conn->pending_connect->done;
+        }
+        if (done) {
+            finish_pending_connect(conn, conn->pending_connect);
+        }
+        conn->pending_connect.reset();
+    }
+    
+    // Park the session so the next connection with the same settings skips authentication
+    if (conn->is_connected() && conn->session_pool_idle_sec > 0) {
+        leafodbc::PooledSession session;
+        session.auth_token = conn->auth_token;
+        session.token_obtained_at = conn->token_obtained_at;
+        session.arena_pool = std::move(conn->arena_pool);
+        conn->arena_pool = leafodbc::ArenaPool::create();
+        leafodbc::SessionPool::instance().release(leafodbc::SessionPool::make_key(*conn), conn->password,
+                                                  std::move(session), conn->session_pool_idle_sec);
+    }
     conn->auth_token.clear();
     conn->token_valid = false;
     
@@ -275,13 +768,13 @@ SQLRETURN SQLDisconnect(SQLHDBC connection_handle) {
 
 // SQLExecDirect
 SQLRETURN SQLExecDirect(SQLHSTMT statement_handle, SQLCHAR* statement_text, SQLINTEGER text_length) {
+    LEAF_TRACE_SCOPE("SQLExecDirect", "odbc");
     auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
     if (!stmt) {
         return SQL_INVALID_HANDLE;
     }
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
-    stmt->diag.clear();
     
     std::string sql;
     if (statement_text) {
@@ -292,79 +785,12 @@ SQLRETURN SQLExecDirect(SQLHSTMT statement_handle, SQLCHAR* statement_text, SQLI
         }
     }
     
-    stmt->sql_text = sql;
-    stmt->executed = false;
-    stmt->resultset.reset();
-    stmt->current_row = 0;
-    
-    // Check if it's a metadata query
-    std::string upper_sql = sql;
-    std::transform(upper_sql.begin(), upper_sql.end(), upper_sql.begin(), ::toupper);
-    
-    // Handle GEOMETRY_COLUMNS query
-    if (upper_sql.find("GEOMETRY_COLUMNS") != std::string::npos && 
-        upper_sql.find("SELECT") != std::string::npos) {
-        stmt->resultset = leafodbc::Metadata::get_geometry_columns();
-        stmt->executed = true;
-        return SQL_SUCCESS;
-    }
-    
-    // Check if allowed (SELECT only)
-    if (!leafodbc::SQLGuard::is_allowed(sql)) {
-        stmt->diag.add("42000", 0, "Only SELECT statements are allowed");
-        return SQL_ERROR;
-    }
-    
-    // Get connection handle from statement
-    if (!stmt->conn_handle) {
-        stmt->diag.add("08003", 0, "Connection does not exist");
-        return SQL_ERROR;
-    }
-    
-    auto* conn = leafodbc::HandleRegistry::instance().get_conn(stmt->conn_handle);
-    if (!conn || !conn->is_connected()) {
-        stmt->diag.add("08003", 0, "Connection not established");
-        return SQL_ERROR;
-    }
-    
-    // Execute query via LeafClient
-    auto client = std::make_unique<leafodbc::LeafClient>(
-        conn->endpoint_base, conn->user_agent, conn->timeout_sec, conn->verify_tls);
-    client->set_token(conn->auth_token);
-    
-    nlohmann::json json_result;
-    if (!client->execute_query(sql, conn->sql_engine, json_result)) {
-        // Check if 401 - try reauth once
-        if (conn->token_valid) {
-            // Try reauthentication
-            if (client->authenticate(conn->username, conn->password, conn->remember_me)) {
-                conn->auth_token = client->get_token();
-                // Retry query
-                if (!client->execute_query(sql, conn->sql_engine, json_result)) {
-                    stmt->diag.add("HY000", 0, "Query execution failed");
-                    return SQL_ERROR;
-                }
-            } else {
-                stmt->diag.add("28000", 0, "Reauthentication failed");
-                return SQL_ERROR;
-            }
-        } else {
-            stmt->diag.add("HY000", 0, "Query execution failed");
-            return SQL_ERROR;
-        }
-    }
-    
-    // Load result set
-    stmt->resultset = std::make_unique<leafodbc::ResultSet>();
-    stmt->resultset->load_from_json(json_result);
-    stmt->executed = true;
-    stmt->current_row = 0;
-    
-    return SQL_SUCCESS;
+    return execute_statement(stmt, sql, SQL_API_SQLEXECDIRECT);
 }
 
 // SQLPrepare
 SQLRETURN SQLPrepare(SQLHSTMT statement_handle, SQLCHAR* statement_text, SQLINTEGER text_length) {
+    LEAF_TRACE_SCOPE("SQLPrepare", "odbc");
     auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
     if (!stmt) {
         return SQL_INVALID_HANDLE;
@@ -372,6 +798,9 @@ SQLRETURN SQLPrepare(SQLHSTMT statement_handle, SQLCHAR* statement_text, SQLINTE
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
     stmt->diag.clear();
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
     
     std::string sql;
     if (statement_text) {
@@ -391,21 +820,72 @@ SQLRETURN SQLPrepare(SQLHSTMT statement_handle, SQLCHAR* statement_text, SQLINTE
 
 // SQLExecute
 SQLRETURN SQLExecute(SQLHSTMT statement_handle) {
+    LEAF_TRACE_SCOPE("SQLExecute", "odbc");
     auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
     if (!stmt) {
         return SQL_INVALID_HANDLE;
     }
     
-    if (!stmt->prepared) {
-        std::lock_guard<std::mutex> lock(stmt->mutex);
+    std::lock_guard<std::mutex> lock(stmt->mutex);
+    
+    if (!stmt->prepared && !stmt->async_exec) {
         stmt->diag.add("HY010", 0, "Function sequence error");
         return SQL_ERROR;
     }
     
-    // Similar to SQLExecDirect but uses prepared statement
-    return SQLExecDirect(statement_handle, 
-                        reinterpret_cast<SQLCHAR*>(const_cast<char*>(stmt->sql_text.c_str())),
-                        SQL_NTS);
+    // Same as SQLExecDirect but uses the prepared statement
+    std::string sql = stmt->sql_text;
+    return execute_statement(stmt, sql, SQL_API_SQLEXECUTE);
+}
+
+// SQLCancel
+SQLRETURN SQLCancel(SQLHSTMT statement_handle) {
+    LEAF_TRACE_SCOPE("SQLCancel", "odbc");
+    auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
+    if (!stmt) {
+        return SQL_INVALID_HANDLE;
+    }
+    
+    // Usually called from another thread while SQLExecDirect holds stmt->mutex
+    std::shared_ptr<leafodbc::CancelToken> cancel;
+    {
+        std::lock_guard<std::mutex> lock(stmt->cancel_mutex);
+        cancel = stmt->cancel_token;
+    }
+    
+    // Without an execution in progress this has no effect (ODBC 3.x)
+    if (cancel && !cancel->cancelled()) {
+        LEAF_LOG_INFO("Cancelling statement");
+        cancel->cancel();
+    }
+    return SQL_SUCCESS;
+}
+
+// Moves the cursor of `stmt` for SQLFetch and SQLFetchScroll; stmt->mutex is held
+static SQLRETURN fetch_row(leafodbc::StmtHandle* stmt, SQLSMALLINT orientation, SQLLEN offset) {
+    if (!stmt->resultset) {
+        stmt->diag.add("24000", 0, "Invalid cursor state");
+        return SQL_ERROR;
+    }
+    
+    bool tracing = leafodbc::trace_enabled();
+    if (tracing && stmt->fetch_trace_start_us < 0) {
+        stmt->fetch_trace_start_us = leafodbc::trace_now_us();
+    }
+    
+    auto fetch_start = std::chrono::steady_clock::now();
+    SQLRETURN ret = stmt->resultset->fetch_scroll(orientation, offset);
+    stmt->timings.fetch_us += leafodbc::elapsed_us(fetch_start);
+    
+    if (tracing) {
+        if (ret == SQL_SUCCESS) {
+            stmt->fetch_trace_rows++;
+        }
+        if (ret != SQL_SUCCESS || stmt->fetch_trace_rows >= FETCH_TRACE_BATCH_ROWS) {
+            flush_fetch_trace(stmt);
+        }
+    }
+    return ret;
 }
 
 // SQLFetch
@@ -416,13 +896,102 @@ SQLRETURN SQLFetch(SQLHSTMT statement_handle) {
     }
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
+    return fetch_row(stmt, SQL_FETCH_NEXT, 0);
+}
+
+// SQLFetchScroll
+SQLRETURN SQLFetchScroll(SQLHSTMT statement_handle, SQLSMALLINT fetch_orientation, SQLLEN fetch_offset) {
+    auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
+    if (!stmt) {
+        return SQL_INVALID_HANDLE;
+    }
     
-    if (!stmt->resultset) {
-        stmt->diag.add("24000", 0, "Invalid cursor state");
+    std::lock_guard<std::mutex> lock(stmt->mutex);
+    if (async_pending(stmt)) {
         return SQL_ERROR;
     }
     
-    return stmt->resultset->fetch();
+    switch (fetch_orientation) {
+        case SQL_FETCH_NEXT:
+            break;
+        case SQL_FETCH_PRIOR:
+        case SQL_FETCH_FIRST:
+        case SQL_FETCH_LAST:
+        case SQL_FETCH_ABSOLUTE:
+        case SQL_FETCH_RELATIVE:
+            if (stmt->cursor_type == SQL_CURSOR_FORWARD_ONLY) {
+                stmt->diag.add("HY106", 0, "Fetch type out of range");
+                return SQL_ERROR;
+            }
+            break;
+        case SQL_FETCH_BOOKMARK:
+            stmt->diag.add("HYC00", 0, "Optional feature not implemented");
+            return SQL_ERROR;
+        default:
+            stmt->diag.add("HY106", 0, "Fetch type out of range");
+            return SQL_ERROR;
+    }
+    return fetch_row(stmt, fetch_orientation, fetch_offset);
+}
+
+// SQLRowCount
+SQLRETURN SQLRowCount(SQLHSTMT statement_handle, SQLLEN* row_count_ptr) {
+    auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
+    if (!stmt) {
+        return SQL_INVALID_HANDLE;
+    }
+    
+    std::lock_guard<std::mutex> lock(stmt->mutex);
+    stmt->diag.clear();
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
+    
+    if (!stmt->executed) {
+        stmt->diag.add("HY010", 0, "Function sequence error");
+        return SQL_ERROR;
+    }
+    // Results are fully received before execution returns, so the count is exact
+    if (row_count_ptr) {
+        *row_count_ptr = stmt->resultset ? static_cast<SQLLEN>(stmt->resultset->get_row_count()) : -1;
+    }
+    return SQL_SUCCESS;
+}
+
+// SQLMoreResults
+SQLRETURN SQLMoreResults(SQLHSTMT statement_handle) {
+    LEAF_TRACE_SCOPE("SQLMoreResults", "odbc");
+    auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
+    if (!stmt) {
+        return SQL_INVALID_HANDLE;
+    }
+    
+    std::lock_guard<std::mutex> lock(stmt->mutex);
+    stmt->diag.clear();
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
+    
+    // The current result is closed either way
+    flush_fetch_trace(stmt);
+    stmt->resultset.reset();
+    stmt->current_row = 0;
+    if (stmt->batch_results.empty()) {
+        return SQL_NO_DATA;
+    }
+    
+    // With SQL_ATTR_ASYNC_ENABLE, poll until the next statement is done
+    auto next = stmt->batch_results.front();
+    if (stmt->async_enable && next->notify_when_done(stmt->async_callback, stmt->async_context)) {
+        return SQL_STILL_EXECUTING;
+    }
+    next->wait();
+    stmt->batch_results.pop_front();
+    stmt->executed = false;
+    return apply_exec_job(stmt, next->job);
 }
 
 // SQLGetData
@@ -434,20 +1003,272 @@ SQLRETURN SQLGetData(SQLHSTMT statement_handle, SQLUSMALLINT column_number, SQLS
     }
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
     
     if (!stmt->resultset) {
         stmt->diag.add("24000", 0, "Invalid cursor state");
         return SQL_ERROR;
     }
     
-    return stmt->resultset->get_data(column_number, target_type, target_value_ptr, 
-                                     buffer_length, str_len_or_ind_ptr);
+    auto fetch_start = std::chrono::steady_clock::now();
+    SQLRETURN ret = stmt->resultset->get_data(column_number, target_type, target_value_ptr,
+                                              buffer_length, str_len_or_ind_ptr);
+    stmt->timings.fetch_us += leafodbc::elapsed_us(fetch_start);
+    return ret;
+}
+
+// SQLSetStmtAttr
+SQLRETURN SQLSetStmtAttr(SQLHSTMT statement_handle, SQLINTEGER attribute, SQLPOINTER value_ptr, SQLINTEGER string_length) {
+    LEAF_TRACE_SCOPE("SQLSetStmtAttr", "odbc");
+    (void)string_length;
+    auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
+    if (!stmt) {
+        return SQL_INVALID_HANDLE;
+    }
+    
+    std::lock_guard<std::mutex> lock(stmt->mutex);
+    stmt->diag.clear();
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
+    
+    // Integer attributes are passed by value in value_ptr
+    SQLULEN value = static_cast<SQLULEN>(reinterpret_cast<uintptr_t>(value_ptr));
+    
+    switch (attribute) {
+        case SQL_ATTR_ASYNC_ENABLE:
+            if (value != SQL_ASYNC_ENABLE_OFF && value != SQL_ASYNC_ENABLE_ON) {
+                stmt->diag.add("HY024", 0, "Invalid attribute value");
+                return SQL_ERROR;
+            }
+            stmt->async_enable = (value == SQL_ASYNC_ENABLE_ON);
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_ASYNC_STMT_PCALLBACK:
+            stmt->async_callback = reinterpret_cast<leafodbc::AsyncNotificationCallback>(value_ptr);
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_ASYNC_STMT_PCONTEXT:
+            stmt->async_context = value_ptr;
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_QUERY_TIMEOUT:
+            stmt->query_timeout = value;
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_TIMING_DIAG:
+            stmt->timing_diag = (value != 0);
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_PRIORITY:
+            if (value != SQL_LEAF_PRIORITY_INTERACTIVE && value != SQL_LEAF_PRIORITY_NORMAL &&
+                value != SQL_LEAF_PRIORITY_BULK) {
+                stmt->diag.add("HY024", 0, "Invalid attribute value");
+                return SQL_ERROR;
+            }
+            stmt->priority = static_cast<int>(value);
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_MEMORY_BUDGET_MB:
+            stmt->memory_budget_mb = value;
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_MAX_ROWS:
+            stmt->max_rows = value;
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_SIMPLIFY_TOLERANCE: {
+            if (!value_ptr) {
+                stmt->diag.add("HY009", 0, "Invalid use of null pointer");
+                return SQL_ERROR;
+            }
+            SQLDOUBLE tolerance = *reinterpret_cast<SQLDOUBLE*>(value_ptr);
+            if (!(tolerance >= 0)) {
+                stmt->diag.add("HY024", 0, "Invalid attribute value");
+                return SQL_ERROR;
+            }
+            stmt->simplify_tolerance = tolerance;
+            return SQL_SUCCESS;
+        }
+        
+        // Results are held in full, so every scrollable cursor is static
+        case SQL_ATTR_CURSOR_TYPE:
+            if (value == SQL_CURSOR_FORWARD_ONLY || value == SQL_CURSOR_STATIC) {
+                stmt->cursor_type = value;
+                return SQL_SUCCESS;
+            }
+            if (value != SQL_CURSOR_KEYSET_DRIVEN && value != SQL_CURSOR_DYNAMIC) {
+                stmt->diag.add("HY024", 0, "Invalid attribute value");
+                return SQL_ERROR;
+            }
+            stmt->cursor_type = SQL_CURSOR_STATIC;
+            stmt->diag.add("01S02", 0, "Option value changed");
+            return SQL_SUCCESS_WITH_INFO;
+        
+        case SQL_ATTR_CURSOR_SCROLLABLE:
+            if (value != SQL_NONSCROLLABLE && value != SQL_SCROLLABLE) {
+                stmt->diag.add("HY024", 0, "Invalid attribute value");
+                return SQL_ERROR;
+            }
+            stmt->cursor_type = (value == SQL_SCROLLABLE) ? SQL_CURSOR_STATIC : SQL_CURSOR_FORWARD_ONLY;
+            return SQL_SUCCESS;
+        
+        default:
+            stmt->diag.add("HY092", 0, "Invalid attribute");
+            return SQL_ERROR;
+    }
+}
+
+// SQLGetStmtAttr
+SQLRETURN SQLGetStmtAttr(SQLHSTMT statement_handle, SQLINTEGER attribute, SQLPOINTER value_ptr, SQLINTEGER buffer_length, SQLINTEGER* string_length_ptr) {
+    LEAF_TRACE_SCOPE("SQLGetStmtAttr", "odbc");
+    auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
+    if (!stmt) {
+        return SQL_INVALID_HANDLE;
+    }
+    
+    std::lock_guard<std::mutex> lock(stmt->mutex);
+    stmt->diag.clear();
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
+    
+    const leafodbc::QueryTimings& t = stmt->timings;
+    int64_t timing_value = 0;
+    
+    switch (attribute) {
+        case SQL_ATTR_LEAF_TIMING_NAME_LOOKUP_US: timing_value = t.name_lookup_us; break;
+        case SQL_ATTR_LEAF_TIMING_CONNECT_US:     timing_value = t.connect_us; break;
+        case SQL_ATTR_LEAF_TIMING_TLS_US:         timing_value = t.tls_us; break;
+        case SQL_ATTR_LEAF_TIMING_TTFB_US:        timing_value = t.ttfb_us; break;
+        case SQL_ATTR_LEAF_TIMING_TRANSFER_US:    timing_value = t.transfer_us; break;
+        case SQL_ATTR_LEAF_TIMING_DECODE_US:      timing_value = t.decode_us; break;
+        case SQL_ATTR_LEAF_TIMING_SCHEMA_US:      timing_value = t.schema_us; break;
+        case SQL_ATTR_LEAF_TIMING_FETCH_US:       timing_value = t.fetch_us; break;
+        case SQL_ATTR_LEAF_TIMING_TOTAL_US:       timing_value = t.total_us; break;
+        case SQL_ATTR_LEAF_TIMING_BYTES_RECEIVED: timing_value = t.bytes_received; break;
+        case SQL_ATTR_LEAF_TIMING_ROWS:           timing_value = t.rows; break;
+        case SQL_ATTR_LEAF_TIMING_QUEUE_WAIT_US:  timing_value = t.queue_wait_us; break;
+        
+        case SQL_ATTR_LEAF_TIMING_SUMMARY: {
+            std::string summary = t.summary();
+            if (value_ptr && buffer_length > 0) {
+                size_t copy_len = std::min(summary.length(), static_cast<size_t>(buffer_length - 1));
+                std::memcpy(value_ptr, summary.c_str(), copy_len);
+                static_cast<char*>(value_ptr)[copy_len] = '\0';
+            }
+            if (string_length_ptr) {
+                *string_length_ptr = static_cast<SQLINTEGER>(summary.length());
+            }
+            if (value_ptr && buffer_length > 0 && summary.length() >= static_cast<size_t>(buffer_length)) {
+                stmt->diag.add("01004", 0, "String data, right truncated");
+                return SQL_SUCCESS_WITH_INFO;
+            }
+            return SQL_SUCCESS;
+        }
+        
+        case SQL_ATTR_LEAF_TIMING_DIAG:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) = stmt->timing_diag ? 1 : 0;
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_QUERY_TIMEOUT:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) = stmt->query_timeout;
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_ASYNC_ENABLE:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) = stmt->async_enable ? SQL_ASYNC_ENABLE_ON : SQL_ASYNC_ENABLE_OFF;
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_PRIORITY:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) = static_cast<SQLULEN>(stmt->priority);
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_MEMORY_BUDGET_MB:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) = stmt->memory_budget_mb;
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_MAX_ROWS:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) = stmt->max_rows;
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_SIMPLIFY_TOLERANCE:
+            if (value_ptr) {
+                *reinterpret_cast<SQLDOUBLE*>(value_ptr) = stmt->simplify_tolerance;
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_CURSOR_TYPE:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) = stmt->cursor_type;
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_CURSOR_SCROLLABLE:
+            if (value_ptr) {
+                *reinterpret_cast<SQLULEN*>(value_ptr) =
+                    stmt->cursor_type == SQL_CURSOR_FORWARD_ONLY ? SQL_NONSCROLLABLE : SQL_SCROLLABLE;
+            }
+            return SQL_SUCCESS;
+        
+        // 0 unless the cursor is on a row
+        case SQL_ATTR_ROW_NUMBER:
+            if (!stmt->resultset) {
+                stmt->diag.add("24000", 0, "Invalid cursor state");
+                return SQL_ERROR;
+            }
+            if (value_ptr) {
+                size_t position = stmt->resultset->get_position();
+                *reinterpret_cast<SQLULEN*>(value_ptr) =
+                    position > stmt->resultset->get_row_count() ? 0 : static_cast<SQLULEN>(position);
+            }
+            return SQL_SUCCESS;
+        
+        case SQL_ATTR_LEAF_ARROW_STREAM:
+            if (!stmt->resultset) {
+                stmt->diag.add("24000", 0, "Invalid cursor state");
+                return SQL_ERROR;
+            }
+            if (!value_ptr) {
+                stmt->diag.add("HY009", 0, "Invalid use of null pointer");
+                return SQL_ERROR;
+            }
+            leafodbc::export_arrow_stream(stmt->resultset->store(), stmt->resultset->get_position(),
+                                          static_cast<ArrowArrayStream*>(value_ptr));
+            return SQL_SUCCESS;
+        
+        default:
+            stmt->diag.add("HY092", 0, "Invalid attribute");
+            return SQL_ERROR;
+    }
+    
+    if (value_ptr) {
+        *reinterpret_cast<SQLBIGINT*>(value_ptr) = static_cast<SQLBIGINT>(timing_value);
+    }
+    if (string_length_ptr) {
+        *string_length_ptr = sizeof(SQLBIGINT);
+    }
+    return SQL_SUCCESS;
 }
 
 // SQLGetDiagRec
 SQLRETURN SQLGetDiagRec(SQLSMALLINT handle_type, SQLHANDLE handle, SQLSMALLINT rec_number,
                        SQLCHAR* sqlstate, SQLINTEGER* native_error,
                        SQLCHAR* message_text, SQLSMALLINT buffer_length, SQLSMALLINT* text_length_ptr) {
+    LEAF_TRACE_SCOPE("SQLGetDiagRec", "odbc");
     leafodbc::DiagStack* diag = nullptr;
     
     switch (handle_type) {
@@ -481,6 +1302,7 @@ SQLRETURN SQLGetDiagRec(SQLSMALLINT handle_type, SQLHANDLE handle, SQLSMALLINT r
 SQLRETURN SQLGetDiagField(SQLSMALLINT handle_type, SQLHANDLE handle, SQLSMALLINT rec_number,
                           SQLSMALLINT diag_identifier, SQLPOINTER diag_info_ptr,
                           SQLSMALLINT buffer_length, SQLSMALLINT* string_length_ptr) {
+    LEAF_TRACE_SCOPE("SQLGetDiagField", "odbc");
     leafodbc::DiagStack* diag = nullptr;
     
     switch (handle_type) {
@@ -516,6 +1338,7 @@ SQLRETURN SQLTables(SQLHSTMT statement_handle,
                    SQLCHAR* schema_name, SQLSMALLINT name_length2,
                    SQLCHAR* table_name, SQLSMALLINT name_length3,
                    SQLCHAR* table_type, SQLSMALLINT name_length4) {
+    LEAF_TRACE_SCOPE("SQLTables", "odbc");
     auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
     if (!stmt) {
         return SQL_INVALID_HANDLE;
@@ -523,6 +1346,9 @@ SQLRETURN SQLTables(SQLHSTMT statement_handle,
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
     stmt->diag.clear();
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
     
     std::string catalog_pattern = catalog_name ? 
         (name_length1 == SQL_NTS ? reinterpret_cast<const char*>(catalog_name) : 
@@ -540,6 +1366,7 @@ SQLRETURN SQLTables(SQLHSTMT statement_handle,
         (name_length4 == SQL_NTS ? reinterpret_cast<const char*>(table_type) :
          std::string(reinterpret_cast<const char*>(table_type), name_length4)) : "%";
     
+    discard_batch(stmt);
     stmt->resultset = leafodbc::Metadata::get_tables(catalog_pattern, schema_pattern, table_pattern, type_pattern);
     stmt->executed = true;
     stmt->current_row = 0;
@@ -553,6 +1380,7 @@ SQLRETURN SQLColumns(SQLHSTMT statement_handle,
                     SQLCHAR* schema_name, SQLSMALLINT name_length2,
                     SQLCHAR* table_name, SQLSMALLINT name_length3,
                     SQLCHAR* column_name, SQLSMALLINT name_length4) {
+    LEAF_TRACE_SCOPE("SQLColumns", "odbc");
     auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
     if (!stmt) {
         return SQL_INVALID_HANDLE;
@@ -560,6 +1388,9 @@ SQLRETURN SQLColumns(SQLHSTMT statement_handle,
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
     stmt->diag.clear();
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
     
     std::string catalog_pattern = catalog_name ?
         (name_length1 == SQL_NTS ? reinterpret_cast<const char*>(catalog_name) :
@@ -577,6 +1408,7 @@ SQLRETURN SQLColumns(SQLHSTMT statement_handle,
         (name_length4 == SQL_NTS ? reinterpret_cast<const char*>(column_name) :
          std::string(reinterpret_cast<const char*>(column_name), name_length4)) : "%";
     
+    discard_batch(stmt);
     stmt->resultset = leafodbc::Metadata::get_columns(catalog_pattern, schema_pattern, table_pattern, column_pattern);
     stmt->executed = true;
     stmt->current_row = 0;
@@ -586,12 +1418,16 @@ SQLRETURN SQLColumns(SQLHSTMT statement_handle,
 
 // SQLNumResultCols
 SQLRETURN SQLNumResultCols(SQLHSTMT statement_handle, SQLSMALLINT* column_count_ptr) {
+    LEAF_TRACE_SCOPE("SQLNumResultCols", "odbc");
     auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
     if (!stmt) {
         return SQL_INVALID_HANDLE;
     }
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
     
     if (!stmt->resultset) {
         if (column_count_ptr) {
@@ -613,12 +1449,16 @@ SQLRETURN SQLDescribeCol(SQLHSTMT statement_handle, SQLUSMALLINT column_number,
                         SQLSMALLINT* name_length_ptr, SQLSMALLINT* data_type_ptr,
                         SQLULEN* column_size_ptr, SQLSMALLINT* decimal_digits_ptr,
                         SQLSMALLINT* nullable_ptr) {
+    LEAF_TRACE_SCOPE("SQLDescribeCol", "odbc");
     auto* stmt = leafodbc::HandleRegistry::instance().get_stmt(statement_handle);
     if (!stmt) {
         return SQL_INVALID_HANDLE;
     }
     
     std::lock_guard<std::mutex> lock(stmt->mutex);
+    if (async_pending(stmt)) {
+        return SQL_ERROR;
+    }
     
     if (!stmt->resultset) {
         stmt->diag.add("24000", 0, "Invalid cursor state");
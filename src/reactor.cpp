@@ -0,0 +1,269 @@
+#include "leafodbc/reactor.h"
+#include "leafodbc/common.h"
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+namespace leafodbc {
+
+Reactor& Reactor::instance() {
+    static Reactor reactor;
+    return reactor;
+}
+
+Reactor::Reactor() {
+    // Not thread-safe in older libcurl, so do it once here instead of lazily
+    // inside whichever curl_easy_init happens to run first
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    multi_ = curl_multi_init();
+    curl_multi_setopt(multi_, CURLMOPT_SOCKETFUNCTION, &Reactor::socket_callback);
+    curl_multi_setopt(multi_, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi_, CURLMOPT_TIMERFUNCTION, &Reactor::timer_callback);
+    curl_multi_setopt(multi_, CURLMOPT_TIMERDATA, this);
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    if (pipe(wake_fds_) != 0) {
+        LEAF_LOG_ERROR("Reactor: pipe() failed: %s", std::strerror(errno));
+        wake_fds_[0] = wake_fds_[1] = -1;
+    }
+    for (int fd : wake_fds_) {
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    thread_ = std::thread(&Reactor::run, this);
+}
+
+Reactor::~Reactor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (int fd : wake_fds_) {
+        if (fd >= 0) close(fd);
+    }
+    curl_multi_cleanup(multi_);
+}
+
+void Reactor::submit(CURL* easy, Completion on_done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_) {
+            commands_.push_back(Command{easy, std::move(on_done)});
+            on_done = nullptr;
+        }
+    }
+    if (on_done) {
+        on_done(CURLE_FAILED_INIT);
+        return;
+    }
+    wake();
+}
+
+void Reactor::cancel(CURL* easy) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        commands_.push_back(Command{easy, nullptr});
+    }
+    wake();
+}
+
+void Reactor::post_after(std::chrono::milliseconds delay, std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_) {
+            timers_.emplace(std::chrono::steady_clock::now() + delay, std::move(fn));
+            fn = nullptr;
+        }
+    }
+    if (fn) {
+        fn();
+        return;
+    }
+    wake();
+}
+
+void Reactor::run_due_timers() {
+    std::vector<std::function<void()>> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        auto end = timers_.upper_bound(now);
+        for (auto it = timers_.begin(); it != end; ++it) {
+            due.push_back(std::move(it->second));
+        }
+        timers_.erase(timers_.begin(), end);
+    }
+    for (auto& fn : due) {
+        fn();
+    }
+}
+
+void Reactor::wake() {
+    if (wake_fds_[1] >= 0) {
+        char c = 1;
+        // A full pipe already guarantees a wakeup
+        ssize_t ignored = write(wake_fds_[1], &c, 1);
+        (void)ignored;
+    }
+}
+
+int Reactor::socket_callback(CURL*, curl_socket_t s, int what, void* userp, void*) {
+    Reactor* self = static_cast<Reactor*>(userp);
+    if (what == CURL_POLL_REMOVE) {
+        self->sockets_.erase(s);
+    } else {
+        self->sockets_[s] = what;
+    }
+    return 0;
+}
+
+int Reactor::timer_callback(CURLM*, long timeout_ms, void* userp) {
+    Reactor* self = static_cast<Reactor*>(userp);
+    if (timeout_ms < 0) {
+        self->timer_armed_ = false;
+    } else {
+        self->timer_armed_ = true;
+        self->timer_deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    }
+    return 0;
+}
+
+void Reactor::finish(CURL* easy, CURLcode result) {
+    auto it = transfers_.find(easy);
+    if (it == transfers_.end()) {
+        return;
+    }
+    Completion on_done = std::move(it->second);
+    transfers_.erase(it);
+    // Detach first so the completion may clean up the handle right away
+    curl_multi_remove_handle(multi_, easy);
+    on_done(result);
+}
+
+void Reactor::process_commands() {
+    std::vector<Command> commands;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        commands.swap(commands_);
+    }
+    for (auto& cmd : commands) {
+        if (cmd.on_done) {
+            transfers_[cmd.easy] = std::move(cmd.on_done);
+            CURLMcode rc = curl_multi_add_handle(multi_, cmd.easy);
+            if (rc != CURLM_OK) {
+                LEAF_LOG_WARN("Reactor: curl_multi_add_handle failed: %s", curl_multi_strerror(rc));
+                finish(cmd.easy, CURLE_FAILED_INIT);
+            }
+        } else {
+            finish(cmd.easy, CURLE_ABORTED_BY_CALLBACK);
+        }
+    }
+}
+
+void Reactor::read_completions() {
+    int pending = 0;
+    while (CURLMsg* msg = curl_multi_info_read(multi_, &pending)) {
+        if (msg->msg == CURLMSG_DONE) {
+            // msg is invalidated by curl_multi_remove_handle
+            CURL* easy = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            finish(easy, result);
+        }
+    }
+}
+
+void Reactor::run() {
+    std::vector<pollfd> fds;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) break;
+        }
+        process_commands();
+        read_completions();
+
+        fds.clear();
+        fds.push_back(pollfd{wake_fds_[0], POLLIN, 0});
+        for (const auto& entry : sockets_) {
+            short events = 0;
+            if (entry.second & CURL_POLL_IN) events |= POLLIN;
+            if (entry.second & CURL_POLL_OUT) events |= POLLOUT;
+            fds.push_back(pollfd{entry.first, events, 0});
+        }
+
+        bool has_deadline = timer_armed_;
+        auto deadline = timer_deadline_;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!timers_.empty() && (!has_deadline || timers_.begin()->first < deadline)) {
+                deadline = timers_.begin()->first;
+                has_deadline = true;
+            }
+        }
+        int timeout_ms = -1;
+        if (has_deadline) {
+            // Round up so a wakeup is never early
+            auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            timeout_ms = static_cast<int>(std::max<int64_t>(0, (remaining + 999) / 1000));
+        }
+
+        int ready = poll(fds.data(), fds.size(), timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            LEAF_LOG_ERROR("Reactor: poll() failed: %s", std::strerror(errno));
+        }
+
+        int running = 0;
+        if (ready > 0) {
+            if (fds[0].revents & POLLIN) {
+                char buf[64];
+                while (read(wake_fds_[0], buf, sizeof(buf)) > 0) {
+                }
+            }
+            for (size_t i = 1; i < fds.size(); ++i) {
+                short revents = fds[i].revents;
+                if (!revents) continue;
+                int flags = 0;
+                if (revents & POLLIN) flags |= CURL_CSELECT_IN;
+                if (revents & POLLOUT) flags |= CURL_CSELECT_OUT;
+                if (revents & (POLLERR | POLLHUP | POLLNVAL)) flags |= CURL_CSELECT_ERR;
+                curl_multi_socket_action(multi_, fds[i].fd, flags, &running);
+            }
+        }
+
+        if (timer_armed_ && std::chrono::steady_clock::now() >= timer_deadline_) {
+            timer_armed_ = false;
+            curl_multi_socket_action(multi_, CURL_SOCKET_TIMEOUT, 0, &running);
+        }
+        read_completions();
+        run_due_timers();
+    }
+
+    // Shutting down: fail whatever is still queued or in flight
+    process_commands();
+    while (!transfers_.empty()) {
+        finish(transfers_.begin()->first, CURLE_ABORTED_BY_CALLBACK);
+    }
+    // Timers fire early rather than never, so nothing waits forever on them
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> timers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers.swap(timers_);
+    }
+    for (auto& timer : timers) {
+        timer.second();
+    }
+}
+
+} // namespace leafodbc
@@ -0,0 +1,95 @@
+#include "leafodbc/request_policy.h"
+#include <curl/curl.h>
+#include <algorithm>
+
+namespace leafodbc {
+
+RequestPolicy::RequestPolicy(const RequestPolicyConfig& config)
+    : config_(config), budget_(BUDGET_RESERVE), rng_(std::random_device{}()) {
+    latencies_.reserve(LATENCY_WINDOW);
+}
+
+bool RequestPolicy::is_retryable(int status_code, int curl_code) {
+    if (curl_code != CURLE_OK) {
+        switch (curl_code) {
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_SSL_CONNECT_ERROR:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+            case CURLE_GOT_NOTHING:
+                return true;
+            default:
+                // Timeouts are not retried: the server may still be working on it
+                return false;
+        }
+    }
+    return status_code == 429 || status_code == 502 || status_code == 503 || status_code == 504;
+}
+
+int RequestPolicy::backoff_ms(int retry, int retry_after_ms) {
+    int64_t cap = config_.backoff_base_ms;
+    for (int i = 1; i < retry && cap < config_.backoff_max_ms; ++i) {
+        cap *= 2;
+    }
+    cap = std::min<int64_t>(cap, config_.backoff_max_ms);
+
+    int delay = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::uniform_int_distribution<int64_t> dist(0, cap);
+        delay = static_cast<int>(dist(rng_));
+    }
+
+    // A server-provided Retry-After wins, but never beyond the configured cap
+    if (retry_after_ms > delay) {
+        delay = std::min(retry_after_ms, config_.backoff_max_ms);
+    }
+    return delay;
+}
+
+void RequestPolicy::on_request() {
+    int64_t deposit = TOKEN_SCALE * config_.retry_budget_percent / 100;
+    int64_t current = budget_.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+        next = std::min(current + deposit, BUDGET_MAX);
+    } while (!budget_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+bool RequestPolicy::try_spend_retry() {
+    int64_t current = budget_.load(std::memory_order_relaxed);
+    while (current >= TOKEN_SCALE) {
+        if (budget_.compare_exchange_weak(current, current - TOKEN_SCALE, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RequestPolicy::record_latency(int64_t latency_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (latencies_.size() < LATENCY_WINDOW) {
+        latencies_.push_back(latency_us);
+    } else {
+        latencies_[latency_next_] = latency_us;
+    }
+    latency_next_ = (latency_next_ + 1) % LATENCY_WINDOW;
+}
+
+int64_t RequestPolicy::hedge_delay_us() {
+    std::vector<int64_t> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (latencies_.size() < LATENCY_MIN_SAMPLES) {
+            return -1;
+        }
+        sorted = latencies_;
+    }
+    size_t index = sorted.size() * static_cast<size_t>(config_.hedge_percentile) / 100;
+    index = std::min(index, sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+} // namespace leafodbc
@@ -0,0 +1,437 @@
+#include "leafodbc/response_decoder.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace leafodbc {
+
+namespace {
+
+class JsonDecoder : public ResponseDecoder {
+public:
+    explicit JsonDecoder(const DecodeOptions& options) : options_(options) {}
+    
+    bool decode(std::string& body, ResultStoreBuilder& builder, std::string& error) override {
+        return decode_json_rows(options_, body, builder, error);
+    }
+    
+    bool decode_mapped(std::string_view body, ResultStoreBuilder& builder, std::string& error) override {
+        return decode_json_rows_mapped(options_, body, builder, error);
+    }
+    
+    std::shared_ptr<ResultStore> index(std::string& body, std::shared_ptr<Arena> arena) override {
+        return index_json_rows(body, std::move(arena));
+    }
+    
+private:
+    DecodeOptions options_;
+};
+
+class NdJsonDecoder : public ResponseDecoder {
+public:
+    explicit NdJsonDecoder(const DecodeOptions& options) : options_(options) {}
+    
+    bool decode(std::string& body, ResultStoreBuilder& builder, std::string& error) override {
+        return decode_ndjson_rows(options_, body, builder, error);
+    }
+    
+    bool decode_mapped(std::string_view body, ResultStoreBuilder& builder, std::string& error) override {
+        return decode_ndjson_rows_mapped(options_, body, builder, error);
+    }
+    
+private:
+    DecodeOptions options_;
+};
+
+// One field of a CSV record
+struct CsvField {
+    std::string_view text; // Still escaped if `escaped`
+    bool quoted = false;
+    bool escaped = false; // Quoted text containing "" pairs
+};
+
+// Parses the record starting at `pos` into `fields` and returns the index
+// past its line break, or npos on an unterminated quoted field
+size_t parse_csv_record(std::string_view text, size_t pos, std::vector<CsvField>& fields) {
+    fields.clear();
+    for (;;) {
+        CsvField field;
+        if (pos < text.size() && text[pos] == '"') {
+            size_t begin = ++pos;
+            for (;;) {
+                pos = text.find('"', pos);
+                if (pos == std::string_view::npos) {
+                    return pos;
+                }
+                if (pos + 1 < text.size() && text[pos + 1] == '"') {
+                    field.escaped = true;
+                    pos += 2;
+                    continue;
+                }
+                break;
+            }
+            field.text = text.substr(begin, pos - begin);
+            field.quoted = true;
+            // Anything between the closing quote and the delimiter is dropped
+            pos = text.find_first_of(",\n", pos + 1);
+            if (pos == std::string_view::npos) {
+                pos = text.size();
+            }
+        } else {
+            size_t end = text.find_first_of(",\n", pos);
+            if (end == std::string_view::npos) {
+                end = text.size();
+            }
+            field.text = text.substr(pos, end - pos);
+            pos = end;
+        }
+        if (!field.quoted && !field.text.empty() && field.text.back() == '\r' &&
+            (pos == text.size() || text[pos] == '\n')) {
+            field.text.remove_suffix(1);
+        }
+        fields.push_back(field);
+        if (pos >= text.size()) {
+            return text.size();
+        }
+        if (text[pos++] == '\n') {
+            return pos;
+        }
+    }
+}
+
+std::string_view unescape_csv(const CsvField& field, std::string& scratch) {
+    if (!field.escaped) {
+        return field.text;
+    }
+    scratch.clear();
+    for (size_t i = 0; i < field.text.size(); ++i) {
+        scratch += field.text[i];
+        if (field.text[i] == '"') {
+            ++i; // Skip the second quote of the pair
+        }
+    }
+    return scratch;
+}
+
+// CSV carries no types, so unquoted fields are typed by their text the way
+// the JSON decoders type values: empty as NULL, true/false as booleans and
+// numbers as integers or doubles. Quoted fields are always strings.
+Value csv_value(const CsvField& field, Arena& arena, std::string& scratch) {
+    if (field.quoted) {
+        return Value::make_text(Value::Kind::String, arena.copy(unescape_csv(field, scratch)));
+    }
+    std::string_view s = field.text;
+    if (s.empty()) {
+        return Value();
+    }
+    if (s == "true" || s == "TRUE") {
+        return Value::make_bool(true);
+    }
+    if (s == "false" || s == "FALSE") {
+        return Value::make_bool(false);
+    }
+    const char* first = s.data();
+    const char* last = s.data() + s.size();
+    // Leading zeros mark identifiers such as postal codes, not numbers
+    size_t digits = s[0] == '-' ? 1 : 0;
+    bool leading_zero = s.size() > digits + 1 && s[digits] == '0' && std::isdigit(static_cast<unsigned char>(s[digits + 1]));
+    if (!leading_zero && digits < s.size() && std::isdigit(static_cast<unsigned char>(s[digits]))) {
+        int64_t i;
+        auto parsed = std::from_chars(first, last, i);
+        if (parsed.ec == std::errc() && parsed.ptr == last) {
+            return Value::make_int(i);
+        }
+        uint64_t u;
+        parsed = std::from_chars(first, last, u);
+        if (parsed.ec == std::errc() && parsed.ptr == last) {
+            return Value::make_uint(u);
+        }
+        double d;
+        auto parsed_double = std::from_chars(first, last, d);
+        if (parsed_double.ec == std::errc() && parsed_double.ptr == last) {
+            return Value::make_double(d);
+        }
+    }
+    return Value::make_text(Value::Kind::String, arena.copy(s));
+}
+
+// Decodes CSV records under the column names of the header line
+bool decode_csv_records(std::string_view text, const std::vector<std::string>& names, ResultStoreBuilder& builder,
+                        std::string& error) {
+    std::vector<uint32_t> keys;
+    keys.reserve(names.size());
+    for (const std::string& name : names) {
+        keys.push_back(builder.key(name));
+    }
+    Arena& arena = builder.arena();
+    std::vector<CsvField> fields;
+    std::string scratch;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t next = parse_csv_record(text, pos, fields);
+        if (next == std::string_view::npos) {
+            error = "Unterminated quoted field in CSV response";
+            return false;
+        }
+        pos = next;
+        if (fields.size() == 1 && !fields[0].quoted && fields[0].text.empty()) {
+            continue; // Blank line
+        }
+        // Missing fields read as NULL; fields beyond the header are dropped
+        builder.begin_row();
+        for (size_t f = 0; f < keys.size(); ++f) {
+            builder.set(keys[f], f < fields.size() ? csv_value(fields[f], arena, scratch) : Value());
+        }
+    }
+    return true;
+}
+
+class CsvDecoder : public ResponseDecoder {
+public:
+    explicit CsvDecoder(const DecodeOptions& options) : options_(options) {}
+    
+    bool decode(std::string& body, ResultStoreBuilder& builder, std::string& error) override {
+        return decode_mapped(body, builder, error);
+    }
+    
+    // Records are only read, so the body is never copied
+    bool decode_mapped(std::string_view body, ResultStoreBuilder& builder, std::string& error) override {
+        std::string_view text(body);
+        if (text.substr(0, 3) == "\xEF\xBB\xBF") {
+            text.remove_prefix(3); // UTF-8 byte order mark
+        }
+        std::vector<CsvField> fields;
+        size_t header_end = parse_csv_record(text, 0, fields);
+        if (header_end == std::string_view::npos) {
+            error = "Unterminated quoted field in CSV response";
+            return false;
+        }
+        std::vector<std::string> names;
+        std::string scratch;
+        for (const CsvField& field : fields) {
+            names.emplace_back(unescape_csv(field, scratch));
+        }
+        if (names.size() == 1 && names[0].empty()) {
+            return true; // Empty response
+        }
+        
+        size_t begin = static_cast<size_t>(text.data() - body.data()) + header_end;
+        size_t threads = parallel_decode_threads(options_, body.size() - begin);
+        if (decode_in_ranges(options_, threads, body.size() - begin)) {
+            auto ranges = split_lines(body, begin, body.size(), threads, true, options_.memory_budget);
+            if (ranges.size() > 1) {
+                auto decode_records = [&names](std::string_view records, ResultStoreBuilder& rows,
+                                               std::string& chunk_error) {
+                    return decode_csv_records(records, names, rows, chunk_error);
+                };
+                return decode_chunks(options_, threads, body, std::move(ranges), decode_records, builder, error);
+            }
+        }
+        return decode_csv_records(body.substr(begin), names, builder, error);
+    }
+    
+private:
+    DecodeOptions options_;
+};
+
+} // namespace
+
+namespace {
+
+constexpr size_t SPOOL_BUFFER_BYTES = 1024 * 1024;
+// Zeros behind the body, so that no decoder reading a little past the end
+// of its input leaves the mapping
+constexpr size_t SPOOL_PADDING = 64;
+
+} // namespace
+
+std::unique_ptr<BodySpool> BodySpool::create(std::string& error) {
+    int fd = create_spill_file(error);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<BodySpool>(new BodySpool(fd));
+}
+
+BodySpool::~BodySpool() {
+    if (data_) {
+        ::munmap(data_, mapped_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool BodySpool::append(const char* data, size_t size) {
+    size_ += size;
+    if (buffer_.size() + size > SPOOL_BUFFER_BYTES && !flush()) {
+        return false;
+    }
+    if (size > SPOOL_BUFFER_BYTES) {
+        // Such as the part received before spooling began: no other copy
+        return write(data, size);
+    }
+    buffer_.append(data, size);
+    return ok_;
+}
+
+bool BodySpool::flush() {
+    bool written = write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return written;
+}
+
+bool BodySpool::write(const char* data, size_t size) {
+    size_t done = 0;
+    while (ok_ && done < size) {
+        ssize_t n = ::write(fd_, data + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ok_ = false;
+            error_ = errno;
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return ok_;
+}
+
+std::string_view BodySpool::map(std::string& error) {
+    buffer_.append(SPOOL_PADDING, '\0');
+    if (!flush()) {
+        error = std::string("Cannot write response to disk: ") + std::strerror(error_);
+        return std::string_view();
+    }
+    std::string().swap(buffer_);
+    mapped_ = size_ + SPOOL_PADDING;
+    void* data = ::mmap(nullptr, mapped_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    int map_errno = errno;
+    ::close(fd_);
+    fd_ = -1;
+    if (data == MAP_FAILED) {
+        error = std::string("Cannot map response: ") + std::strerror(map_errno);
+        return std::string_view();
+    }
+    data_ = data;
+    return std::string_view(static_cast<const char*>(data), size_);
+}
+
+std::unique_ptr<ResponseDecoder> make_response_decoder(ResponseFormat format, const DecodeOptions& options) {
+    switch (format) {
+        case ResponseFormat::NdJson: return std::make_unique<NdJsonDecoder>(options);
+        case ResponseFormat::Csv: return std::make_unique<CsvDecoder>(options);
+        default: return std::make_unique<JsonDecoder>(options);
+    }
+}
+
+ResponseFormat response_format_of(const std::string& content_type, ResponseFormat requested) {
+    std::string media_type = content_type.substr(0, content_type.find(';'));
+    media_type.erase(std::remove_if(media_type.begin(), media_type.end(),
+                                    [](unsigned char c) { return std::isspace(c); }),
+                     media_type.end());
+    std::transform(media_type.begin(), media_type.end(), media_type.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (media_type == "application/x-ndjson" || media_type == "application/ndjson" ||
+        media_type == "application/jsonl" || media_type == "application/x-jsonlines") {
+        return ResponseFormat::NdJson;
+    }
+    if (media_type == "text/csv") {
+        return ResponseFormat::Csv;
+    }
+    if (media_type == "application/json" ||
+        (media_type.size() > 5 && media_type.compare(media_type.size() - 5, 5, "+json") == 0)) {
+        return ResponseFormat::Json;
+    }
+    return requested;
+}
+
+const char* accept_header(ResponseFormat format) {
+    switch (format) {
+        case ResponseFormat::NdJson: return "Accept: application/x-ndjson, application/json;q=0.5";
+        case ResponseFormat::Csv: return "Accept: text/csv, application/json;q=0.5";
+        default: return "Accept: application/json";
+    }
+}
+
+bool RowLimiter::append(std::string& body) {
+    if (ignored_) {
+        scanned_ = body.size();
+        return false;
+    }
+    for (size_t i = scanned_; i < body.size(); i++) {
+        char c = body[i];
+        size_t row_end = 0;
+        
+        if (format_ == ResponseFormat::Json) {
+            if (!started_) {
+                if (std::isspace(static_cast<unsigned char>(c))) {
+                    continue;
+                }
+                started_ = true;
+                if (c != '[') {
+                    ignored_ = true;
+                    scanned_ = body.size();
+                    return false;
+                }
+            }
+            if (in_string_) {
+                if (escaped_) {
+                    escaped_ = false;
+                } else if (c == '\\') {
+                    escaped_ = true;
+                } else if (c == '"') {
+                    in_string_ = false;
+                }
+                continue;
+            }
+            if (c == '"') {
+                in_string_ = true;
+            } else if (c == '{' || c == '[') {
+                depth_++;
+            } else if (c == '}' || c == ']') {
+                // A row is a value nested directly in the top-level array
+                if (--depth_ == 1) {
+                    row_end = i + 1;
+                }
+            }
+        } else {
+            // NDJSON strings cannot hold raw newlines; CSV quoted fields can
+            if (format_ == ResponseFormat::Csv && c == '"') {
+                in_string_ = !in_string_;
+            }
+            if (c == '\n' && !in_string_) {
+                if (line_has_data_) {
+                    if (format_ == ResponseFormat::Csv && !header_seen_) {
+                        header_seen_ = true;
+                    } else {
+                        row_end = i + 1;
+                    }
+                }
+                line_has_data_ = false;
+            } else if (!std::isspace(static_cast<unsigned char>(c))) {
+                line_has_data_ = true;
+            }
+        }
+        
+        if (row_end > 0 && ++rows_ >= max_rows_) {
+            body.resize(row_end);
+            if (format_ == ResponseFormat::Json) {
+                body += ']';
+            }
+            scanned_ = body.size();
+            return true;
+        }
+    }
+    scanned_ = body.size();
+    return false;
+}
+
+} // namespace leafodbc
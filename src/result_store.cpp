@@ -0,0 +1,586 @@
+#include "leafodbc/result_store.h"
+#include "leafodbc/common.h"
+#include "leafodbc/logger.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace leafodbc {
+
+namespace {
+
+SQLSMALLINT infer_sql_type(const Value& value) {
+    switch (value.kind) {
+        case Value::Kind::Null:
+            return SQL_VARCHAR;
+        case Value::Kind::Bool:
+            return SQL_BIT;
+        case Value::Kind::Int:
+        case Value::Kind::UInt: {
+            int64_t v = value.as_int64();
+            if (v >= INT32_MIN && v <= INT32_MAX) {
+                return SQL_INTEGER;
+            } else {
+                return SQL_BIGINT;
+            }
+        }
+        case Value::Kind::Double:
+            return SQL_DOUBLE;
+        case Value::Kind::String:
+            return value.length > 4000 ? SQL_LONGVARCHAR : SQL_VARCHAR;
+        default:
+            // Objects/arrays -> JSON string
+            return SQL_LONGVARCHAR;
+    }
+}
+
+std::string infer_type_name(SQLSMALLINT sql_type) {
+    switch (sql_type) {
+        case SQL_BIT: return "BIT";
+        case SQL_INTEGER: return "INTEGER";
+        case SQL_BIGINT: return "BIGINT";
+        case SQL_DOUBLE: return "DOUBLE";
+        case SQL_VARCHAR: return "VARCHAR";
+        case SQL_LONGVARCHAR: return "LONGVARCHAR";
+        default: return "VARCHAR";
+    }
+}
+
+SQLULEN infer_column_size(SQLSMALLINT sql_type) {
+    switch (sql_type) {
+        case SQL_BIT: return 1;
+        case SQL_INTEGER: return 10;
+        case SQL_BIGINT: return 19;
+        case SQL_DOUBLE: return 15;
+        case SQL_VARCHAR: return 4000;
+        case SQL_LONGVARCHAR: return 0; // Variable length
+        default: return 4000;
+    }
+}
+
+} // namespace
+
+int64_t Value::as_int64() const {
+    switch (kind) {
+        case Kind::Bool: return b ? 1 : 0;
+        case Kind::Int: return i;
+        case Kind::UInt: return static_cast<int64_t>(u);
+        case Kind::Double: return static_cast<int64_t>(d);
+        default: return 0;
+    }
+}
+
+double Value::as_double() const {
+    switch (kind) {
+        case Kind::Bool: return b ? 1.0 : 0.0;
+        case Kind::Int: return static_cast<double>(i);
+        case Kind::UInt: return static_cast<double>(u);
+        case Kind::Double: return d;
+        default: return 0.0;
+    }
+}
+
+std::string Value::dump() const {
+    switch (kind) {
+        case Kind::Null: return "null";
+        case Kind::Bool: return b ? "true" : "false";
+        case Kind::Int: return std::to_string(i);
+        case Kind::UInt: return std::to_string(u);
+        // nlohmann prints the shortest representation that round-trips
+        case Kind::Double: return nlohmann::json(d).dump();
+        case Kind::String: return nlohmann::json(std::string(str())).dump();
+        default: return std::string(str());
+    }
+}
+
+Value Value::from_json(const nlohmann::json& json, Arena& arena) {
+    if (json.is_null()) {
+        return Value();
+    } else if (json.is_boolean()) {
+        return make_bool(json.get<bool>());
+    } else if (json.is_number_unsigned()) {
+        return make_uint(json.get<uint64_t>());
+    } else if (json.is_number_integer()) {
+        return make_int(json.get<int64_t>());
+    } else if (json.is_number_float()) {
+        return make_double(json.get<double>());
+    } else if (json.is_string()) {
+        return make_text(Kind::String, arena.copy(json.get_ref<const std::string&>()));
+    }
+    return make_text(Kind::Json, arena.copy(json.dump()));
+}
+
+LazyColumns::LazyColumns(std::string body, std::vector<Field> fields, std::vector<size_t> row_offsets,
+                         size_t column_count, DecodeFn decode)
+    : body_(std::move(body)), fields_(std::move(fields)), row_offsets_(std::move(row_offsets)),
+      decode_(decode), decoded_(new std::once_flag[column_count]), columns_(column_count) {
+}
+
+const Value& LazyColumns::cell(size_t row, size_t column, Arena& arena) const {
+    std::call_once(decoded_[column], [&] { decode_column(column, arena); });
+    return columns_[column][row];
+}
+
+size_t LazyColumns::memory_bytes() const {
+    size_t bytes = body_.capacity() + fields_.capacity() * sizeof(Field) + row_offsets_.capacity() * sizeof(size_t);
+    for (const auto& column : columns_) {
+        bytes += column.capacity() * sizeof(Value);
+    }
+    return bytes;
+}
+
+void LazyColumns::decode_column(size_t column, Arena& arena) const {
+    size_t rows = row_offsets_.size();
+    std::vector<Value> values(rows);
+    // Another column may be decoding into the same arena
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    for (size_t r = 0; r < rows; ++r) {
+        size_t end = r + 1 < rows ? row_offsets_[r + 1] : fields_.size();
+        for (size_t f = row_offsets_[r]; f < end; ++f) {
+            const Field& field = fields_[f];
+            if (field.column == column) {
+                values[r] = decode_(std::string_view(body_.data() + field.offset, field.length), arena);
+            }
+        }
+    }
+    columns_[column] = std::move(values);
+}
+
+namespace {
+
+uint64_t spill_payload(const Value& value) {
+    switch (value.kind) {
+        case Value::Kind::Bool: return value.b ? 1 : 0;
+        case Value::Kind::Int: return static_cast<uint64_t>(value.i);
+        case Value::Kind::UInt: return value.u;
+        case Value::Kind::Double: {
+            uint64_t bits;
+            std::memcpy(&bits, &value.d, sizeof(bits));
+            return bits;
+        }
+        default: return 0;
+    }
+}
+
+bool is_text(Value::Kind kind) {
+    return kind == Value::Kind::String || kind == Value::Kind::Json;
+}
+
+constexpr size_t SPILL_BUFFER_BYTES = 1024 * 1024;
+
+} // namespace
+
+int create_spill_file(std::string& error) {
+    const char* tmpdir = std::getenv("TMPDIR");
+    std::string path = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/leafodbc-spill-XXXXXX";
+    int fd = ::mkstemp(&path[0]);
+    if (fd < 0) {
+        error = "Cannot create " + path + ": " + std::strerror(errno);
+        return -1;
+    }
+    // Nothing is left behind, even if the process dies
+    ::unlink(path.c_str());
+    return fd;
+}
+
+SpilledColumns::Writer::Writer(int fd) : fd_(fd) {
+    buffer_.reserve(SPILL_BUFFER_BYTES);
+}
+
+SpilledColumns::Writer::~Writer() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+std::unique_ptr<SpilledColumns::Writer> SpilledColumns::Writer::create(std::string& error) {
+    int fd = create_spill_file(error);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<Writer>(new Writer(fd));
+}
+
+void SpilledColumns::Writer::put(const void* data, size_t size) {
+    if (buffer_.size() + size > SPILL_BUFFER_BYTES) {
+        flush();
+    }
+    buffer_.insert(buffer_.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    offset_ += size;
+}
+
+bool SpilledColumns::Writer::flush() {
+    size_t done = 0;
+    while (ok_ && done < buffer_.size()) {
+        ssize_t n = ::write(fd_, buffer_.data() + done, buffer_.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ok_ = false;
+            error_ = errno;
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    buffer_.clear();
+    return ok_;
+}
+
+bool SpilledColumns::Writer::append(const ResultStore& store, size_t first, size_t count) {
+    size_t width = store.columns.size();
+    Segment segment{rows_, count, offset_, offset_ + count * width * sizeof(uint64_t), 0};
+    segment.heap = segment.kinds + count * width;
+    
+    // Strings go to the heap in the order their payloads are written, and
+    // the payload holds the offset of the text behind its length
+    uint64_t heap_used = 0;
+    for (size_t c = 0; c < width; ++c) {
+        for (size_t r = first; r < first + count; ++r) {
+            Value value = store.cell(r, c);
+            uint64_t payload = spill_payload(value);
+            if (is_text(value.kind)) {
+                payload = heap_used + sizeof(uint32_t);
+                heap_used += sizeof(uint32_t) + value.length;
+            }
+            put(&payload, sizeof(payload));
+        }
+    }
+    for (size_t c = 0; c < width; ++c) {
+        for (size_t r = first; r < first + count; ++r) {
+            uint8_t kind = static_cast<uint8_t>(store.cell(r, c).kind);
+            put(&kind, sizeof(kind));
+        }
+    }
+    for (size_t c = 0; c < width; ++c) {
+        for (size_t r = first; r < first + count; ++r) {
+            Value value = store.cell(r, c);
+            if (is_text(value.kind)) {
+                put(&value.length, sizeof(uint32_t));
+                put(value.text, value.length);
+            }
+        }
+    }
+    if (count > 0) {
+        segments_.push_back(segment);
+        rows_ += count;
+    }
+    return ok_;
+}
+
+std::unique_ptr<SpilledColumns> SpilledColumns::Writer::finish(std::string& error) {
+    if (!flush()) {
+        error = std::string("Cannot write spill file: ") + std::strerror(error_);
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(offset_);
+    void* data = size ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0) : nullptr;
+    int map_errno = errno;
+    ::close(fd_);
+    fd_ = -1;
+    if (data == MAP_FAILED) {
+        error = std::string("Cannot map spill file: ") + std::strerror(map_errno);
+        return nullptr;
+    }
+    std::unique_ptr<SpilledColumns> spilled(new SpilledColumns());
+    spilled->data_ = static_cast<const char*>(data);
+    spilled->size_ = size;
+    spilled->segments_ = std::move(segments_);
+    return spilled;
+}
+
+SpilledColumns::~SpilledColumns() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+std::unique_ptr<SpilledColumns> SpilledColumns::write(const ResultStore& store, std::string& error) {
+    auto writer = Writer::create(error);
+    if (!writer) {
+        return nullptr;
+    }
+    writer->append(store, 0, store.row_count);
+    return writer->finish(error);
+}
+
+const SpilledColumns::Segment& SpilledColumns::segment_of(size_t row) const {
+    if (segments_.size() == 1) {
+        return segments_.front();
+    }
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), row,
+                               [](size_t r, const Segment& segment) { return r < segment.first_row; });
+    return *(it - 1);
+}
+
+Value SpilledColumns::cell(size_t row, size_t column) const {
+    const Segment& segment = segment_of(row);
+    size_t index = column * segment.rows + (row - segment.first_row);
+    auto kind = static_cast<Value::Kind>(static_cast<uint8_t>(data_[segment.kinds + index]));
+    uint64_t payload;
+    std::memcpy(&payload, data_ + segment.payloads + index * sizeof(uint64_t), sizeof(payload));
+    switch (kind) {
+        case Value::Kind::Bool: return Value::make_bool(payload != 0);
+        case Value::Kind::Int: return Value::make_int(static_cast<int64_t>(payload));
+        case Value::Kind::UInt: return Value::make_uint(payload);
+        case Value::Kind::Double: {
+            double d;
+            std::memcpy(&d, &payload, sizeof(d));
+            return Value::make_double(d);
+        }
+        case Value::Kind::String:
+        case Value::Kind::Json: {
+            const char* text = data_ + segment.heap + payload;
+            uint32_t length;
+            std::memcpy(&length, text - sizeof(uint32_t), sizeof(length));
+            return Value::make_text(kind, std::string_view(text, length));
+        }
+        default:
+            return Value();
+    }
+}
+
+size_t ResultStore::memory_bytes() const {
+    size_t bytes = arena->capacity();
+    for (const auto& chunk_arena : chunk_arenas) {
+        bytes += chunk_arena->capacity();
+    }
+    if (lazy) {
+        bytes += lazy->memory_bytes();
+    }
+    return bytes;
+}
+
+bool ResultStore::spill(std::string& error) {
+    auto file = SpilledColumns::write(*this, error);
+    if (!file) {
+        return false;
+    }
+    spilled = std::move(file);
+    lazy.reset();
+    std::pmr::vector<Value>(arena.get()).swap(cells);
+    chunk_arenas.clear();
+    arena->reset(0);
+    return true;
+}
+
+ResultStoreBuilder::ResultStoreBuilder(std::shared_ptr<Arena> arena) : arena_(std::move(arena)) {
+}
+
+void ResultStoreBuilder::reserve(size_t rows, size_t fields_per_row) {
+    row_offsets_.reserve(rows);
+    entries_.reserve(rows * fields_per_row);
+}
+
+void ResultStoreBuilder::begin_row() {
+    // Every row collected so far is complete here
+    if (memory_budget_ && ++rows_unchecked_ >= BUDGET_CHECK_ROWS) {
+        rows_unchecked_ = 0;
+        check_budget();
+    }
+    row_offsets_.push_back(entries_.size());
+    next_key_hint_ = 0;
+}
+
+void ResultStoreBuilder::set_memory_budget(size_t bytes, std::function<void(ResultStore&)> prepare) {
+    memory_budget_ = bytes;
+    prepare_segment_ = std::move(prepare);
+}
+
+size_t ResultStoreBuilder::memory_bytes() const {
+    size_t bytes = arena_->capacity() + entries_.capacity() * sizeof(Entry) +
+                   row_offsets_.capacity() * sizeof(size_t);
+    for (const Chunk& chunk : chunks_) {
+        bytes += chunk.rows->memory_bytes();
+    }
+    return bytes;
+}
+
+void ResultStoreBuilder::check_budget() {
+    if (memory_budget_ && memory_bytes() > memory_budget_) {
+        spill_rows();
+    }
+}
+
+void ResultStoreBuilder::spill_rows() {
+    if (!schema_ready_) {
+        if (row_count() < SCHEMA_SAMPLE_ROWS) {
+            return;
+        }
+        infer_schema();
+    }
+    if (!spill_) {
+        std::string error;
+        spill_ = SpilledColumns::Writer::create(error);
+        if (!spill_) {
+            LEAF_LOG_WARN("Keeping the result in memory: %s", error.c_str());
+            memory_budget_ = 0;
+            return;
+        }
+    }
+    
+    size_t rows = row_count();
+    if (rows > 0) {
+        ResultStore segment(std::make_shared<Arena>(1024));
+        segment.columns = columns_;
+        segment.row_count = rows;
+        segment.cells.resize(rows * columns_.size());
+        layout(segment.cells.data());
+        if (prepare_segment_) {
+            prepare_segment_(segment);
+        }
+        if (!spill_->append(segment, 0, rows)) {
+            spill_->finish(spill_error_);
+            memory_budget_ = 0;
+        }
+    }
+    
+    std::vector<Entry>().swap(entries_);
+    std::vector<size_t>().swap(row_offsets_);
+    chunks_.clear();
+    chunk_rows_ = 0;
+    arena_->reset(0);
+}
+
+
+uint32_t ResultStoreBuilder::key(std::string_view name) {
+    // Rows of a result nearly always list their fields in the same order
+    if (next_key_hint_ < key_names_.size() && key_names_[next_key_hint_] == name) {
+        return next_key_hint_++;
+    }
+    std::string owned(name);
+    auto it = key_ids_.find(owned);
+    uint32_t id;
+    if (it != key_ids_.end()) {
+        id = it->second;
+    } else {
+        id = static_cast<uint32_t>(key_names_.size());
+        key_names_.push_back(owned);
+        key_ids_.emplace(std::move(owned), id);
+    }
+    next_key_hint_ = id + 1;
+    return id;
+}
+
+void ResultStoreBuilder::append(std::unique_ptr<ResultStoreBuilder> chunk) {
+    Chunk appended;
+    appended.key_map.resize(chunk->key_names_.size());
+    for (size_t k = 0; k < appended.key_map.size(); ++k) {
+        appended.key_map[k] = key(chunk->key_names_[k]);
+    }
+    chunk_rows_ += chunk->row_count();
+    appended.rows = std::move(chunk);
+    chunks_.push_back(std::move(appended));
+    if (memory_budget_) {
+        check_budget();
+    }
+}
+
+void ResultStoreBuilder::infer_schema() {
+    // Columns are the keys seen in the sample rows, typed by their first non-null value
+    column_of_key_.assign(key_names_.size(), LazyColumns::NO_COLUMN);
+    std::vector<SQLSMALLINT> types;
+    std::vector<bool> typed;
+    size_t sampled = 0;
+    auto sample = [&](const ResultStoreBuilder& part, const uint32_t* key_map) {
+        for (size_t r = 0; r < part.row_offsets_.size() && sampled < SCHEMA_SAMPLE_ROWS; ++r, ++sampled) {
+            for (size_t e = part.row_offsets_[r]; e < part.row_end(r); ++e) {
+                const Entry& entry = part.entries_[e];
+                uint32_t& column = column_of_key_[key_map ? key_map[entry.key] : entry.key];
+                if (column == LazyColumns::NO_COLUMN) {
+                    column = static_cast<uint32_t>(types.size());
+                    types.push_back(SQL_VARCHAR); // Default
+                    typed.push_back(false);
+                }
+                if (!typed[column] && !entry.value.is_null()) {
+                    types[column] = infer_sql_type(entry.value);
+                    typed[column] = true;
+                }
+            }
+        }
+    };
+    sample(*this, nullptr);
+    for (const Chunk& chunk : chunks_) {
+        sample(*chunk.rows, chunk.key_map.data());
+    }
+
+    columns_.resize(types.size());
+    for (size_t key = 0; key < key_names_.size(); ++key) {
+        if (column_of_key_[key] == LazyColumns::NO_COLUMN) {
+            continue;
+        }
+        ColumnInfo& col_info = columns_[column_of_key_[key]];
+        col_info.name = key_names_[key];
+        col_info.sql_type = types[column_of_key_[key]];
+        col_info.column_size = infer_column_size(col_info.sql_type);
+        col_info.decimal_digits = 0;
+        col_info.nullable = SQL_NULLABLE;
+        col_info.type_name = infer_type_name(col_info.sql_type);
+    }
+    schema_ready_ = true;
+}
+
+void ResultStoreBuilder::layout(Value* cells) const {
+    // This builder's rows come first, then the appended chunks. Fields
+    // missing from a row, or absent from the sample, read as NULL.
+    size_t width = columns_.size();
+    auto place = [&](const ResultStoreBuilder& part, const uint32_t* key_map) {
+        for (size_t r = 0; r < part.row_offsets_.size(); ++r, cells += width) {
+            for (size_t e = part.row_offsets_[r]; e < part.row_end(r); ++e) {
+                uint32_t key = key_map ? key_map[part.entries_[e].key] : part.entries_[e].key;
+                // Keys first seen after the schema was fixed have no column
+                uint32_t column = key < column_of_key_.size() ? column_of_key_[key] : LazyColumns::NO_COLUMN;
+                if (column != LazyColumns::NO_COLUMN) {
+                    cells[column] = part.entries_[e].value;
+                }
+            }
+        }
+    };
+    place(*this, nullptr);
+    for (const Chunk& chunk : chunks_) {
+        place(*chunk.rows, chunk.key_map.data());
+    }
+}
+
+std::shared_ptr<ResultStore> ResultStoreBuilder::finish() {
+    if (!schema_ready_) {
+        infer_schema();
+    }
+    auto store = std::make_shared<ResultStore>(arena_);
+    store->columns = columns_;
+    
+    if (spill_) {
+        // The rest of the rows join the earlier segments in the file
+        if (spill_error_.empty()) {
+            spill_rows();
+        }
+        if (spill_error_.empty()) {
+            size_t rows = spill_->rows();
+            store->spilled = spill_->finish(spill_error_);
+            store->row_count = store->spilled ? rows : 0;
+        }
+        spill_.reset();
+        return store;
+    }
+    
+    size_t rows = row_count();
+    store->row_count = rows;
+    store->cells.resize(rows * columns_.size());
+    layout(store->cells.data());
+
+    // Cells keep pointing into the chunks' arenas
+    for (Chunk& chunk : chunks_) {
+        store->chunk_arenas.push_back(std::move(chunk.rows->arena_));
+    }
+    chunks_.clear();
+    chunk_rows_ = 0;
+    std::vector<Entry>().swap(entries_);
+    std::vector<size_t>().swap(row_offsets_);
+    return store;
+}
+
+} // namespace leafodbc
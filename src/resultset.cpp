@@ -1,152 +1,72 @@
 #include "leafodbc/resultset.h"
 #include "leafodbc/common.h"
 #include <cstring>
-#include <sstream>
-#include <iomanip>
-#include <cmath>
 #include <algorithm>
 #include <cstdint>
 
 namespace leafodbc {
 
-ResultSet::ResultSet() : current_row_(0) {
+ResultSet::ResultSet() : store_(std::make_shared<ResultStore>()), current_row_(0) {
 }
 
-void ResultSet::load_from_json(const nlohmann::json& json_data) {
-    rows_.clear();
-    columns_.clear();
-    current_row_ = 0;
-    
-    if (!json_data.is_array()) {
-        return;
-    }
-    
-    // Collect sample rows for schema inference
-    std::vector<nlohmann::json> sample_rows;
-    size_t sample_size = std::min(json_data.size(), size_t(50));
-    for (size_t i = 0; i < sample_size; ++i) {
-        sample_rows.push_back(json_data[i]);
-    }
-    
-    // Load all rows
-    for (const auto& row : json_data) {
-        rows_.push_back(row);
-    }
-    
-    // Infer schema
-    infer_schema(sample_rows);
+ResultSet::ResultSet(std::shared_ptr<const ResultStore> store) : store_(std::move(store)), current_row_(0) {
 }
 
 void ResultSet::add_row(const nlohmann::json& row) {
-    rows_.push_back(row);
-}
-
-void ResultSet::infer_schema(const std::vector<nlohmann::json>& sample_rows) {
-    if (sample_rows.empty()) {
-        return;
-    }
-    
-    // Collect all unique column names from sample rows
-    std::unordered_map<std::string, bool> column_seen;
-    for (const auto& row : sample_rows) {
-        if (row.is_object()) {
-            for (auto it = row.begin(); it != row.end(); ++it) {
-                column_seen[it.key()] = true;
-            }
-        }
-    }
-    
-    // Infer type for each column
-    for (const auto& col_pair : column_seen) {
-        const std::string& col_name = col_pair.first;
-        ColumnInfo col_info;
-        col_info.name = col_name;
-        col_info.nullable = SQL_NULLABLE;
-        col_info.sql_type = SQL_VARCHAR; // Default
-        col_info.column_size = 0;
-        col_info.decimal_digits = 0;
-        
-        // Try to infer type from sample values
-        bool found_value = false;
-        for (const auto& row : sample_rows) {
-            if (row.is_object() && row.contains(col_name)) {
-                const auto& value = row[col_name];
-                if (!value.is_null()) {
-                    col_info.sql_type = infer_sql_type(value);
-                    found_value = true;
-                    break;
-                }
-            }
-        }
-        
-        col_info.type_name = infer_type_name(col_info.sql_type);
-        col_info.column_size = infer_column_size(col_info.sql_type);
-        
-        columns_.push_back(col_info);
+    ResultStore& store = mutable_store();
+    for (const auto& col : store.columns) {
+        auto it = row.find(col.name);
+        store.cells.push_back(it != row.end() ? Value::from_json(*it, *store.arena) : Value());
     }
+    store.row_count++;
 }
 
-SQLSMALLINT ResultSet::infer_sql_type(const nlohmann::json& value) const {
-    if (value.is_null()) {
-        return SQL_VARCHAR;
-    } else if (value.is_boolean()) {
-        return SQL_BIT;
-    } else if (value.is_number_integer()) {
-        int64_t v = value.get<int64_t>();
-        if (v >= INT32_MIN && v <= INT32_MAX) {
-            return SQL_INTEGER;
-        } else {
-            return SQL_BIGINT;
-        }
-    } else if (value.is_number_float()) {
-        return SQL_DOUBLE;
-    } else if (value.is_string()) {
-        std::string str = value.get<std::string>();
-        if (str.length() > 4000) {
-            return SQL_LONGVARCHAR;
-        } else {
-            return SQL_VARCHAR;
-        }
-    } else {
-        // Objects/arrays -> JSON string
-        return SQL_LONGVARCHAR;
-    }
+SQLRETURN ResultSet::fetch() {
+    return fetch_scroll(SQL_FETCH_NEXT, 0);
 }
 
-std::string ResultSet::infer_type_name(SQLSMALLINT sql_type) const {
-    switch (sql_type) {
-        case SQL_BIT: return "BIT";
-        case SQL_INTEGER: return "INTEGER";
-        case SQL_BIGINT: return "BIGINT";
-        case SQL_DOUBLE: return "DOUBLE";
-        case SQL_VARCHAR: return "VARCHAR";
-        case SQL_LONGVARCHAR: return "LONGVARCHAR";
-        default: return "VARCHAR";
+SQLRETURN ResultSet::fetch_scroll(SQLSMALLINT orientation, SQLLEN offset) {
+    // Signed positions: 0 is before the first row, rows + 1 after the last
+    int64_t rows = static_cast<int64_t>(store_->row_count);
+    int64_t current = static_cast<int64_t>(current_row_);
+    int64_t target;
+    switch (orientation) {
+        case SQL_FETCH_NEXT:
+            target = current + 1;
+            break;
+        case SQL_FETCH_PRIOR:
+            target = current - 1;
+            break;
+        case SQL_FETCH_FIRST:
+            target = 1;
+            break;
+        case SQL_FETCH_LAST:
+            target = rows;
+            break;
+        case SQL_FETCH_ABSOLUTE:
+            // Negative offsets count back from the end
+            target = offset < 0 ? rows + 1 + offset : offset;
+            break;
+        case SQL_FETCH_RELATIVE:
+            target = current + offset;
+            break;
+        default:
+            return SQL_ERROR;
     }
-}
-
-SQLULEN ResultSet::infer_column_size(SQLSMALLINT sql_type) const {
-    switch (sql_type) {
-        case SQL_BIT: return 1;
-        case SQL_INTEGER: return 10;
-        case SQL_BIGINT: return 19;
-        case SQL_DOUBLE: return 15;
-        case SQL_VARCHAR: return 4000;
-        case SQL_LONGVARCHAR: return 0; // Variable length
-        default: return 4000;
+    if (target < 1) {
+        current_row_ = 0;
+        return SQL_NO_DATA;
     }
-}
-
-SQLRETURN ResultSet::fetch() {
-    if (current_row_ >= rows_.size()) {
+    if (target > rows) {
+        current_row_ = static_cast<SQLULEN>(rows + 1);
         return SQL_NO_DATA;
     }
-    current_row_++;
+    current_row_ = static_cast<SQLULEN>(target);
     return SQL_SUCCESS;
 }
 
 bool ResultSet::has_column(const std::string& name) const {
-    for (const auto& col : columns_) {
+    for (const auto& col : store_->columns) {
         if (col.name == name) {
             return true;
         }
@@ -155,8 +75,9 @@ bool ResultSet::has_column(const std::string& name) const {
 }
 
 SQLUSMALLINT ResultSet::get_column_index(const std::string& name) const {
-    for (size_t i = 0; i < columns_.size(); ++i) {
-        if (columns_[i].name == name) {
+    const auto& columns = store_->columns;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (columns[i].name == name) {
             return static_cast<SQLUSMALLINT>(i + 1); // 1-based
         }
     }
@@ -165,38 +86,27 @@ SQLUSMALLINT ResultSet::get_column_index(const std::string& name) const {
 
 const ColumnInfo& ResultSet::get_column_info(SQLUSMALLINT column_number) const {
     static ColumnInfo dummy;
-    if (column_number < 1 || column_number > columns_.size()) {
+    if (column_number < 1 || column_number > store_->columns.size()) {
         return dummy;
     }
-    return columns_[column_number - 1];
+    return store_->columns[column_number - 1];
 }
 
 SQLRETURN ResultSet::get_data(SQLUSMALLINT column_number, SQLSMALLINT target_type,
                               SQLPOINTER target_value_ptr, SQLLEN buffer_length,
                               SQLLEN* str_len_or_ind_ptr) {
-    if (current_row_ == 0 || current_row_ > rows_.size()) {
+    const ResultStore& store = *store_;
+    if (current_row_ == 0 || current_row_ > store.row_count) {
         return SQL_ERROR;
     }
     
-    if (column_number < 1 || column_number > columns_.size()) {
+    if (column_number < 1 || column_number > store.columns.size()) {
         return SQL_ERROR;
     }
     
-    const ColumnInfo& col_info = columns_[column_number - 1];
-    const nlohmann::json& row = rows_[current_row_ - 1];
-    
-    nlohmann::json value;
-    if (row.is_object() && row.contains(col_info.name)) {
-        value = row[col_info.name];
-    } else {
-        // Column not present in this row
-        if (str_len_or_ind_ptr) {
-            *str_len_or_ind_ptr = SQL_NULL_DATA;
-        }
-        return SQL_SUCCESS;
-    }
-    
+    Value value = store.cell(current_row_ - 1, column_number - 1);
     if (value.is_null()) {
+        // Also fields the row did not have
         if (str_len_or_ind_ptr) {
             *str_len_or_ind_ptr = SQL_NULL_DATA;
         }
@@ -207,7 +117,7 @@ SQLRETURN ResultSet::get_data(SQLUSMALLINT column_number, SQLSMALLINT target_typ
            ? SQL_SUCCESS : SQL_ERROR;
 }
 
-bool ResultSet::convert_value(const nlohmann::json& value, SQLSMALLINT target_type,
+bool ResultSet::convert_value(const Value& value, SQLSMALLINT target_type,
                               SQLPOINTER target_value_ptr, SQLLEN buffer_length,
                               SQLLEN* str_len_or_ind_ptr) const {
     if (!target_value_ptr) {
@@ -224,12 +134,10 @@ bool ResultSet::convert_value(const nlohmann::json& value, SQLSMALLINT target_ty
         case SQL_C_WCHAR:
         case SQL_VARCHAR:
         case SQL_LONGVARCHAR: {
-            if (value.is_string()) {
-                str_value = value.get<std::string>();
-            } else if (value.is_number()) {
-                str_value = value.dump();
-            } else if (value.is_boolean()) {
-                str_value = value.get<bool>() ? "1" : "0";
+            if (value.kind == Value::Kind::String) {
+                str_value = value.str();
+            } else if (value.kind == Value::Kind::Bool) {
+                str_value = value.b ? "1" : "0";
             } else {
                 str_value = value.dump();
             }
@@ -246,12 +154,12 @@ bool ResultSet::convert_value(const nlohmann::json& value, SQLSMALLINT target_ty
         
         case SQL_C_BIT: {
             bool bool_val = false;
-            if (value.is_boolean()) {
-                bool_val = value.get<bool>();
+            if (value.kind == Value::Kind::Bool) {
+                bool_val = value.b;
             } else if (value.is_number()) {
-                bool_val = (value.get<int64_t>() != 0);
-            } else if (value.is_string()) {
-                std::string s = value.get<std::string>();
+                bool_val = (value.as_int64() != 0);
+            } else if (value.kind == Value::Kind::String) {
+                std::string_view s = value.str();
                 bool_val = (s == "true" || s == "1" || s == "yes");
             }
             *static_cast<unsigned char*>(target_value_ptr) = bool_val ? 1 : 0;
@@ -264,13 +172,11 @@ bool ResultSet::convert_value(const nlohmann::json& value, SQLSMALLINT target_ty
         case SQL_C_LONG:
         case SQL_C_SLONG: {
             int32_t int_val = 0;
-            if (value.is_number_integer()) {
-                int_val = static_cast<int32_t>(value.get<int64_t>());
-            } else if (value.is_number_float()) {
-                int_val = static_cast<int32_t>(value.get<double>());
-            } else if (value.is_string()) {
+            if (value.is_number()) {
+                int_val = static_cast<int32_t>(value.as_int64());
+            } else if (value.kind == Value::Kind::String) {
                 try {
-                    int_val = std::stoi(value.get<std::string>());
+                    int_val = std::stoi(std::string(value.str()));
                 } catch (...) {
                     return false;
                 }
@@ -285,13 +191,11 @@ bool ResultSet::convert_value(const nlohmann::json& value, SQLSMALLINT target_ty
         case SQL_C_SBIGINT:
         case SQL_BIGINT: {
             int64_t bigint_val = 0;
-            if (value.is_number_integer()) {
-                bigint_val = value.get<int64_t>();
-            } else if (value.is_number_float()) {
-                bigint_val = static_cast<int64_t>(value.get<double>());
-            } else if (value.is_string()) {
+            if (value.is_number()) {
+                bigint_val = value.as_int64();
+            } else if (value.kind == Value::Kind::String) {
                 try {
-                    bigint_val = std::stoll(value.get<std::string>());
+                    bigint_val = std::stoll(std::string(value.str()));
                 } catch (...) {
                     return false;
                 }
@@ -306,10 +210,10 @@ bool ResultSet::convert_value(const nlohmann::json& value, SQLSMALLINT target_ty
         case SQL_C_DOUBLE: {
             double double_val = 0.0;
             if (value.is_number()) {
-                double_val = value.get<double>();
-            } else if (value.is_string()) {
+                double_val = value.as_double();
+            } else if (value.kind == Value::Kind::String) {
                 try {
-                    double_val = std::stod(value.get<std::string>());
+                    double_val = std::stod(std::string(value.str()));
                 } catch (...) {
                     return false;
                 }
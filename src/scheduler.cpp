@@ -0,0 +1,400 @@
+#include "leafodbc/scheduler.h"
+#include "leafodbc/metrics.h"
+#include "leafodbc/timings.h"
+#include "leafodbc/trace.h"
+#include "leafodbc/cancel.h"
+#include "leafodbc/reactor.h"
+#include "leafodbc/task_pool.h"
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <vector>
+
+namespace leafodbc {
+
+namespace {
+
+// How often a waiter with a cancel token checks it
+constexpr std::chrono::milliseconds CANCEL_CHECK{100};
+
+void note_admission(const std::string& endpoint, RequestPriority priority, int64_t trace_start_us,
+                    int64_t wait_us) {
+    auto& metrics = Metrics::instance();
+    metrics.scheduler_queue_depth.dec();
+    metrics.scheduler_wait.observe_us(wait_us);
+    if (trace_start_us >= 0) {
+        Tracer::instance().record("queue_wait", "http", trace_start_us, wait_us,
+                                  "priority", static_cast<int64_t>(priority));
+    }
+    if (wait_us >= 1000) {
+        LEAF_LOG_DEBUG("Request to %s waited %lld us for admission (priority %d)", endpoint.c_str(),
+                       static_cast<long long>(wait_us), static_cast<int>(priority));
+    }
+}
+
+} // namespace
+
+struct SchedulerEndpoint {
+    struct Waiter {
+        int priority;
+        uint64_t seq;
+        const std::string* user;
+    };
+
+    // Waiter of acquire_async; `waiter.user` points at `user`
+    struct AsyncWaiter {
+        SchedulerEndpoint::Waiter waiter;
+        std::string user;
+        std::string endpoint;
+        std::shared_ptr<const CancelToken> cancel;
+        RequestScheduler::Admitted admitted;
+        std::chrono::steady_clock::time_point start;
+        int64_t trace_start_us;
+    };
+
+    std::condition_variable cv;
+    SchedulerLimits limits;
+
+    // Token bucket
+    double tokens = 0;
+    bool bucket_started = false;
+    std::chrono::steady_clock::time_point last_refill;
+
+    int inflight = 0;
+    std::unordered_map<std::string, int> inflight_by_user;
+    std::vector<Waiter> waiters; // Of both acquire and acquire_async
+    std::list<AsyncWaiter> async_waiters; // In arrival order
+    bool recheck_pending = false;
+    uint64_t next_seq = 0;
+
+    int burst() const {
+        return limits.rate_limit_burst > 0 ? limits.rate_limit_burst : std::max(1, limits.rate_limit_per_sec);
+    }
+
+    void refill(std::chrono::steady_clock::time_point now) {
+        if (limits.rate_limit_per_sec <= 0) {
+            return;
+        }
+        if (!bucket_started) {
+            tokens = burst();
+            bucket_started = true;
+        } else {
+            double elapsed = std::chrono::duration<double>(now - last_refill).count();
+            tokens = std::min<double>(burst(), tokens + elapsed * limits.rate_limit_per_sec);
+        }
+        last_refill = now;
+    }
+
+    bool user_has_room(const std::string& user) const {
+        if (limits.max_inflight_per_user <= 0) {
+            return true;
+        }
+        auto it = inflight_by_user.find(user);
+        return it == inflight_by_user.end() || it->second < limits.max_inflight_per_user;
+    }
+
+    // A waiter may go once the shared limits allow it and every waiter ahead
+    // of it is held back only by its own user cap
+    bool may_admit(const Waiter& self) const {
+        if (limits.max_inflight_per_endpoint > 0 && inflight >= limits.max_inflight_per_endpoint) {
+            return false;
+        }
+        if (!user_has_room(*self.user)) {
+            return false;
+        }
+        for (const auto& w : waiters) {
+            bool ahead = w.priority < self.priority || (w.priority == self.priority && w.seq < self.seq);
+            if (ahead && user_has_room(*w.user)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+RequestScheduler& RequestScheduler::instance() {
+    static RequestScheduler scheduler;
+    return scheduler;
+}
+
+RequestScheduler::Ticket::Ticket(Ticket&& other) noexcept
+    : endpoint_(other.endpoint_), user_(std::move(other.user_)), wait_us_(other.wait_us_) {
+    other.endpoint_ = nullptr;
+}
+
+RequestScheduler::Ticket& RequestScheduler::Ticket::operator=(Ticket&& other) noexcept {
+    if (this != &other) {
+        release();
+        endpoint_ = other.endpoint_;
+        user_ = std::move(other.user_);
+        wait_us_ = other.wait_us_;
+        other.endpoint_ = nullptr;
+    }
+    return *this;
+}
+
+RequestScheduler::Ticket::~Ticket() {
+    release();
+}
+
+void RequestScheduler::Ticket::release() {
+    if (!endpoint_) {
+        return;
+    }
+    auto& scheduler = RequestScheduler::instance();
+    Ready ready;
+    {
+        std::lock_guard<std::mutex> lock(scheduler.mutex_);
+        endpoint_->inflight--;
+        auto it = endpoint_->inflight_by_user.find(user_);
+        if (it != endpoint_->inflight_by_user.end() && --it->second <= 0) {
+            endpoint_->inflight_by_user.erase(it);
+        }
+        // The freed slot goes to the next waiter even if that is an
+        // asynchronous one with no thread of its own
+        scheduler.admit_async(endpoint_, ready);
+    }
+    endpoint_->cv.notify_all();
+    endpoint_ = nullptr;
+    start_ready(ready);
+}
+
+SchedulerEndpoint* RequestScheduler::endpoint_state(const std::string& endpoint, const SchedulerLimits& limits) {
+    auto& slot = endpoints_[endpoint];
+    if (!slot) {
+        slot = std::make_unique<SchedulerEndpoint>();
+    }
+    slot->limits = limits;
+    return slot.get();
+}
+
+bool RequestScheduler::try_acquire(const std::string& endpoint, const std::string& user,
+                                   RequestPriority priority, const SchedulerLimits& limits, Ticket& ticket) {
+    ticket = Ticket();
+    if (limits.unlimited()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    SchedulerEndpoint* ep = endpoint_state(endpoint, limits);
+    // Ranked behind everyone already waiting
+    SchedulerEndpoint::Waiter self{static_cast<int>(priority), ep->next_seq, &user};
+    ep->refill(std::chrono::steady_clock::now());
+    bool rate_limited = ep->limits.rate_limit_per_sec > 0;
+    if (!ep->may_admit(self) || (rate_limited && ep->tokens < 1.0)) {
+        return false;
+    }
+    if (rate_limited) {
+        ep->tokens -= 1.0;
+    }
+    ep->inflight++;
+    ep->inflight_by_user[user]++;
+    ticket.endpoint_ = ep;
+    ticket.user_ = user;
+    return true;
+}
+
+RequestScheduler::Ticket RequestScheduler::acquire(const std::string& endpoint, const std::string& user,
+                                                   RequestPriority priority, const SchedulerLimits& limits,
+                                                   const CancelToken* cancel) {
+    Ticket ticket;
+    if (limits.unlimited()) {
+        return ticket;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int64_t trace_start_us = trace_enabled() ? trace_now_us() : -1;
+    auto& metrics = Metrics::instance();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    SchedulerEndpoint* ep = endpoint_state(endpoint, limits);
+
+    SchedulerEndpoint::Waiter self{static_cast<int>(priority), ep->next_seq++, &user};
+    ep->waiters.push_back(self);
+    metrics.scheduler_queue_depth.inc();
+
+    // SQLCancel does not know which endpoint a statement waits on, so a
+    // cancellable waiter wakes up periodically to check for it
+    bool stopped = false;
+
+    while (true) {
+        if (cancel && cancel->stop_requested()) {
+            stopped = true;
+            break;
+        }
+        auto now = std::chrono::steady_clock::now();
+        ep->refill(now);
+        bool rate_limited = ep->limits.rate_limit_per_sec > 0;
+
+        if (ep->may_admit(self)) {
+            if (!rate_limited || ep->tokens >= 1.0) {
+                if (rate_limited) {
+                    ep->tokens -= 1.0;
+                }
+                break;
+            }
+            // Only the token bucket is in the way: sleep until the next token
+            std::chrono::duration<double> wait((1.0 - ep->tokens) / ep->limits.rate_limit_per_sec);
+            if (cancel) {
+                wait = std::min<std::chrono::duration<double>>(wait, CANCEL_CHECK);
+            }
+            ep->cv.wait_for(lock, wait);
+        } else if (cancel) {
+            ep->cv.wait_for(lock, CANCEL_CHECK);
+        } else {
+            ep->cv.wait(lock);
+        }
+    }
+
+    ep->waiters.erase(std::find_if(ep->waiters.begin(), ep->waiters.end(),
+                                   [&](const SchedulerEndpoint::Waiter& w) { return w.seq == self.seq; }));
+    Ready ready;
+    if (stopped) {
+        // Waiters ranked behind this one may be admissible now
+        admit_async(ep, ready);
+        lock.unlock();
+        ep->cv.notify_all();
+        start_ready(ready);
+        metrics.scheduler_queue_depth.dec();
+        return ticket;
+    }
+    ep->inflight++;
+    ep->inflight_by_user[user]++;
+    // Admission order changed, so the next waiter may now be at the front
+    admit_async(ep, ready);
+    lock.unlock();
+    ep->cv.notify_all();
+    start_ready(ready);
+
+    ticket.endpoint_ = ep;
+    ticket.user_ = user;
+    ticket.wait_us_ = elapsed_us(start);
+    note_admission(endpoint, priority, trace_start_us, ticket.wait_us_);
+    return ticket;
+}
+
+void RequestScheduler::acquire_async(const std::string& endpoint, const std::string& user,
+                                     RequestPriority priority, const SchedulerLimits& limits,
+                                     std::shared_ptr<const CancelToken> cancel, Admitted admitted) {
+    if (limits.unlimited()) {
+        admitted(Ticket());
+        return;
+    }
+
+    Ready ready;
+    SchedulerEndpoint* ep = nullptr;
+    std::chrono::milliseconds recheck;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ep = endpoint_state(endpoint, limits);
+        ep->async_waiters.push_back(SchedulerEndpoint::AsyncWaiter{
+            SchedulerEndpoint::Waiter{static_cast<int>(priority), ep->next_seq++, nullptr}, user, endpoint,
+            std::move(cancel), std::move(admitted), std::chrono::steady_clock::now(),
+            trace_enabled() ? trace_now_us() : -1});
+        auto& waiter = ep->async_waiters.back();
+        waiter.waiter.user = &waiter.user;
+        ep->waiters.push_back(waiter.waiter);
+        Metrics::instance().scheduler_queue_depth.inc();
+        admit_async(ep, ready);
+        recheck = recheck_delay(ep);
+    }
+    recheck_after(ep, recheck);
+    // Admitted right away, so the caller starts the request itself
+    for (auto& [ticket, callback] : ready) {
+        callback(std::move(ticket));
+    }
+}
+
+void RequestScheduler::admit_async(SchedulerEndpoint* ep, Ready& ready) {
+    if (ep->async_waiters.empty()) {
+        return;
+    }
+    ep->refill(std::chrono::steady_clock::now());
+    bool rate_limited = ep->limits.rate_limit_per_sec > 0;
+    // The list is in arrival order, not rank, so each admission starts over:
+    // it may unblock a waiter that was ranked behind the admitted one
+    auto next = ep->async_waiters.begin();
+    while (next != ep->async_waiters.end()) {
+        auto it = next++;
+        auto& waiter = *it;
+        bool stopped = waiter.cancel && waiter.cancel->stop_requested();
+        if (!stopped && (!ep->may_admit(waiter.waiter) || (rate_limited && ep->tokens < 1.0))) {
+            continue;
+        }
+        ep->waiters.erase(std::find_if(ep->waiters.begin(), ep->waiters.end(), [&](const SchedulerEndpoint::Waiter& w) {
+            return w.seq == waiter.waiter.seq;
+        }));
+        Ticket ticket;
+        if (stopped) {
+            Metrics::instance().scheduler_queue_depth.dec();
+        } else {
+            if (rate_limited) {
+                ep->tokens -= 1.0;
+            }
+            ep->inflight++;
+            ep->inflight_by_user[waiter.user]++;
+            ticket.endpoint_ = ep;
+            ticket.user_ = waiter.user;
+            ticket.wait_us_ = elapsed_us(waiter.start);
+            note_admission(waiter.endpoint, static_cast<RequestPriority>(waiter.waiter.priority),
+                           waiter.trace_start_us, ticket.wait_us_);
+        }
+        ready.emplace_back(std::move(ticket), std::move(waiter.admitted));
+        ep->async_waiters.erase(it);
+        next = ep->async_waiters.begin();
+    }
+}
+
+void RequestScheduler::start_ready(Ready& ready) {
+    for (auto& entry : ready) {
+        auto started = std::make_shared<std::pair<Ticket, Admitted>>(std::move(entry));
+        TaskPool::instance().submit([started] { started->second(std::move(started->first)); });
+    }
+    ready.clear();
+}
+
+std::chrono::milliseconds RequestScheduler::recheck_delay(SchedulerEndpoint* ep) {
+    if (ep->recheck_pending || ep->async_waiters.empty()) {
+        return std::chrono::milliseconds::zero();
+    }
+    auto delay = std::chrono::milliseconds::max();
+    if (ep->limits.rate_limit_per_sec > 0 && ep->tokens < 1.0) {
+        // Time until the next token, rounded up
+        delay = std::chrono::milliseconds(
+            static_cast<int64_t>((1.0 - ep->tokens) * 1000.0 / ep->limits.rate_limit_per_sec) + 1);
+    }
+    for (const auto& waiter : ep->async_waiters) {
+        if (waiter.cancel) {
+            delay = std::min(delay, CANCEL_CHECK);
+            break;
+        }
+    }
+    if (delay == std::chrono::milliseconds::max()) {
+        // Only a released ticket can admit the waiters
+        return std::chrono::milliseconds::zero();
+    }
+    ep->recheck_pending = true;
+    return delay;
+}
+
+void RequestScheduler::recheck_after(SchedulerEndpoint* ep, std::chrono::milliseconds delay) {
+    if (delay <= std::chrono::milliseconds::zero()) {
+        return;
+    }
+    Reactor::instance().post_after(delay, [this, ep] {
+        Ready ready;
+        std::chrono::milliseconds next;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ep->recheck_pending = false;
+            admit_async(ep, ready);
+            next = recheck_delay(ep);
+        }
+        ep->cv.notify_all();
+        start_ready(ready);
+        recheck_after(ep, next);
+    });
+}
+
+} // namespace leafodbc
@@ -0,0 +1,179 @@
+#include "leafodbc/session_pool.h"
+#include "leafodbc/handles.h"
+#include "leafodbc/metrics.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <random>
+
+namespace leafodbc {
+
+namespace {
+
+constexpr size_t SALT_BYTES = 16;
+
+// SHA-256 (FIPS 180-4)
+std::string sha256(const std::string& message) {
+    static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+
+    std::string data = message;
+    uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+    data += static_cast<char>(0x80);
+    while (data.size() % 64 != 56) {
+        data += '\0';
+    }
+    for (int i = 7; i >= 0; --i) {
+        data += static_cast<char>((bits >> (i * 8)) & 0xff);
+    }
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = reinterpret_cast<const unsigned char*>(data.data() + block + i * 4);
+            w[i] = (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | p[3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            k = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+    }
+
+    std::string digest(32, '\0');
+    for (int i = 0; i < 32; ++i) {
+        digest[i] = static_cast<char>((h[i / 4] >> (24 - (i % 4) * 8)) & 0xff);
+    }
+    return digest;
+}
+
+// Compares without stopping at the first difference
+bool same_hash(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+} // namespace
+
+SessionPool& SessionPool::instance() {
+    static SessionPool pool;
+    return pool;
+}
+
+SessionPool::SessionPool() {
+    std::random_device random;
+    salt_.resize(SALT_BYTES);
+    for (auto& byte : salt_) {
+        byte = static_cast<char>(random() & 0xff);
+    }
+}
+
+std::string SessionPool::hash_password(const std::string& password) const {
+    return sha256(salt_ + password);
+}
+
+std::string SessionPool::make_key(const ConnHandle& conn) {
+    std::string key;
+    key += conn.endpoint_base;
+    key += '\n';
+    key += conn.username;
+    key += '\n';
+    key += conn.sql_engine;
+    key += '\n';
+    key += conn.user_agent;
+    key += '\n';
+    key += conn.verify_tls ? '1' : '0';
+    key += conn.remember_me ? '1' : '0';
+    return key;
+}
+
+bool SessionPool::acquire(const std::string& key, const std::string& password, PooledSession& session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict_expired(Clock::now());
+    
+    auto it = idle_.find(key);
+    if (it == idle_.end()) {
+        return false;
+    }
+    // Most recently parked first: its token is the freshest
+    std::string password_hash = hash_password(password);
+    auto& entries = it->second;
+    for (size_t i = entries.size(); i-- > 0;) {
+        if (!same_hash(entries[i].password_hash, password_hash)) {
+            continue;
+        }
+        session = std::move(entries[i].session);
+        entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(i));
+        if (entries.empty()) {
+            idle_.erase(it);
+        }
+        Metrics::instance().pooled_sessions.dec();
+        Metrics::instance().sessions_reused.add();
+        return true;
+    }
+    return false;
+}
+
+void SessionPool::release(const std::string& key, const std::string& password, PooledSession session,
+                          int idle_sec) {
+    if (idle_sec <= 0 || session.auth_token.empty()) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    Clock::time_point now = Clock::now();
+    evict_expired(now);
+    
+    auto& entries = idle_[key];
+    if (entries.size() >= MAX_IDLE_PER_KEY) {
+        entries.erase(entries.begin());
+        Metrics::instance().pooled_sessions.dec();
+    }
+    entries.push_back(Entry{hash_password(password), std::move(session), now + std::chrono::seconds(idle_sec)});
+    Metrics::instance().pooled_sessions.inc();
+}
+
+void SessionPool::evict_expired(Clock::time_point now) {
+    for (auto it = idle_.begin(); it != idle_.end();) {
+        auto& entries = it->second;
+        size_t before = entries.size();
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [now](const Entry& entry) { return entry.expires <= now; }),
+                      entries.end());
+        Metrics::instance().pooled_sessions.dec(static_cast<int64_t>(before - entries.size()));
+        it = entries.empty() ? idle_.erase(it) : std::next(it);
+    }
+}
+
+} // namespace leafodbc
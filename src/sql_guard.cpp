@@ -1,10 +1,205 @@
 #include "leafodbc/sql_guard.h"
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <cstring>
 
 namespace leafodbc {
 
+namespace {
+
+// Lexical token of a statement; comments and whitespace are skipped
+struct SqlToken {
+    size_t begin;
+    size_t end;
+    int depth; // Parenthesis nesting
+};
+
+std::vector<SqlToken> tokenize(const std::string& sql) {
+    std::vector<SqlToken> tokens;
+    int depth = 0;
+    size_t i = 0;
+    while (i < sql.size()) {
+        char c = sql[i];
+        size_t start = i;
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+            continue;
+        }
+        if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+            size_t eol = sql.find('\n', i);
+            i = (eol == std::string::npos) ? sql.size() : eol + 1;
+            continue;
+        }
+        if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+            size_t close = sql.find("*/", i + 2);
+            i = (close == std::string::npos) ? sql.size() : close + 2;
+            continue;
+        }
+        if (c == '\'' || c == '"' || c == '`') {
+            // Doubled quotes read as two adjacent literals, which is harmless here
+            size_t close = sql.find(c, i + 1);
+            i = (close == std::string::npos) ? sql.size() : close + 1;
+        } else if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '_' ||
+                                      sql[i] == '.' || sql[i] == '$')) {
+                i++;
+            }
+        } else {
+            if (c == ')') {
+                depth--;
+            }
+            i++;
+        }
+        tokens.push_back(SqlToken{start, i, depth});
+        if (c == '(') {
+            depth++;
+        }
+    }
+    return tokens;
+}
+
+bool token_is(const std::string& sql, const SqlToken& token, const char* word) {
+    size_t len = strlen(word);
+    if (token.end - token.begin != len) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (std::toupper(static_cast<unsigned char>(sql[token.begin + i])) != word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool token_is_number(const std::string& sql, const SqlToken& token) {
+    for (size_t i = token.begin; i < token.end; i++) {
+        if (!std::isdigit(static_cast<unsigned char>(sql[i]))) {
+            return false;
+        }
+    }
+    return token.end > token.begin;
+}
+
+// Arguments of the call whose opening parenthesis is tokens[open], as token
+// ranges [first, last), and the index of its closing parenthesis. False if
+// the call is not closed or has an empty argument.
+bool call_arguments(const std::string& sql, const std::vector<SqlToken>& tokens, size_t open,
+                    std::vector<std::pair<size_t, size_t>>& args, size_t& close) {
+    args.clear();
+    int inner = tokens[open].depth + 1;
+    size_t first = open + 1;
+    for (size_t i = open + 1; i < tokens.size(); i++) {
+        bool end = tokens[i].depth < inner;
+        if (end || (tokens[i].depth == inner && sql[tokens[i].begin] == ',')) {
+            if (i == first) {
+                return false;
+            }
+            args.emplace_back(first, i);
+            first = i + 1;
+        }
+        if (end) {
+            close = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Numeric literal spanning tokens [first, last), sign included
+bool parse_number(const std::string& sql, const std::vector<SqlToken>& tokens, size_t first, size_t last,
+                  double& value) {
+    const char* begin = sql.data() + tokens[first].begin;
+    const char* end = sql.data() + tokens[last - 1].end;
+    if (*begin == '+') {
+        begin++;
+    }
+    auto parsed = std::from_chars(begin, end, value);
+    return parsed.ec == std::errc() && parsed.ptr == end;
+}
+
+// Envelope call starting at tokens[at]: ST_MakeEnvelope or ST_PolygonFromEnvelope
+// with four coordinates and an optional SRID
+bool parse_envelope(const std::string& sql, const std::vector<SqlToken>& tokens, size_t at, size_t end,
+                    EnvelopeFilter& filter) {
+    if (at + 1 >= end ||
+        !(token_is(sql, tokens[at], "ST_MAKEENVELOPE") || token_is(sql, tokens[at], "ST_POLYGONFROMENVELOPE")) ||
+        sql[tokens[at + 1].begin] != '(') {
+        return false;
+    }
+    std::vector<std::pair<size_t, size_t>> args;
+    size_t close = 0;
+    if (!call_arguments(sql, tokens, at + 1, args, close) || close + 1 != end ||
+        (args.size() != 4 && args.size() != 5)) {
+        return false;
+    }
+    double* coordinates[] = {&filter.min_x, &filter.min_y, &filter.max_x, &filter.max_y};
+    for (size_t i = 0; i < 4; i++) {
+        if (!parse_number(sql, tokens, args[i].first, args[i].second, *coordinates[i])) {
+            return false;
+        }
+    }
+    filter.args_begin = tokens[args[0].first].begin;
+    filter.args_end = tokens[args[3].second - 1].end;
+    return filter.min_x <= filter.max_x && filter.min_y <= filter.max_y;
+}
+
+// Column reference filling tokens [first, last): one identifier, maybe
+// qualified or quoted
+bool parse_column(const std::string& sql, const std::vector<SqlToken>& tokens, size_t first, size_t last,
+                  std::string& column) {
+    if (last == first + 2 && sql[tokens[first].end - 1] == '.') {
+        first++; // Qualifier of a quoted name
+    }
+    if (last != first + 1) {
+        return false;
+    }
+    std::string name = sql.substr(tokens[first].begin, tokens[first].end - tokens[first].begin);
+    if (name.size() >= 2 && (name[0] == '"' || name[0] == '`')) {
+        name = name.substr(1, name.size() - 2);
+    } else if (!std::isalpha(static_cast<unsigned char>(name[0])) && name[0] != '_') {
+        return false;
+    } else {
+        size_t dot = name.rfind('.');
+        if (dot != std::string::npos) {
+            name = name.substr(dot + 1);
+        }
+    }
+    column = name;
+    return !column.empty();
+}
+
+// Whether the select list, up to the top-level FROM, returns `column` under
+// its own name: through *, table.* or the column itself
+bool selects_column(const std::string& sql, const std::vector<SqlToken>& tokens, const std::string& column) {
+    size_t first = 1;
+    for (size_t i = 1; i < tokens.size(); i++) {
+        bool from = tokens[i].depth == 0 && token_is(sql, tokens[i], "FROM");
+        if (!from && !(tokens[i].depth == 0 && sql[tokens[i].begin] == ',')) {
+            continue;
+        }
+        size_t last = i;
+        if (last > first && sql[tokens[last - 1].begin] == '*' &&
+            (last == first + 1 || (last == first + 2 && sql[tokens[first].end - 1] == '.'))) {
+            return true;
+        }
+        std::string name;
+        if (parse_column(sql, tokens, first, last, name) && name.size() == column.size() &&
+            std::equal(name.begin(), name.end(), column.begin(), [](char a, char b) {
+                return std::toupper(static_cast<unsigned char>(a)) == std::toupper(static_cast<unsigned char>(b));
+            })) {
+            return true;
+        }
+        if (from) {
+            return false;
+        }
+        first = i + 1;
+    }
+    return false;
+}
+
+} // namespace
+
 std::string SQLGuard::trim(const std::string& str) {
     size_t first = str.find_first_not_of(" \t\r\n");
     if (first == std::string::npos) return "";
@@ -38,6 +233,181 @@ bool SQLGuard::is_select(const std::string& sql) {
     return false;
 }
 
+std::vector<std::string> SQLGuard::split_statements(const std::string& sql) {
+    std::vector<std::string> statements;
+    size_t start = 0;
+    size_t i = 0;
+    auto add = [&](size_t end) {
+        std::string statement = trim(sql.substr(start, end - start));
+        if (!statement.empty()) {
+            statements.push_back(std::move(statement));
+        }
+        start = end + 1;
+    };
+    
+    while (i < sql.size()) {
+        char c = sql[i];
+        if (c == '\'' || c == '"') {
+            // Quotes are escaped by doubling them, which this loop skips as two strings
+            size_t close = sql.find(c, i + 1);
+            i = (close == std::string::npos) ? sql.size() : close + 1;
+        } else if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+            size_t eol = sql.find('\n', i);
+            i = (eol == std::string::npos) ? sql.size() : eol + 1;
+        } else if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+            size_t close = sql.find("*/", i + 2);
+            i = (close == std::string::npos) ? sql.size() : close + 2;
+        } else {
+            if (c == ';') {
+                add(i);
+            }
+            i++;
+        }
+    }
+    add(sql.size());
+    return statements;
+}
+
+std::string SQLGuard::apply_row_limit(const std::string& sql, size_t max_rows) {
+    std::vector<SqlToken> tokens = tokenize(sql);
+    while (!tokens.empty() && sql[tokens.back().begin] == ';') {
+        tokens.pop_back();
+    }
+    if (max_rows == 0 || tokens.empty()) {
+        return sql;
+    }
+    // Trailing comments and semicolons are dropped with the rest of the tail
+    std::string body = sql.substr(0, tokens.back().end);
+    std::string limit = std::to_string(max_rows);
+    
+    // The last top-level LIMIT is the statement's own; those in subqueries are nested
+    size_t limit_at = tokens.size();
+    bool other_limit = false;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (tokens[i].depth != 0) {
+            continue;
+        }
+        if (token_is(sql, tokens[i], "LIMIT")) {
+            limit_at = i;
+        } else if (token_is(sql, tokens[i], "FETCH") || token_is(sql, tokens[i], "TOP")) {
+            other_limit = true;
+        }
+    }
+    
+    if (limit_at < tokens.size() && !other_limit) {
+        // LIMIT n [OFFSET m], or LIMIT m, n
+        size_t count_at = limit_at + 1;
+        if (count_at + 2 < tokens.size() && sql[tokens[count_at + 1].begin] == ',') {
+            count_at += 2;
+        }
+        if (count_at < tokens.size() && token_is_number(sql, tokens[count_at])) {
+            const SqlToken& count = tokens[count_at];
+            if (count.end - count.begin <= 18 &&
+                std::stoull(sql.substr(count.begin, count.end - count.begin)) <= max_rows) {
+                return body;
+            }
+            return body.substr(0, count.begin) + limit + body.substr(count.end);
+        }
+    } else if (!other_limit) {
+        return body + " LIMIT " + limit;
+    }
+    
+    return "SELECT * FROM (" + body + ") leaf_max_rows LIMIT " + limit;
+}
+
+bool SQLGuard::find_envelope_filter(const std::string& sql, EnvelopeFilter& filter) {
+    std::vector<SqlToken> tokens = tokenize(sql);
+    if (tokens.empty() || !token_is(sql, tokens[0], "SELECT")) {
+        return false;
+    }
+    static const char* const NOT_PLAIN[] = {
+        "LIMIT", "ORDER", "GROUP", "HAVING", "UNION", "INTERSECT", "EXCEPT", "DISTINCT", "TOP", "FETCH",
+        "OFFSET", "OR", "NOT", "JOIN", "COUNT", "SUM", "AVG", "MIN", "MAX", ";",
+    };
+    size_t found = tokens.size();
+    for (size_t i = 0; i < tokens.size(); i++) {
+        for (const char* word : NOT_PLAIN) {
+            if (token_is(sql, tokens[i], word)) {
+                return false;
+            }
+        }
+        if (tokens[i].depth == 0 && token_is(sql, tokens[i], "ST_INTERSECTS") && i > 0 &&
+            (token_is(sql, tokens[i - 1], "WHERE") || token_is(sql, tokens[i - 1], "AND"))) {
+            if (found < tokens.size()) {
+                return false;
+            }
+            found = i;
+        }
+    }
+    if (found + 1 >= tokens.size() || sql[tokens[found + 1].begin] != '(') {
+        return false;
+    }
+
+    std::vector<std::pair<size_t, size_t>> args;
+    size_t close = 0;
+    if (!call_arguments(sql, tokens, found + 1, args, close) || args.size() != 2) {
+        return false;
+    }
+    // Only another condition may follow
+    if (close + 1 < tokens.size() && !token_is(sql, tokens[close + 1], "AND")) {
+        return false;
+    }
+    const auto& first = args[0];
+    const auto& second = args[1];
+    bool parsed = parse_envelope(sql, tokens, second.first, second.second, filter)
+                      ? parse_column(sql, tokens, first.first, first.second, filter.column)
+                      : parse_envelope(sql, tokens, first.first, first.second, filter) &&
+                            parse_column(sql, tokens, second.first, second.second, filter.column);
+    // Tiles are matched to an extent through the geometry column, so the
+    // rows must include it
+    return parsed && selects_column(sql, tokens, filter.column);
+}
+
+std::string SQLGuard::source_table(const std::string& sql) {
+    std::vector<SqlToken> tokens = tokenize(sql);
+    if (tokens.empty() || !token_is(sql, tokens[0], "SELECT")) {
+        return "";
+    }
+    size_t from = 0;
+    while (from < tokens.size() && !(tokens[from].depth == 0 && token_is(sql, tokens[from], "FROM"))) {
+        from++;
+    }
+    if (from + 1 >= tokens.size()) {
+        return "";
+    }
+    size_t first = from + 1;
+    size_t last = first + 1;
+    if (last < tokens.size() && sql[tokens[first].end - 1] == '.') {
+        last++; // Quoted name after its qualifier
+    }
+    std::string table;
+    if (!parse_column(sql, tokens, first, last, table)) {
+        return "";
+    }
+    // A comma or JOIN before the clauses that follow FROM adds tables
+    static const char* const CLAUSES[] = {"WHERE", "GROUP", "ORDER", "LIMIT", "HAVING"};
+    bool in_from = true;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (tokens[i].depth != 0) {
+            continue;
+        }
+        if (token_is(sql, tokens[i], "UNION") || token_is(sql, tokens[i], "INTERSECT") ||
+            token_is(sql, tokens[i], "EXCEPT")) {
+            return "";
+        }
+        if (i < last) {
+            continue;
+        }
+        for (const char* clause : CLAUSES) {
+            in_from = in_from && !token_is(sql, tokens[i], clause);
+        }
+        if (in_from && (sql[tokens[i].begin] == ',' || token_is(sql, tokens[i], "JOIN"))) {
+            return "";
+        }
+    }
+    return table;
+}
+
 bool SQLGuard::is_allowed(const std::string& sql) {
     std::string normalized = normalize_sql(sql);
     
@@ -0,0 +1,69 @@
+#include "leafodbc/task_pool.h"
+#include "leafodbc/common.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace leafodbc {
+
+TaskPool& TaskPool::instance() {
+    static TaskPool pool;
+    return pool;
+}
+
+TaskPool::TaskPool() {
+    size_t count = std::min<size_t>(std::max(2u, std::thread::hardware_concurrency()), 8);
+    const char* env = std::getenv("LEAFODBC_WORKER_THREADS");
+    if (env) {
+        int n = std::atoi(env);
+        if (n > 0) count = static_cast<size_t>(n);
+    }
+
+    workers_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        workers_.emplace_back(&TaskPool::worker_loop, this);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void TaskPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void TaskPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            // Pending work is finished before shutdown so completions always run
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LEAF_LOG_ERROR("Worker task failed: %s", e.what());
+        } catch (...) {
+            LEAF_LOG_ERROR("Worker task failed with an unknown exception");
+        }
+    }
+}
+
+} // namespace leafodbc
@@ -0,0 +1,425 @@
+#include "leafodbc/tile_cache.h"
+#include "leafodbc/response_decoder.h"
+#include "leafodbc/metrics.h"
+#include "leafodbc/logger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace leafodbc {
+
+namespace {
+
+size_t env_megabytes(const char* name, size_t default_mb) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return default_mb * 1024 * 1024;
+    }
+    long mb = std::strtol(value, nullptr, 10);
+    return mb > 0 ? static_cast<size_t>(mb) * 1024 * 1024 : 0;
+}
+
+bool iequals(const std::string& a, const std::string& b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::toupper(static_cast<unsigned char>(x)) == std::toupper(static_cast<unsigned char>(y));
+           });
+}
+
+bool same_value(const Value& a, const Value& b) {
+    if (a.kind != b.kind) {
+        return false;
+    }
+    switch (a.kind) {
+        case Value::Kind::Null: return true;
+        case Value::Kind::Bool: return a.b == b.b;
+        case Value::Kind::Int: return a.i == b.i;
+        case Value::Kind::UInt: return a.u == b.u;
+        case Value::Kind::Double: return std::memcmp(&a.d, &b.d, sizeof(double)) == 0;
+        default: return a.str() == b.str();
+    }
+}
+
+uint64_t hash_value(const Value& v) {
+    uint64_t h = static_cast<uint64_t>(v.kind);
+    switch (v.kind) {
+        case Value::Kind::Null: break;
+        case Value::Kind::Bool: h = h * 31 + v.b; break;
+        case Value::Kind::Int: h = h * 31 + static_cast<uint64_t>(v.i); break;
+        case Value::Kind::UInt: h = h * 31 + v.u; break;
+        case Value::Kind::Double: {
+            uint64_t bits;
+            std::memcpy(&bits, &v.d, sizeof(bits));
+            h = h * 31 + bits;
+            break;
+        }
+        default: h = h * 31 + std::hash<std::string_view>()(v.str()); break;
+    }
+    return h;
+}
+
+// Columns of one tile, in the order of the merged result's keys, so that
+// rows of tiles with differently ordered schemas compare equal
+struct TileColumns {
+    std::vector<uint32_t> keys;  // Merged key of each column
+    std::vector<size_t> order;   // Columns sorted by key
+};
+
+// Non-null cells are compared, so a column missing from one tile matches NULL
+uint64_t hash_row(const ResultStore& store, const TileColumns& columns, size_t row) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t column : columns.order) {
+        Value v = store.cell(row, column);
+        if (!v.is_null()) {
+            h = (h ^ (columns.keys[column] * 0x9E3779B97F4A7C15ULL + hash_value(v))) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+bool same_row(const ResultStore& a, const TileColumns& a_columns, size_t a_row,
+              const ResultStore& b, const TileColumns& b_columns, size_t b_row) {
+    size_t i = 0;
+    size_t j = 0;
+    while (true) {
+        while (i < a_columns.order.size() && a.cell(a_row, a_columns.order[i]).is_null()) {
+            i++;
+        }
+        while (j < b_columns.order.size() && b.cell(b_row, b_columns.order[j]).is_null()) {
+            j++;
+        }
+        if (i == a_columns.order.size() || j == b_columns.order.size()) {
+            return i == a_columns.order.size() && j == b_columns.order.size();
+        }
+        size_t a_column = a_columns.order[i++];
+        size_t b_column = b_columns.order[j++];
+        if (a_columns.keys[a_column] != b_columns.keys[b_column] ||
+            !same_value(a.cell(a_row, a_column), b.cell(b_row, b_column))) {
+            return false;
+        }
+    }
+}
+
+} // namespace
+
+TileCache& TileCache::instance() {
+    static TileCache cache;
+    return cache;
+}
+
+TileCache::TileCache()
+    : memory_limit_(env_megabytes("LEAFODBC_TILE_CACHE_MB", 256)),
+      disk_limit_(env_megabytes("LEAFODBC_TILE_CACHE_DISK_MB", 1024)) {}
+
+TileCache::~TileCache() {
+    for (const Entry& entry : disk_) {
+        ::unlink(entry.path.c_str());
+    }
+    if (!disk_dir_.empty()) {
+        ::rmdir(disk_dir_.c_str());
+    }
+}
+
+bool TileCache::cover(const Bounds& extent, TileId& first, TileId& last) {
+    if (!(extent.min_x >= -180 && extent.max_x <= 180 && extent.min_y >= -90 && extent.max_y <= 90)) {
+        return false;
+    }
+    // Largest zoom whose tiles are still as wide and as tall as the extent
+    double width = extent.max_x - extent.min_x;
+    double height = extent.max_y - extent.min_y;
+    double scale = std::min(width > 0 ? 360.0 / width : HUGE_VAL, height > 0 ? 180.0 / height : HUGE_VAL);
+    int zoom = scale >= std::ldexp(1.0, MAX_ZOOM) ? MAX_ZOOM : static_cast<int>(std::floor(std::log2(scale)));
+    zoom = std::max(0, zoom);
+
+    int64_t tiles = int64_t{1} << zoom;
+    double tile_width = 360.0 / static_cast<double>(tiles);
+    double tile_height = 180.0 / static_cast<double>(tiles);
+    auto column = [&](double x) {
+        return std::clamp<int64_t>(static_cast<int64_t>(std::floor((x + 180.0) / tile_width)), 0, tiles - 1);
+    };
+    auto row = [&](double y) {
+        return std::clamp<int64_t>(static_cast<int64_t>(std::floor((y + 90.0) / tile_height)), 0, tiles - 1);
+    };
+    first = TileId{zoom, column(extent.min_x), row(extent.min_y)};
+    last = TileId{zoom, column(extent.max_x), row(extent.max_y)};
+    return true;
+}
+
+Bounds TileCache::tile_bounds(const TileId& tile) {
+    double tiles = std::ldexp(1.0, tile.zoom);
+    double tile_width = 360.0 / tiles;
+    double tile_height = 180.0 / tiles;
+    return Bounds{-180.0 + static_cast<double>(tile.x) * tile_width, -90.0 + static_cast<double>(tile.y) * tile_height,
+                  -180.0 + static_cast<double>(tile.x + 1) * tile_width,
+                  -90.0 + static_cast<double>(tile.y + 1) * tile_height};
+}
+
+std::string TileCache::tile_key(const std::string& query_key, const TileId& tile) {
+    return query_key + '\n' + std::to_string(tile.zoom) + '/' + std::to_string(tile.x) + '/' + std::to_string(tile.y);
+}
+
+std::shared_ptr<const ResultStore> TileCache::get(const std::string& key, int max_age_sec) {
+    auto& metrics = Metrics::instance();
+    Entry disk_entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            metrics.tile_misses.add();
+            return nullptr;
+        }
+        Entry& entry = *it->second;
+        bool on_disk = !entry.store;
+        if (std::chrono::steady_clock::now() - entry.stored_at > std::chrono::seconds(max_age_sec)) {
+            remove(it->second, on_disk);
+            metrics.tile_misses.add();
+            return nullptr;
+        }
+        if (!on_disk) {
+            memory_.splice(memory_.begin(), memory_, it->second);
+            metrics.tile_hits.add();
+            return entry.store;
+        }
+        disk_entry = entry;
+    }
+
+    // Read outside the lock; a tile dropped meanwhile reads as a miss
+    auto store = read_tile(disk_entry);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (!store) {
+        if (it != index_.end() && it->second->path == disk_entry.path) {
+            remove(it->second, true);
+        }
+        metrics.tile_misses.add();
+        return nullptr;
+    }
+    if (it != index_.end() && it->second->path == disk_entry.path) {
+        // Back in memory, keeping its age
+        ::unlink(disk_entry.path.c_str());
+        disk_bytes_ -= it->second->bytes;
+        it->second->store = store;
+        it->second->bytes = store->memory_bytes();
+        it->second->path.clear();
+        memory_.splice(memory_.begin(), disk_, it->second);
+        memory_bytes_ += it->second->bytes;
+        evict();
+    }
+    metrics.tile_hits.add();
+    return store;
+}
+
+void TileCache::put(const std::string& key, std::shared_ptr<const ResultStore> store) {
+    size_t bytes = store->memory_bytes();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        remove(it->second, !it->second->store);
+    }
+    memory_.push_front(Entry{key, std::chrono::steady_clock::now(), std::move(store), bytes, std::string()});
+    index_[key] = memory_.begin();
+    memory_bytes_ += bytes;
+    evict();
+}
+
+bool TileCache::begin_prefetch(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (prefetching_.size() >= MAX_PREFETCHES_IN_FLIGHT || index_.count(key) > 0) {
+        return false;
+    }
+    return prefetching_.insert(key).second;
+}
+
+void TileCache::end_prefetch(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prefetching_.erase(key);
+}
+
+void TileCache::remove(EntryList::iterator entry, bool on_disk) {
+    index_.erase(entry->key);
+    if (on_disk) {
+        ::unlink(entry->path.c_str());
+        disk_bytes_ -= entry->bytes;
+        disk_.erase(entry);
+    } else {
+        memory_bytes_ -= entry->bytes;
+        memory_.erase(entry);
+    }
+}
+
+void TileCache::evict() {
+    // Keep at least the tile just added in memory, however large
+    while (memory_bytes_ > memory_limit_ && memory_.size() > 1) {
+        auto victim = std::prev(memory_.end());
+        size_t in_memory = victim->bytes;
+        // Written under the lock: tiles are small next to the time to fetch one
+        if (disk_limit_ > 0 && write_tile(*victim)) {
+            memory_bytes_ -= in_memory;
+            victim->store.reset();
+            disk_.splice(disk_.begin(), memory_, victim);
+            disk_bytes_ += victim->bytes;
+        } else {
+            remove(victim, false);
+        }
+    }
+    while (disk_bytes_ > disk_limit_ && !disk_.empty()) {
+        remove(std::prev(disk_.end()), true);
+    }
+    Metrics::instance().tile_cache_bytes.set(static_cast<int64_t>(memory_bytes_));
+}
+
+bool TileCache::write_tile(Entry& entry) {
+    if (disk_dir_.empty()) {
+        const char* dir = std::getenv("LEAFODBC_TILE_CACHE_DIR");
+        if (!dir || !*dir) {
+            dir = std::getenv("TMPDIR");
+        }
+        std::string path = std::string(dir && *dir ? dir : "/tmp") + "/leafodbc-tiles-XXXXXX";
+        if (!::mkdtemp(&path[0])) {
+            LEAF_LOG_WARN("Cannot create tile cache directory %s: %s", path.c_str(), std::strerror(errno));
+            disk_limit_ = 0;
+            return false;
+        }
+        disk_dir_ = path;
+    }
+
+    // The rows as a JSON array, read back by the usual decoder
+    const ResultStore& store = *entry.store;
+    std::vector<std::string> names;
+    for (const auto& column : store.columns) {
+        names.push_back(nlohmann::json(column.name).dump() + ':');
+    }
+    std::string path = disk_dir_ + '/' + std::to_string(next_file_++) + ".json";
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << '[';
+    for (size_t row = 0; row < store.row_count; row++) {
+        file << (row > 0 ? ",{" : "{");
+        bool first = true;
+        for (size_t column = 0; column < store.columns.size(); column++) {
+            Value value = store.cell(row, column);
+            if (value.is_null()) {
+                continue;
+            }
+            file << (first ? "" : ",") << names[column] << value.dump();
+            first = false;
+        }
+        file << '}';
+    }
+    file << ']';
+    std::streamoff size = file.tellp();
+    file.close();
+    if (!file || size < 0) {
+        LEAF_LOG_WARN("Cannot write tile to %s", path.c_str());
+        ::unlink(path.c_str());
+        return false;
+    }
+    entry.path = path;
+    entry.bytes = static_cast<size_t>(size);
+    return true;
+}
+
+std::shared_ptr<const ResultStore> TileCache::read_tile(const Entry& entry) {
+    std::ifstream file(entry.path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    if (!file) {
+        return nullptr;
+    }
+    std::string body = contents.str();
+    DecodeOptions options;
+    auto decoder = make_response_decoder(ResponseFormat::Json, options);
+    ResultStoreBuilder builder(std::make_shared<Arena>());
+    std::string error;
+    if (!decoder->decode(body, builder, error)) {
+        LEAF_LOG_WARN("Cannot read tile from %s: %s", entry.path.c_str(), error.c_str());
+        return nullptr;
+    }
+    return builder.finish();
+}
+
+std::shared_ptr<ResultStore> merge_tiles(const std::vector<std::shared_ptr<const ResultStore>>& tiles,
+                                         const std::string& geometry_column, const Bounds& extent,
+                                         std::shared_ptr<Arena> arena) {
+    ResultStoreBuilder builder(std::move(arena));
+    std::vector<TileColumns> tile_columns(tiles.size());
+
+    // Rows kept from earlier tiles, by hash
+    struct Kept {
+        size_t tile;
+        size_t row;
+    };
+    std::unordered_multimap<uint64_t, Kept> kept;
+    std::vector<std::pair<uint64_t, size_t>> added;
+
+    for (size_t t = 0; t < tiles.size(); t++) {
+        const ResultStore& store = *tiles[t];
+        if (store.row_count == 0) {
+            continue;
+        }
+        TileColumns& columns = tile_columns[t];
+        size_t geometry = store.columns.size();
+        for (size_t c = 0; c < store.columns.size(); c++) {
+            columns.keys.push_back(builder.key(store.columns[c].name));
+            if (geometry == store.columns.size() && iequals(store.columns[c].name, geometry_column)) {
+                geometry = c;
+            }
+        }
+        if (geometry == store.columns.size()) {
+            return nullptr;
+        }
+        columns.order.resize(store.columns.size());
+        for (size_t c = 0; c < columns.order.size(); c++) {
+            columns.order[c] = c;
+        }
+        std::sort(columns.order.begin(), columns.order.end(),
+                  [&](size_t a, size_t b) { return columns.keys[a] < columns.keys[b]; });
+
+        added.clear();
+        for (size_t row = 0; row < store.row_count; row++) {
+            // Tiles extend past the extent; features whose box misses it are not part of the
+            // answer. Ones whose box meets it are kept, a superset of ST_Intersects.
+            Value shape = store.cell(row, geometry);
+            Bounds bounds;
+            if (shape.kind == Value::Kind::String && wkt_bounds(shape.str(), bounds) && !bounds.intersects(extent)) {
+                continue;
+            }
+            uint64_t hash = hash_row(store, columns, row);
+            bool duplicate = false;
+            auto range = kept.equal_range(hash);
+            for (auto it = range.first; it != range.second && !duplicate; ++it) {
+                duplicate = same_row(*tiles[it->second.tile], tile_columns[it->second.tile], it->second.row,
+                                     store, columns, row);
+            }
+            if (duplicate) {
+                continue;
+            }
+            added.emplace_back(hash, row);
+
+            builder.begin_row();
+            for (size_t c = 0; c < store.columns.size(); c++) {
+                Value value = store.cell(row, c);
+                if (value.is_null()) {
+                    continue;
+                }
+                if (value.kind == Value::Kind::String || value.kind == Value::Kind::Json) {
+                    value = Value::make_text(value.kind, builder.arena().copy(value.str()));
+                }
+                builder.set(columns.keys[c], value);
+            }
+        }
+        // Copies within one tile are distinct rows of the answer
+        for (const auto& [hash, row] : added) {
+            kept.emplace(hash, Kept{t, row});
+        }
+    }
+    return builder.finish();
+}
+
+} // namespace leafodbc
@@ -0,0 +1,19 @@
+#include "leafodbc/timings.h"
+#include <cstdio>
+
+namespace leafodbc {
+
+std::string QueryTimings::summary() const {
+    char buf[384];
+    std::snprintf(buf, sizeof(buf),
+                  "LeafODBC timing: queue=%.3fms dns=%.3fms connect=%.3fms tls=%.3fms ttfb=%.3fms "
+                  "transfer=%.3fms decode=%.3fms schema=%.3fms fetch=%.3fms total=%.3fms "
+                  "bytes=%lld rows=%lld",
+                  queue_wait_us / 1000.0, name_lookup_us / 1000.0, connect_us / 1000.0, tls_us / 1000.0,
+                  ttfb_us / 1000.0, transfer_us / 1000.0, decode_us / 1000.0,
+                  schema_us / 1000.0, fetch_us / 1000.0, total_us / 1000.0,
+                  static_cast<long long>(bytes_received), static_cast<long long>(rows));
+    return buf;
+}
+
+} // namespace leafodbc
@@ -0,0 +1,131 @@
+#include "leafodbc/trace.h"
+#include "leafodbc/logger.h"
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace leafodbc {
+
+std::atomic<int> g_trace_state{-1};
+
+namespace {
+
+const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+} // namespace
+
+int64_t trace_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+int init_trace_state() {
+    int state = Tracer::instance().enabled_ ? 1 : 0;
+    g_trace_state.store(state, std::memory_order_relaxed);
+    return state;
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() {
+    const char* path = std::getenv("LEAFODBC_TRACE_FILE");
+    if (!path || !*path) {
+        return;
+    }
+
+    file_ = std::fopen(path, "w");
+    if (!file_) {
+        LEAF_LOG_WARN("Could not open trace file %s", path);
+        return;
+    }
+
+    ring_.reset(new BoundedRing<Span, SLOT_COUNT>());
+    pid_ = static_cast<long>(getpid());
+    enabled_ = true;
+
+    std::fputs("[\n", file_);
+    std::fprintf(file_, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"args\":{\"name\":\"LeafODBC\"}}",
+                 pid_);
+    first_event_ = false;
+
+    writer_thread_ = std::thread(&Tracer::writer_loop, this);
+}
+
+Tracer::~Tracer() {
+    g_trace_state.store(0, std::memory_order_relaxed);
+
+    if (writer_thread_.joinable()) {
+        stopping_.store(true, std::memory_order_release);
+        writer_thread_.join();
+    }
+    if (file_) {
+        std::fputs("\n]\n", file_);
+        std::fclose(file_);
+    }
+}
+
+void Tracer::record(const char* name, const char* category, int64_t start_us, int64_t duration_us,
+                    const char* arg_name, int64_t arg_value) {
+    if (!enabled_) {
+        return;
+    }
+
+    bool pushed = ring_->try_push([&](Span& span) {
+        span.name = name;
+        span.category = category;
+        span.arg_name = arg_name;
+        span.arg_value = arg_value;
+        span.start_us = start_us;
+        span.duration_us = duration_us < 0 ? 0 : duration_us;
+        span.thread_id = current_thread_number();
+    });
+    if (!pushed) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::write_span(const Span& span) {
+    // Separator goes first so an interrupted file is still a valid prefix
+    std::fprintf(file_, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,"
+                        "\"pid\":%ld,\"tid\":%llu",
+                 first_event_ ? "" : ",\n", span.name, span.category,
+                 static_cast<long long>(span.start_us), static_cast<long long>(span.duration_us),
+                 pid_, static_cast<unsigned long long>(span.thread_id));
+    if (span.arg_name) {
+        std::fprintf(file_, ",\"args\":{\"%s\":%lld}", span.arg_name,
+                     static_cast<long long>(span.arg_value));
+    }
+    std::fputc('}', file_);
+    first_event_ = false;
+}
+
+bool Tracer::drain_once() {
+    bool drained = ring_->drain([this](const Span& span) { write_span(span); }) > 0;
+
+    uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        // Instant event marking where spans were lost
+        std::fprintf(file_, ",\n{\"name\":\"dropped_spans\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%lld,"
+                            "\"pid\":%ld,\"tid\":0,\"args\":{\"count\":%llu}}",
+                     static_cast<long long>(trace_now_us()), pid_,
+                     static_cast<unsigned long long>(dropped));
+    }
+    if (drained || dropped > 0) {
+        std::fflush(file_);
+    }
+    return drained;
+}
+
+void Tracer::writer_loop() {
+    while (!stopping_.load(std::memory_order_acquire)) {
+        if (!drain_once()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    drain_once();
+}
+
+} // namespace leafodbc
@@ -0,0 +1,131 @@
+// Throughput of decode_json_rows with each JsonParser on generated
+// responses: a wide table of scalar columns and GeoJSON-like rows with
+// nested coordinate arrays. Reports MB/s of response body, the decode
+// and ResultStoreBuilder::finish() included, on one thread and on every
+// TaskPool worker.
+//
+//   json_decode_bench [MB per response] [runs]
+
+#include "leafodbc/json_decoder.h"
+#include "leafodbc/arena.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace leafodbc;
+
+namespace {
+
+constexpr int WIDE_COLUMNS = 40;
+
+std::string wide_row(size_t id) {
+    std::string row = "{\"id\": " + std::to_string(id);
+    for (int c = 0; c < WIDE_COLUMNS; ++c) {
+        row += ", \"c" + std::to_string(c) + "\": ";
+        switch (c % 5) {
+            case 0: row += std::to_string(id * 31 + c); break;
+            case 1: row += std::to_string(static_cast<double>(id) / 7.0 + c); break;
+            case 2: row += "\"value " + std::to_string(id % 997) + "\""; break;
+            case 3: row += (id + c) % 2 ? "true" : "false"; break;
+            default: row += (id + c) % 3 ? "null" : "\"x\""; break;
+        }
+    }
+    return row + "}";
+}
+
+std::string geojson_row(size_t id) {
+    std::string ring;
+    double x = -120.0 + static_cast<double>(id % 1000) * 0.01;
+    double y = 35.0 + static_cast<double>(id % 777) * 0.01;
+    for (int i = 0; i <= 32; ++i) {
+        // A closed ring of 32 vertices
+        int k = i % 32;
+        char point[64];
+        std::snprintf(point, sizeof(point), "%s[%.6f, %.6f]", i ? ", " : "",
+                      x + 0.001 * (k % 8), y + 0.001 * (k / 8));
+        ring += point;
+    }
+    return "{\"id\": " + std::to_string(id) + ", \"name\": \"field " + std::to_string(id) +
+           "\", \"area\": " + std::to_string(12.5 + id % 100) +
+           ", \"properties\": {\"crop\": \"corn\", \"season\": 2024}"
+           ", \"geometry\": {\"type\": \"Polygon\", \"coordinates\": [[" + ring + "]]}}";
+}
+
+// A top-level array of rows of about `bytes`
+std::string make_body(std::string (*row)(size_t), size_t bytes) {
+    std::string body = "[";
+    for (size_t id = 0; body.size() < bytes; ++id) {
+        if (id) {
+            body += ",\n";
+        }
+        body += row(id);
+    }
+    return body + "]";
+}
+
+// Best MB/s of `runs` decodes; 0 on a decode error
+double measure(const std::string& body, JsonParser parser, int threads, int runs, size_t& rows) {
+    DecodeOptions options;
+    options.parser = parser;
+    options.threads = threads;
+    double best = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        std::string copy = body; // The simd parser may pad the body
+        ResultStoreBuilder builder(std::make_shared<Arena>());
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        if (!decode_json_rows(options, copy, builder, error)) {
+            std::fprintf(stderr, "decode failed: %s\n", error.c_str());
+            return 0.0;
+        }
+        auto store = builder.finish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rows = store->row_count;
+        best = std::max(best, static_cast<double>(body.size()) / (1024.0 * 1024.0) / seconds);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 32;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (megabytes == 0 || runs <= 0) {
+        std::fprintf(stderr, "usage: %s [MB per response] [runs]\n", argv[0]);
+        return 2;
+    }
+#ifndef LEAFODBC_HAVE_SIMDJSON
+    std::printf("built without simdjson: simd falls back to nlohmann\n");
+#endif
+
+    struct Shape {
+        const char* name;
+        std::string (*row)(size_t);
+    };
+    const Shape shapes[] = {{"wide", wide_row}, {"geojson", geojson_row}};
+    const struct {
+        const char* name;
+        JsonParser parser;
+    } parsers[] = {{"simd", JsonParser::Simd}, {"nlohmann", JsonParser::Nlohmann}};
+
+    std::printf("%-8s %-9s %-8s %10s %10s\n", "shape", "parser", "threads", "rows", "MB/s");
+    bool ok = true;
+    for (const auto& shape : shapes) {
+        std::string body = make_body(shape.row, megabytes * 1024 * 1024);
+        for (const auto& parser : parsers) {
+            for (int threads : {1, 0}) {
+                size_t rows = 0;
+                double rate = measure(body, parser.parser, threads, runs, rows);
+                ok &= rate > 0.0;
+                std::printf("%-8s %-9s %-8s %10zu %10.1f\n", shape.name, parser.name, threads ? "1" : "all",
+                            rows, rate);
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
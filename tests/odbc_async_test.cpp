@@ -0,0 +1,263 @@
+// Asynchronous statements driven through the ODBC entry points against a
+// local stand-in for the Leaf API. All statements are started and polled
+// from one thread while the pool has fewer workers than statements, so
+// the queries only finish if nothing in the async path blocks a worker;
+// the second round expires the session token first, so every statement
+// goes through the asynchronous reauthentication after a 401.
+
+#include "stub_http_server.h"
+#include <sql.h>
+#include <sqlext.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using leafodbc::test::StubHttpServer;
+using leafodbc::test::StubRequest;
+using leafodbc::test::StubResponse;
+
+namespace {
+
+constexpr int STATEMENTS = 16;
+constexpr int WORKERS = 2;
+constexpr int MAX_INFLIGHT = 4;
+constexpr int ROWS = 3;
+
+// The Leaf API: tokens are numbered, and expire_tokens() revokes every
+// token issued so far. Queries answer with ROWS rows holding the number
+// the statement put in its SQL, after a delay that lets them overlap.
+class FakeLeaf {
+public:
+    StubResponse handle(const StubRequest& request) {
+        StubResponse response;
+        if (request.path.find("/api/authenticate") == 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            response.body = "{\"id_token\": \"token-" + std::to_string(++issued_) + "\"}";
+            authentications_++;
+            return response;
+        }
+
+        if (!valid(request.header("authorization"))) {
+            response.status = 401;
+            response.body = "{\"message\": \"token expired\"}";
+            unauthorized_++;
+            return response;
+        }
+
+        int now = ++inflight_;
+        int seen = max_inflight_.load();
+        while (now > seen && !max_inflight_.compare_exchange_weak(seen, now)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        inflight_--;
+
+        std::string id = statement_id(request.body);
+        response.body = "[";
+        for (int i = 0; i < ROWS; ++i) {
+            response.body += (i ? ",{\"stmt\": " : "{\"stmt\": ") + id + ", \"row\": " + std::to_string(i) + "}";
+        }
+        response.body += "]";
+        return response;
+    }
+
+    void expire_tokens() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        revoked_below_ = issued_ + 1;
+    }
+
+    void reset_concurrency() { max_inflight_ = 0; }
+    int max_inflight() const { return max_inflight_; }
+    int authentications() const { return authentications_; }
+    int unauthorized() const { return unauthorized_; }
+
+private:
+    bool valid(const std::string& authorization) {
+        const std::string prefix = "Bearer token-";
+        if (authorization.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        int number = std::atoi(authorization.c_str() + prefix.size());
+        std::lock_guard<std::mutex> lock(mutex_);
+        return number >= revoked_below_ && number <= issued_;
+    }
+
+    static std::string statement_id(const std::string& sql) {
+        const std::string key = "stmt = ";
+        size_t pos = sql.find(key);
+        if (pos == std::string::npos) {
+            return "-1";
+        }
+        pos += key.size();
+        size_t end = sql.find_first_not_of("0123456789", pos);
+        return sql.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+    }
+
+    std::mutex mutex_;
+    int issued_ = 0;
+    int revoked_below_ = 1;
+    std::atomic<int> authentications_{0};
+    std::atomic<int> unauthorized_{0};
+    std::atomic<int> inflight_{0};
+    std::atomic<int> max_inflight_{0};
+};
+
+std::atomic<int> notified{0};
+
+SQLRETURN SQL_API on_done(SQLPOINTER context, int last) {
+    (void)context;
+    (void)last;
+    notified++;
+    return SQL_SUCCESS;
+}
+
+void print_diag(SQLSMALLINT type, SQLHANDLE handle) {
+    SQLCHAR state[6];
+    SQLINTEGER native;
+    SQLCHAR message[512];
+    SQLSMALLINT length;
+    for (SQLSMALLINT i = 1;
+         SQLGetDiagRec(type, handle, i, state, &native, message, sizeof(message), &length) == SQL_SUCCESS; ++i) {
+        std::fprintf(stderr, "  %.5s: %s\n", state, message);
+    }
+}
+
+// Starts STATEMENTS asynchronous statements, half of them with a completion
+// callback, polls them all from this thread and checks their rows
+bool run_round(const char* name, SQLHDBC dbc, FakeLeaf& leaf) {
+    std::vector<SQLHSTMT> stmts(STATEMENTS);
+    std::vector<std::string> sql(STATEMENTS);
+    std::vector<SQLRETURN> results(STATEMENTS, SQL_STILL_EXECUTING);
+    int callbacks = 0;
+    notified = 0;
+    leaf.reset_concurrency();
+    bool ok = true;
+
+    for (int i = 0; i < STATEMENTS; ++i) {
+        SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmts[i]);
+        SQLSetStmtAttr(stmts[i], SQL_ATTR_ASYNC_ENABLE, reinterpret_cast<SQLPOINTER>(SQL_ASYNC_ENABLE_ON), 0);
+        if (i % 2) {
+            SQLSetStmtAttr(stmts[i], SQL_ATTR_ASYNC_STMT_PCALLBACK, reinterpret_cast<SQLPOINTER>(&on_done), 0);
+            SQLSetStmtAttr(stmts[i], SQL_ATTR_ASYNC_STMT_PCONTEXT, reinterpret_cast<SQLPOINTER>(static_cast<intptr_t>(i)), 0);
+            callbacks++;
+        }
+        sql[i] = std::string("SELECT * FROM points WHERE round = '") + name + "' AND stmt = " + std::to_string(i);
+        results[i] = SQLExecDirect(stmts[i], (SQLCHAR*)sql[i].c_str(), SQL_NTS);
+        if (results[i] != SQL_STILL_EXECUTING) {
+            std::fprintf(stderr, "%s: statement %d returned %d instead of starting\n", name, i, results[i]);
+            ok = false;
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    int pending = STATEMENTS;
+    while (pending > 0 && std::chrono::steady_clock::now() < deadline) {
+        pending = 0;
+        for (int i = 0; i < STATEMENTS; ++i) {
+            if (results[i] == SQL_STILL_EXECUTING) {
+                results[i] = SQLExecDirect(stmts[i], (SQLCHAR*)sql[i].c_str(), SQL_NTS);
+                pending += results[i] == SQL_STILL_EXECUTING;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    if (pending > 0) {
+        std::fprintf(stderr, "%s: %d of %d statements still executing (deadlock?)\n", name, pending, STATEMENTS);
+        for (int i = 0; i < STATEMENTS; ++i) {
+            if (results[i] == SQL_STILL_EXECUTING) {
+                SQLCancel(stmts[i]);
+            }
+        }
+        return false;
+    }
+
+    for (int i = 0; i < STATEMENTS; ++i) {
+        if (results[i] != SQL_SUCCESS && results[i] != SQL_SUCCESS_WITH_INFO) {
+            std::fprintf(stderr, "%s: statement %d failed with %d\n", name, i, results[i]);
+            print_diag(SQL_HANDLE_STMT, stmts[i]);
+            ok = false;
+            continue;
+        }
+        int rows = 0;
+        while (SQLFetch(stmts[i]) == SQL_SUCCESS) {
+            SQLINTEGER stmt_id = -1;
+            SQLINTEGER row = -1;
+            SQLLEN indicator;
+            SQLGetData(stmts[i], 1, SQL_C_SLONG, &stmt_id, 0, &indicator);
+            SQLGetData(stmts[i], 2, SQL_C_SLONG, &row, 0, &indicator);
+            if (stmt_id != i || row != rows) {
+                std::fprintf(stderr, "%s: statement %d row %d holds (%d, %d)\n", name, i, rows, stmt_id, row);
+                ok = false;
+            }
+            rows++;
+        }
+        if (rows != ROWS) {
+            std::fprintf(stderr, "%s: statement %d fetched %d rows, expected %d\n", name, i, rows, ROWS);
+            ok = false;
+        }
+    }
+    for (auto stmt : stmts) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    }
+
+    if (notified != callbacks) {
+        std::fprintf(stderr, "%s: %d completion callbacks, expected %d\n", name, notified.load(), callbacks);
+        ok = false;
+    }
+    if (leaf.max_inflight() < 2 || leaf.max_inflight() > MAX_INFLIGHT) {
+        std::fprintf(stderr, "%s: %d queries ran at once, expected 2 to %d\n", name, leaf.max_inflight(), MAX_INFLIGHT);
+        ok = false;
+    }
+    std::printf("%s: %d statements, at most %d queries at once\n", name, STATEMENTS, leaf.max_inflight());
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    // Fewer workers than statements; read when the pool is first used
+    setenv("LEAFODBC_WORKER_THREADS", std::to_string(WORKERS).c_str(), 1);
+
+    FakeLeaf leaf;
+    StubHttpServer server([&leaf](const StubRequest& request) { return leaf.handle(request); });
+    if (!server.start()) {
+        std::fprintf(stderr, "cannot start the stub server\n");
+        return 1;
+    }
+
+    SQLHENV env;
+    SQLHDBC dbc;
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+    SQLAllocHandle(SQL_HANDLE_DBC, env, &dbc);
+    std::string conn_str = "EndpointBase=" + server.base_url() + ";Username=user;Password=secret;" +
+                           "MaxInflightPerEndpoint=" + std::to_string(MAX_INFLIGHT) + ";MaxInflightPerUser=0";
+    SQLRETURN ret = SQLDriverConnect(dbc, nullptr, (SQLCHAR*)conn_str.c_str(), SQL_NTS, nullptr, 0, nullptr,
+                                     SQL_DRIVER_NOPROMPT);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        std::fprintf(stderr, "connect failed with %d\n", ret);
+        print_diag(SQL_HANDLE_DBC, dbc);
+        return 1;
+    }
+
+    bool ok = run_round("concurrent", dbc, leaf);
+
+    leaf.expire_tokens();
+    int authentications = leaf.authentications();
+    ok &= run_round("reauthenticate", dbc, leaf);
+    if (leaf.unauthorized() < 1 || leaf.authentications() <= authentications) {
+        std::fprintf(stderr, "reauthenticate: %d 401 responses and %d new tokens\n", leaf.unauthorized(),
+                     leaf.authentications() - authentications);
+        ok = false;
+    }
+
+    SQLDisconnect(dbc);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+    SQLFreeHandle(SQL_HANDLE_ENV, env);
+    server.stop();
+    return ok ? 0 : 1;
+}
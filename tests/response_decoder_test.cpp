@@ -0,0 +1,374 @@
+// Response decoders and RowLimiter: every wire format yields the same
+// cells, CSV records split for parallel decoding stay whole, malformed
+// input is reported, transfers are cut after exactly max_rows rows, the
+// Content-Type of a response wins over the format that was asked for, and
+// results decoded under a memory budget keep every row.
+
+#include "leafodbc/response_decoder.h"
+#include "leafodbc/leaf_client.h"
+#include "stub_http_server.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace leafodbc;
+
+namespace {
+
+bool check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    }
+    return condition;
+}
+
+// Decodes a copy of `body`; null with `error` set on failure
+std::shared_ptr<ResultStore> decode(ResponseFormat format, const std::string& body, int threads,
+                                    std::string& error) {
+    DecodeOptions options;
+    options.format = format;
+    options.threads = threads;
+    std::string copy = body;
+    ResultStoreBuilder builder(std::make_shared<Arena>());
+    error.clear();
+    if (!make_response_decoder(format, options)->decode(copy, builder, error)) {
+        return nullptr;
+    }
+    return builder.finish();
+}
+
+// Column names and types, then every cell with its kind. The JSON parsers
+// read non-negative integers as UInt and CSV as Int, which fetch alike.
+std::string render(const ResultStore& store) {
+    std::string out;
+    for (const auto& column : store.columns) {
+        out += column.name + ":" + std::to_string(column.sql_type) + " ";
+    }
+    out += "\n";
+    for (size_t row = 0; row < store.row_count; ++row) {
+        for (size_t c = 0; c < store.columns.size(); ++c) {
+            Value value = store.cell(row, c);
+            Value::Kind kind = value.kind == Value::Kind::UInt ? Value::Kind::Int : value.kind;
+            out += std::to_string(static_cast<int>(kind)) + "=" + value.dump() + " ";
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+std::string render_decoded(ResponseFormat format, const std::string& body, int threads = 1) {
+    std::string error;
+    auto store = decode(format, body, threads, error);
+    return store ? render(*store) : "error: " + error;
+}
+
+const char* const JSON_ROWS =
+    "[{\"id\": 1, \"name\": \"North field\", \"area\": 12.5, \"irrigated\": true, \"note\": null},\n"
+    " {\"id\": 2, \"name\": \"Say \\\"hi\\\"\", \"area\": 0.25, \"irrigated\": false, \"note\": \"dry\"},\n"
+    " {\"id\": -3, \"name\": \"a,b\", \"area\": 100.0, \"irrigated\": true, \"note\": null}]";
+
+const char* const NDJSON_ROWS =
+    "{\"id\": 1, \"name\": \"North field\", \"area\": 12.5, \"irrigated\": true, \"note\": null}\n"
+    "{\"id\": 2, \"name\": \"Say \\\"hi\\\"\", \"area\": 0.25, \"irrigated\": false, \"note\": \"dry\"}\n"
+    "\n"
+    "{\"id\": -3, \"name\": \"a,b\", \"area\": 100.0, \"irrigated\": true, \"note\": null}\n";
+
+const char* const CSV_ROWS =
+    "id,name,area,irrigated,note\n"
+    "1,\"North field\",12.5,true,\n"
+    "2,\"Say \"\"hi\"\"\",0.25,false,\"dry\"\n"
+    "-3,\"a,b\",100.0,true,\n";
+
+bool test_formats_agree() {
+    std::string json = render_decoded(ResponseFormat::Json, JSON_ROWS);
+    bool ok = check(json.find("error") != 0 && json.find("Say \\\"hi\\\"") != std::string::npos,
+                    "JSON rows decode: " + json);
+    ok &= check(render_decoded(ResponseFormat::NdJson, NDJSON_ROWS) == json, "NDJSON rows match the JSON rows");
+    ok &= check(render_decoded(ResponseFormat::Csv, CSV_ROWS) == json, "CSV rows match the JSON rows");
+    return ok;
+}
+
+bool test_bom_and_crlf() {
+    std::string crlf;
+    for (const char* c = CSV_ROWS; *c; ++c) {
+        crlf += *c == '\n' ? "\r\n" : std::string(1, *c);
+    }
+    std::string expected = render_decoded(ResponseFormat::Csv, CSV_ROWS);
+    bool ok = check(render_decoded(ResponseFormat::Csv, crlf) == expected, "CSV with CRLF line ends");
+    ok &= check(render_decoded(ResponseFormat::Csv, "\xEF\xBB\xBF" + crlf) == expected, "CSV with a BOM and CRLF");
+
+    std::string ndjson_crlf;
+    for (const char* c = NDJSON_ROWS; *c; ++c) {
+        ndjson_crlf += *c == '\n' ? "\r\n" : std::string(1, *c);
+    }
+    ok &= check(render_decoded(ResponseFormat::NdJson, ndjson_crlf) == render_decoded(ResponseFormat::NdJson, NDJSON_ROWS),
+                "NDJSON with CRLF line ends");
+
+    // A quoted field keeps its CRLF
+    std::string error;
+    auto store = decode(ResponseFormat::Csv, "a,b\r\n\"x\r\ny\",1\r\n", 1, error);
+    ok &= check(store && store->row_count == 1 && store->cell(0, 0).str() == "x\r\ny" &&
+                store->cell(0, 1).as_int64() == 1, "CSV quoted field holding CRLF");
+    return ok;
+}
+
+bool test_unterminated_quotes() {
+    std::string error;
+    bool ok = check(!decode(ResponseFormat::Csv, "id,name\n1,\"open\n2,x\n", 1, error) &&
+                    error.find("Unterminated") != std::string::npos, "unterminated quote in a CSV record");
+    ok &= check(!decode(ResponseFormat::Csv, "id,\"name\n1,x\n", 1, error) && !error.empty(),
+                "unterminated quote in the CSV header");
+    ok &= check(!decode(ResponseFormat::NdJson, "{\"id\": 1, \"name\": \"open}\n", 1, error) && !error.empty(),
+                "unterminated string in an NDJSON row");
+    ok &= check(!decode(ResponseFormat::Json, "[{\"id\": 1, \"name\": \"open}]", 1, error) && !error.empty(),
+                "unterminated string in a JSON row");
+    return ok;
+}
+
+// A CSV body big enough to be decoded in parallel, whose records hold
+// quoted fields with newlines and "" pairs that chunk boundaries fall into
+std::string large_csv(size_t& rows) {
+    std::string body = "id,text,value\n";
+    std::string text;
+    for (int line = 0; line < 40; ++line) {
+        text += "line \"\"" + std::to_string(line) + "\"\",\n";
+    }
+    for (rows = 0; body.size() < 6 * 1024 * 1024; ++rows) {
+        body += std::to_string(rows) + ",\"" + text + "\"," + std::to_string(rows % 7) + "\n";
+    }
+    return body;
+}
+
+bool test_parallel_csv() {
+    size_t rows = 0;
+    std::string body = large_csv(rows);
+    size_t begin = body.find('\n') + 1;
+    auto ranges = split_lines(body, begin, body.size(), 4, true);
+    auto naive = split_lines(body, begin, body.size(), 4, false);
+    bool ok = check(ranges.size() > 1, "large CSV body is split");
+    ok &= check(naive != ranges, "some chunk boundaries fall inside quoted fields");
+
+    size_t expected_begin = begin;
+    for (const auto& range : ranges) {
+        // Every range starts a record: an even number of quotes precedes it
+        size_t quotes = 0;
+        for (size_t i = 0; i < range.first; ++i) {
+            quotes += body[i] == '"';
+        }
+        ok &= check(range.first == expected_begin && quotes % 2 == 0 && body[range.first - 1] == '\n',
+                    "range at " + std::to_string(range.first) + " starts a record");
+        expected_begin = range.second;
+    }
+    ok &= check(expected_begin == body.size(), "ranges cover the body");
+
+    std::string error;
+    auto serial = decode(ResponseFormat::Csv, body, 1, error);
+    auto parallel = decode(ResponseFormat::Csv, body, 4, error);
+    ok &= check(serial && parallel, "large CSV decodes: " + error);
+    if (serial && parallel) {
+        ok &= check(serial->row_count == rows && parallel->row_count == rows, "every CSV record is a row");
+        ok &= check(render(*serial) == render(*parallel), "parallel CSV decode matches the serial one");
+        std::string text = std::string(parallel->cell(rows - 1, 1).str());
+        ok &= check(text.compare(0, 14, "line \"0\",\nline") == 0, "quoted field keeps newlines and unescapes \"\"");
+    }
+    return ok;
+}
+
+// Feeds `body` to a RowLimiter in pieces of `step` bytes, as a transfer would
+std::string limit(ResponseFormat format, size_t max_rows, const std::string& body, size_t step, bool& cut) {
+    RowLimiter limiter(format, max_rows);
+    std::string received;
+    cut = false;
+    for (size_t pos = 0; pos < body.size() && !cut; pos += step) {
+        received.append(body, pos, step);
+        cut = limiter.append(received);
+    }
+    return received;
+}
+
+bool test_row_limiter() {
+    bool ok = true;
+    const std::string csv = "id,text\n1,\"a\nb\"\n2,\"\"\"q\"\"\"\n\n3,c\n4,d\n";
+    const std::string ndjson = "{\"id\": 1}\n\n{\"id\": 2, \"s\": \"x\\ny\"}\n{\"id\": 3}\n{\"id\": 4}\n";
+    for (size_t step : {1, 3, 1024}) {
+        for (size_t n = 1; n <= 3; ++n) {
+            bool cut;
+            std::string error;
+            std::string label = " (" + std::to_string(n) + " rows, " + std::to_string(step) + "-byte reads)";
+
+            std::string body = limit(ResponseFormat::Csv, n, csv, step, cut);
+            auto store = decode(ResponseFormat::Csv, body, 1, error);
+            ok &= check(cut && store && store->row_count == n && body.back() == '\n', "CSV cut" + label);
+            if (store && store->row_count == n) {
+                ok &= check(store->cell(n - 1, 0).as_int64() == static_cast<int64_t>(n), "last CSV row kept" + label);
+            }
+
+            body = limit(ResponseFormat::NdJson, n, ndjson, step, cut);
+            store = decode(ResponseFormat::NdJson, body, 1, error);
+            ok &= check(cut && store && store->row_count == n, "NDJSON cut" + label);
+        }
+    }
+
+    // A body with no more rows than the limit is left whole
+    bool cut;
+    ok &= check(limit(ResponseFormat::Csv, 4, csv, 1, cut) == csv, "CSV at the limit is kept whole");
+    ok &= check(limit(ResponseFormat::Csv, 5, csv, 7, cut) == csv && !cut, "short CSV is not cut");
+    ok &= check(limit(ResponseFormat::NdJson, 5, ndjson, 7, cut) == ndjson && !cut, "short NDJSON is not cut");
+    return ok;
+}
+
+// The server picks the format; the requested one is only a fallback
+bool test_content_type() {
+    bool ok = check(response_format_of("application/json; charset=utf-8", ResponseFormat::Csv) == ResponseFormat::Json,
+                    "JSON Content-Type overrides a CSV request");
+    ok &= check(response_format_of("Text/CSV", ResponseFormat::Json) == ResponseFormat::Csv,
+                "CSV Content-Type overrides a JSON request");
+    ok &= check(response_format_of("application/x-ndjson", ResponseFormat::Csv) == ResponseFormat::NdJson,
+                "NDJSON Content-Type overrides a CSV request");
+    ok &= check(response_format_of("application/octet-stream", ResponseFormat::NdJson) == ResponseFormat::NdJson,
+                "unknown Content-Type keeps the requested format");
+    ok &= check(response_format_of("", ResponseFormat::Csv) == ResponseFormat::Csv,
+                "missing Content-Type keeps the requested format");
+
+    // Through a client: each request is answered in another format than asked
+    std::string expected = render_decoded(ResponseFormat::Json, JSON_ROWS);
+    test::StubHttpServer server([](const test::StubRequest& request) {
+        test::StubResponse response;
+        const std::string accept = request.header("accept");
+        if (accept.find("text/csv") != std::string::npos) {
+            response.body = JSON_ROWS;
+        } else if (accept.find("ndjson") != std::string::npos) {
+            response.content_type = "text/csv";
+            response.body = CSV_ROWS;
+        } else {
+            response.content_type = "application/x-ndjson";
+            response.body = NDJSON_ROWS;
+        }
+        return response;
+    });
+    if (!check(server.start(), "stub server starts")) {
+        return false;
+    }
+    for (ResponseFormat requested : {ResponseFormat::Csv, ResponseFormat::NdJson, ResponseFormat::Json}) {
+        for (size_t max_rows : {0, 2}) {
+            LeafClient client(server.base_url(), "response_decoder_test", 10, false);
+            client.set_token("token");
+            DecodeOptions options;
+            options.format = requested;
+            options.max_rows = max_rows;
+            client.set_decode_options(options);
+            std::shared_ptr<ResultStore> result;
+            std::string label = " (requested format " + std::to_string(static_cast<int>(requested)) +
+                                ", max_rows " + std::to_string(max_rows) + ")";
+            if (!check(client.execute_query("SELECT * FROM fields", "spark", result) && result,
+                       "query answered in another format" + label)) {
+                ok = false;
+                continue;
+            }
+            if (max_rows == 0) {
+                ok &= check(render(*result) == expected, "rows match the JSON rows" + label);
+            } else {
+                ok &= check(result->row_count == max_rows, "rows limited in the answered format" + label);
+            }
+        }
+    }
+    server.stop();
+    return ok;
+}
+
+// About `bytes` of rows in `format`, with text that needs escaping or quoting
+std::string budget_body(ResponseFormat format, size_t bytes) {
+    std::string body = format == ResponseFormat::Json ? "{\"rows\": [" : "";
+    if (format == ResponseFormat::Csv) {
+        body += "id,name,area,irrigated\n";
+    }
+    for (size_t id = 0; body.size() < bytes; ++id) {
+        std::string number = std::to_string(id);
+        std::string area = std::to_string(id % 1000) + "." + std::to_string(id % 7);
+        std::string irrigated = id % 3 ? "true" : "false";
+        switch (format) {
+            case ResponseFormat::Csv:
+                body += number + ",\"field \"\"" + number + "\"\", north\"," + area + "," + irrigated + "\n";
+                break;
+            default:
+                body += (format == ResponseFormat::Json && id ? "," : "");
+                body += "{\"id\": " + number + ", \"name\": \"field \\\"" + number + "\\\", north\", \"area\": " +
+                        area + ", \"irrigated\": " + irrigated + "}";
+                body += format == ResponseFormat::NdJson ? "\n" : "";
+                break;
+        }
+    }
+    return body + (format == ResponseFormat::Json ? "]}" : "");
+}
+
+// Under MemoryBudgetMB, large responses are spooled to disk, decoded a
+// range at a time and spilled while decoding, and read back as decoded
+bool test_memory_budget() {
+    const size_t BUDGET = 256 * 1024;
+    bool ok = true;
+    for (ResponseFormat format : {ResponseFormat::Json, ResponseFormat::NdJson, ResponseFormat::Csv}) {
+        std::string label = " (format " + std::to_string(static_cast<int>(format)) + ")";
+        std::string body = budget_body(format, 2 * 1024 * 1024);
+        std::string error;
+        auto expected = decode(format, body, 1, error);
+        if (!check(expected != nullptr, "unbudgeted decode" + label + ": " + error)) {
+            ok = false;
+            continue;
+        }
+        
+        DecodeOptions options;
+        options.format = format;
+        options.memory_budget = BUDGET;
+        std::string copy = body;
+        ResultStoreBuilder builder(std::make_shared<Arena>());
+        builder.set_memory_budget(BUDGET);
+        bool decoded = make_response_decoder(format, options)->decode(copy, builder, error);
+        auto spilled = builder.finish();
+        ok &= check(decoded && builder.spill_error().empty() && spilled->spilled,
+                    "result spilled while decoding" + label + ": " + error);
+        ok &= check(render(*spilled) == render(*expected), "spilled rows match" + label);
+        
+        const char* content_type = format == ResponseFormat::Csv      ? "text/csv"
+                                   : format == ResponseFormat::NdJson ? "application/x-ndjson"
+                                                                      : "application/json";
+        test::StubHttpServer server([&](const test::StubRequest&) {
+            test::StubResponse response;
+            response.content_type = content_type;
+            response.body = body;
+            return response;
+        });
+        if (!check(server.start(), "stub server starts")) {
+            return false;
+        }
+        LeafClient client(server.base_url(), "response_decoder_test", 10, false);
+        client.set_token("token");
+        client.set_decode_options(options);
+        std::shared_ptr<ResultStore> result;
+        if (check(client.execute_query("SELECT * FROM fields", "spark", result) && result,
+                  "spooled query" + label)) {
+            ok &= check(result->spilled != nullptr, "spooled result spilled" + label);
+            ok &= check(render(*result) == render(*expected), "spooled rows match" + label);
+        } else {
+            ok = false;
+        }
+        server.stop();
+    }
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    ok &= test_formats_agree();
+    ok &= test_bom_and_crlf();
+    ok &= test_unterminated_quotes();
+    ok &= test_parallel_csv();
+    ok &= test_row_limiter();
+    ok &= test_content_type();
+    ok &= test_memory_budget();
+    std::printf("%s\n", ok ? "response decoder tests passed" : "response decoder tests FAILED");
+    return ok ? 0 : 1;
+}
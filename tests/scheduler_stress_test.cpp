@@ -0,0 +1,108 @@
+// Many asynchronous requests started from one thread against an endpoint
+// with in-flight caps. Each admitted request finishes on a TaskPool worker,
+// as LeafClient::finish_async_attempt does, so admission that blocked a
+// worker would deadlock once the requests outnumber the workers.
+
+#include "leafodbc/scheduler.h"
+#include "leafodbc/task_pool.h"
+#include "leafodbc/cancel.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace leafodbc;
+
+namespace {
+
+constexpr int REQUESTS = 256;
+
+struct State {
+    std::atomic<int> inflight{0};
+    std::atomic<int> max_inflight{0};
+    std::atomic<int> admitted{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    int finished = 0;
+};
+
+// Starts REQUESTS requests from the calling thread and waits for them all
+bool run(const char* name, const SchedulerLimits& limits, int cap,
+         std::shared_ptr<CancelToken> cancel = nullptr) {
+    auto state = std::make_shared<State>();
+    auto& scheduler = RequestScheduler::instance();
+    std::string endpoint = std::string("http://stress.invalid/") + name;
+
+    for (int i = 0; i < REQUESTS; ++i) {
+        auto priority = static_cast<RequestPriority>(i % 3);
+        scheduler.acquire_async(endpoint, i % 2 ? "alice" : "bob", priority, limits, cancel,
+                                [state](RequestScheduler::Ticket ticket) {
+            int now = ++state->inflight;
+            int seen = state->max_inflight.load();
+            while (now > seen && !state->max_inflight.compare_exchange_weak(seen, now)) {
+            }
+            state->admitted++;
+            auto held = std::make_shared<RequestScheduler::Ticket>(std::move(ticket));
+            TaskPool::instance().submit([state, held] {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                state->inflight--;
+                *held = RequestScheduler::Ticket();
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished++;
+                state->cv.notify_all();
+            });
+        });
+    }
+
+    bool done;
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        done = state->cv.wait_for(lock, std::chrono::seconds(30), [&] { return state->finished == REQUESTS; });
+    }
+    if (!done) {
+        std::fprintf(stderr, "%s: %d of %d requests finished (deadlock?)\n", name, state->finished, REQUESTS);
+        return false;
+    }
+    if (cap > 0 && state->max_inflight > cap) {
+        std::fprintf(stderr, "%s: %d requests in flight, cap is %d\n", name, state->max_inflight.load(), cap);
+        return false;
+    }
+    std::printf("%s: %d requests, at most %d in flight\n", name, REQUESTS, state->max_inflight.load());
+    return true;
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+
+    SchedulerLimits endpoint_cap;
+    endpoint_cap.rate_limit_per_sec = 0;
+    endpoint_cap.max_inflight_per_endpoint = 1;
+    endpoint_cap.max_inflight_per_user = 0;
+    ok &= run("endpoint_cap", endpoint_cap, 1);
+
+    SchedulerLimits user_cap;
+    user_cap.rate_limit_per_sec = 0;
+    user_cap.max_inflight_per_endpoint = 3;
+    user_cap.max_inflight_per_user = 1;
+    ok &= run("user_cap", user_cap, 2);
+
+    // Cancellable waiters are also rechecked on a reactor timer
+    SchedulerLimits rate_limit;
+    rate_limit.rate_limit_per_sec = 2000;
+    rate_limit.rate_limit_burst = 8;
+    rate_limit.max_inflight_per_endpoint = 2;
+    rate_limit.max_inflight_per_user = 0;
+    ok &= run("rate_limit", rate_limit, 2, std::make_shared<CancelToken>());
+
+    // A stopped statement gets an empty ticket instead of waiting
+    auto stopped = std::make_shared<CancelToken>();
+    stopped->cancel();
+    ok &= run("cancelled", endpoint_cap, 0, stopped);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+// Minimal HTTP/1.1 server on 127.0.0.1 standing in for the Leaf API in
+// tests. Each connection gets its own thread and is kept alive, as curl
+// reuses connections; requests are handed to the handler one at a time
+// per connection, so concurrent requests arrive on separate threads.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace leafodbc {
+namespace test {
+
+struct StubRequest {
+    std::string method;
+    std::string path; // Including the query string
+    std::map<std::string, std::string> headers; // Lowercase names
+    std::string body;
+
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? std::string() : it->second;
+    }
+};
+
+struct StubResponse {
+    int status = 200;
+    std::string content_type = "application/json";
+    std::string body;
+};
+
+class StubHttpServer {
+public:
+    using Handler = std::function<StubResponse(const StubRequest&)>;
+
+    explicit StubHttpServer(Handler handler) : handler_(std::move(handler)) {}
+    ~StubHttpServer() { stop(); }
+
+    StubHttpServer(const StubHttpServer&) = delete;
+    StubHttpServer& operator=(const StubHttpServer&) = delete;
+
+    // Listens on an ephemeral port; returns false if the socket can't be set up
+    bool start() {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            return false;
+        }
+        int on = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, 64) != 0 ||
+            ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        port_ = ntohs(addr.sin_port);
+        accept_thread_ = std::thread(&StubHttpServer::accept_loop, this);
+        return true;
+    }
+
+    void stop() {
+        if (listen_fd_ < 0) {
+            return;
+        }
+        stopping_ = true;
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        accept_thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : connections_) {
+                ::shutdown(fd, SHUT_RDWR);
+            }
+            threads.swap(threads_);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    int port() const { return port_; }
+    std::string base_url() const { return "http://127.0.0.1:" + std::to_string(port_); }
+
+private:
+    void accept_loop() {
+        while (!stopping_) {
+            int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                ::close(fd);
+                break;
+            }
+            connections_.push_back(fd);
+            threads_.emplace_back(&StubHttpServer::serve, this, fd);
+        }
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        StubRequest request;
+        while (read_request(fd, buffer, request)) {
+            StubResponse response = handler_(request);
+            std::string out = "HTTP/1.1 " + std::to_string(response.status) + " " +
+                              reason(response.status) + "\r\n" +
+                              "Content-Type: " + response.content_type + "\r\n" +
+                              "Content-Length: " + std::to_string(response.body.size()) + "\r\n\r\n" +
+                              response.body;
+            if (!write_all(fd, out)) {
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections_.erase(std::remove(connections_.begin(), connections_.end(), fd), connections_.end());
+        ::close(fd);
+    }
+
+    // Reads one request; bytes past its end stay in `buffer` for the next one
+    static bool read_request(int fd, std::string& buffer, StubRequest& request) {
+        size_t header_end;
+        while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!read_more(fd, buffer)) {
+                return false;
+            }
+        }
+
+        request = StubRequest();
+        size_t line_end = buffer.find("\r\n");
+        std::string line = buffer.substr(0, line_end);
+        size_t sp1 = line.find(' ');
+        size_t sp2 = line.find(' ', sp1 + 1);
+        if (sp1 == std::string::npos || sp2 == std::string::npos) {
+            return false;
+        }
+        request.method = line.substr(0, sp1);
+        request.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+        size_t pos = line_end + 2;
+        while (pos < header_end) {
+            size_t next = buffer.find("\r\n", pos);
+            std::string header = buffer.substr(pos, next - pos);
+            size_t colon = header.find(':');
+            if (colon != std::string::npos) {
+                std::string name = header.substr(0, colon);
+                std::transform(name.begin(), name.end(), name.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                size_t value = header.find_first_not_of(' ', colon + 1);
+                request.headers[name] = value == std::string::npos ? "" : header.substr(value);
+            }
+            pos = next + 2;
+        }
+
+        size_t length = static_cast<size_t>(std::strtoul(request.header("content-length").c_str(), nullptr, 10));
+        size_t body_start = header_end + 4;
+        while (buffer.size() < body_start + length) {
+            if (!read_more(fd, buffer)) {
+                return false;
+            }
+        }
+        request.body = buffer.substr(body_start, length);
+        buffer.erase(0, body_start + length);
+        return true;
+    }
+
+    static bool read_more(int fd, std::string& buffer) {
+        char chunk[4096];
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    static bool write_all(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static const char* reason(int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 401: return "Unauthorized";
+            case 503: return "Service Unavailable";
+            default: return "Status";
+        }
+    }
+
+    Handler handler_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::thread accept_thread_;
+    std::mutex mutex_;
+    std::vector<int> connections_;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace test
+} // namespace leafodbc